@@ -37,6 +37,9 @@ namespace grail {
 				text.renderAt(target, ticks, p + getUpperLeftCorner());
 			}
 			
+			bool isDirty() const { return text.isDirty(); }
+			void setClean() { text.setClean(); }
+			
 			void setOutlineFont(Font::Ptr f, int outline) {
 				text.setOutlineFont(f, outline);
 			}
@@ -12,7 +12,7 @@ using std::copy;
 namespace grail {
 
 Actor::Actor(std::string name) :
-	mode("default"), name(name), yOffset(0), alignmentX(0.5), alignmentY(1.0), speed(1000.0), dialogGapTime(300) {
+	mode("default"), name(name), yOffset(0), alignmentX(0.5), alignmentY(1.0), speed(1000.0), animationSwitched(false), dialogGapTime(300) {
 }
 
 std::string Actor::getName() const {
@@ -31,6 +31,13 @@ bool Actor::hasPoint(VirtualPosition p) const {
 	}
 }
 
+Rect Actor::getBounds() const {
+	if(animation) {
+		return Rect(getUpperLeftCorner() + VirtualPosition(0, yOffset), animation->getSize());
+	}
+	return Rect(VirtualSize(0, 0));
+}
+
 void Actor::renderAt(SDL_Surface* target, uint32_t ticks, VirtualPosition p) const {
 	if(animation) {
 		animation->renderAt(target, ticks, getUpperLeftCorner() + p + VirtualPosition(0, yOffset));
@@ -52,10 +59,23 @@ void Actor::renderAt(SDL_Surface* target, uint32_t ticks, VirtualPosition p) con
 	#endif
 }
 
+void Actor::collectDirty(DirtyRegion& region, VirtualPosition p) {
+	if(animation) {
+		dirtyTracker.update(region, getUpperLeftCorner() + p + VirtualPosition(0, yOffset),
+				animation->getSize(), animationSwitched || animation->isDirty());
+		animation->setClean();
+	}
+	else {
+		dirtyTracker.hide(region);
+	}
+	animationSwitched = false;
+}
+
 void Actor::addAnimation(std::string mode, Animation::Ptr animation) {
 	animationModes[mode] = animation;
 	if(animationModes.count(this->mode)) {
 		this->animation = animationModes[mode];
+		animationSwitched = true;
 	}
 }
 
@@ -72,6 +92,7 @@ void Actor::setMode(std::string mode) {
 		Animation::Ptr previous = animation;
 		animation = animationModes[mode];
 		animation->makeContinuationOf(*previous);
+		if(animation != previous) { animationSwitched = true; }
 	}
 }
 
@@ -107,9 +128,11 @@ void Actor::walkTo(VirtualPosition p) {
 }
 
 void Actor::walk(const Path& path) {
-	walkPath.clear();
-	copy(path.begin(), path.end(), walkPath.begin());
-	assert(walkPath.size() == path.size());
+	bool walking = !walkPath.empty();
+	walkPath = path;
+	if(walking && walkPath.empty()) {
+		setMode("default");
+	}
 }
 
 void Actor::walkStraight(VirtualPosition p) {
@@ -17,6 +17,8 @@
 #include "vector2d.h"
 #include "animation.h"
 #include "area.h"
+#include "rect.h"
+#include "dirty_region.h"
 #include "debug.h"
 
 class dialogLine;
@@ -39,6 +41,8 @@ namespace grail {
 			double alignmentX, alignmentY;
 			Area::Ptr area;
 			double speed; ///< Unit is virtual pixels / second
+			DirtyTracker dirtyTracker;
+			bool animationSwitched;
 			
 			Path walkPath;
 
@@ -71,9 +75,21 @@ namespace grail {
 			 */
 			bool hasPoint(VirtualPosition p) const;
 			
+			/**
+			 * The rectangle (in scene coordinates) the actor's animation is
+			 * drawn to, empty if there is no animation.
+			 */
+			Rect getBounds() const;
+			
 			void eachFrame(uint32_t ticks);
 			void renderAt(SDL_Surface* target, uint32_t ticks, VirtualPosition p) const;
 			
+			/**
+			 * Add the screen area that changed since the last call (when
+			 * rendered at $p) to $region.
+			 */
+			void collectDirty(DirtyRegion& region, VirtualPosition p);
+			
 			/**
 			 * Add animation for the given mode
 			 */
@@ -92,6 +108,8 @@ namespace grail {
 			VirtualPosition getInteractionPosition() const { return position; }
 			
 			void walk(const Path& path);
+			/// The rest of the current path (positions not reached yet)
+			const Path& getWalkPath() const { return walkPath; }
 			void walkTo(Actor::Ptr actor);
 			void walkTo(VirtualPosition p);
 			void walkStraight(VirtualPosition p);
@@ -0,0 +1,132 @@
+// vim: set noexpandtab:
+
+#include <algorithm>
+
+#include "actor_index.h"
+
+namespace grail {
+
+const int32_t ActorIndex::CELL_SIZE;
+
+int32_t ActorIndex::cellOf(int32_t x) {
+	// Round towards -infinity so cells don't double in size around 0
+	return (x >= 0) ? (x / CELL_SIZE) : -((-x + CELL_SIZE - 1) / CELL_SIZE);
+}
+
+void ActorIndex::insert(const Actor* actor, const Rect& bounds) {
+	VirtualPosition a = bounds.getTopLeft(), b = bounds.getTopLeft() + bounds.getSize();
+	if(a.getX() >= b.getX() || a.getY() >= b.getY()) { return; }
+
+	for(int32_t y = cellOf(a.getY()); y <= cellOf(b.getY() - 1); y++) {
+		for(int32_t x = cellOf(a.getX()); x <= cellOf(b.getX() - 1); x++) {
+			cells[Cell(x, y)].push_back(actor);
+		}
+	}
+}
+
+void ActorIndex::remove(const Actor* actor, const Rect& bounds) {
+	VirtualPosition a = bounds.getTopLeft(), b = bounds.getTopLeft() + bounds.getSize();
+	if(a.getX() >= b.getX() || a.getY() >= b.getY()) { return; }
+
+	for(int32_t y = cellOf(a.getY()); y <= cellOf(b.getY() - 1); y++) {
+		for(int32_t x = cellOf(a.getX()); x <= cellOf(b.getX() - 1); x++) {
+			std::map<Cell, std::vector<const Actor*> >::iterator cell = cells.find(Cell(x, y));
+			if(cell == cells.end()) { continue; }
+
+			std::vector<const Actor*>& v = cell->second;
+			std::vector<const Actor*>::iterator iter = std::find(v.begin(), v.end(), actor);
+			if(iter != v.end()) {
+				*iter = v.back();
+				v.pop_back();
+			}
+			if(v.empty()) {
+				cells.erase(cell);
+			}
+		}
+	}
+}
+
+void ActorIndex::update(const std::list<Actor::Ptr>& actors) {
+	generation++;
+
+	uint32_t depth = 0;
+	for(std::list<Actor::Ptr>::const_iterator iter = actors.begin(); iter != actors.end(); ++iter, ++depth) {
+		const Actor* actor = iter->get();
+		Rect bounds = (*iter)->getBounds();
+
+		std::map<const Actor*, Entry>::iterator e = entries.find(actor);
+		if(e == entries.end()) {
+			Entry& entry = entries[actor];
+			entry.actor = *iter;
+			entry.bounds = bounds;
+			insert(actor, bounds);
+			e = entries.find(actor);
+		}
+		else if(e->second.bounds.getTopLeft() != bounds.getTopLeft() ||
+				e->second.bounds.getSize() != bounds.getSize()) {
+			remove(actor, e->second.bounds);
+			insert(actor, bounds);
+			e->second.bounds = bounds;
+		}
+		e->second.depth = depth;
+		e->second.generation = generation;
+	}
+
+	// Drop whatever has left the scene
+	std::map<const Actor*, Entry>::iterator e = entries.begin();
+	while(e != entries.end()) {
+		if(e->second.generation != generation) {
+			remove(e->first, e->second.bounds);
+			entries.erase(e++);
+		}
+		else {
+			++e;
+		}
+	}
+}
+
+struct ActorIndex::CompareByDepth {
+	bool operator()(const Entry* a, const Entry* b) const {
+		return a->depth > b->depth;
+	}
+};
+
+Actor::Ptr ActorIndex::getActorAt(VirtualPosition p) const {
+	std::map<Cell, std::vector<const Actor*> >::const_iterator cell = cells.find(Cell(cellOf(p.getX()), cellOf(p.getY())));
+	if(cell == cells.end()) { return Actor::Ptr(); }
+
+	std::vector<const Entry*> candidates;
+	for(std::vector<const Actor*>::const_iterator iter = cell->second.begin(); iter != cell->second.end(); ++iter) {
+		const Entry& entry = entries.find(*iter)->second;
+		if(entry.bounds.hasPoint(p)) {
+			candidates.push_back(&entry);
+		}
+	}
+	std::sort(candidates.begin(), candidates.end(), CompareByDepth());
+
+	for(std::vector<const Entry*>::const_iterator iter = candidates.begin(); iter != candidates.end(); ++iter) {
+		if((*iter)->actor->hasPoint(p)) {
+			return (*iter)->actor;
+		}
+	}
+	return Actor::Ptr();
+}
+
+size_t ActorIndex::countCandidates(VirtualPosition p) const {
+	std::map<Cell, std::vector<const Actor*> >::const_iterator cell = cells.find(Cell(cellOf(p.getX()), cellOf(p.getY())));
+	if(cell == cells.end()) { return 0; }
+
+	size_t n = 0;
+	for(std::vector<const Actor*>::const_iterator iter = cell->second.begin(); iter != cell->second.end(); ++iter) {
+		if(entries.find(*iter)->second.bounds.hasPoint(p)) { n++; }
+	}
+	return n;
+}
+
+void ActorIndex::clear() {
+	entries.clear();
+	cells.clear();
+}
+
+} // namespace grail
+
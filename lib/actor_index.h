@@ -0,0 +1,82 @@
+// vim: set noexpandtab:
+
+#ifndef ACTOR_INDEX_H
+#define ACTOR_INDEX_H
+
+#include <list>
+#include <map>
+#include <utility>
+#include <vector>
+#include <stdint.h>
+
+#include "vector2d.h"
+#include "rect.h"
+#include "actor.h"
+
+namespace grail {
+
+/**
+ * Sparse uniform grid over the bounds (see Actor::getBounds()) of the
+ * actors of a scene, for finding the actor under the mouse without
+ * testing all of them pixel by pixel.
+ *
+ * update() is called once per frame with the actors in drawing order; only
+ * actors whose bounds changed since the last call are moved between grid
+ * cells, actors not passed anymore are dropped.
+ */
+class ActorIndex {
+	public:
+		/// Side length of a grid cell in virtual pixels
+		static const int32_t CELL_SIZE = 500;
+
+	private:
+		typedef std::pair<int32_t, int32_t> Cell;
+
+		struct Entry {
+			Actor::Ptr actor;
+			Rect bounds;
+			uint32_t depth;
+			uint32_t generation;
+			Entry() : bounds(VirtualSize(0, 0)), depth(0), generation(0) { }
+		};
+
+		std::map<const Actor*, Entry> entries;
+		std::map<Cell, std::vector<const Actor*> > cells;
+		uint32_t generation;
+
+		static int32_t cellOf(int32_t x);
+		void insert(const Actor* actor, const Rect& bounds);
+		void remove(const Actor* actor, const Rect& bounds);
+
+		struct CompareByDepth;
+
+	public:
+		ActorIndex() : generation(0) { }
+
+		/**
+		 * Bring the index up to date with $actors, which must be sorted
+		 * in the order they are drawn (back to front).
+		 */
+		void update(const std::list<Actor::Ptr>& actors);
+
+		/**
+		 * The topmost (last drawn) actor that has $p (in scene
+		 * coordinates), or an empty pointer. Only the actors whose bounds
+		 * contain $p are asked, front to back.
+		 */
+		Actor::Ptr getActorAt(VirtualPosition p) const;
+
+		/**
+		 * Number of actors whose bounds contain $p, i.e. how many
+		 * Actor::hasPoint() calls getActorAt() makes at most.
+		 */
+		size_t countCandidates(VirtualPosition p) const;
+
+		size_t size() const { return entries.size(); }
+		void clear();
+};
+
+} // namespace grail
+
+#endif // ACTOR_INDEX_H
+
@@ -9,7 +9,7 @@ namespace grail {
 const std::string DirectionAnimation::className = "DirectionAnimation";
 
 DirectionAnimation::DirectionAnimation(uint16_t directions, double offset) :
-	Animation(), currentDirection(0), directions(directions), offset(offset) {
+	Animation(), currentDirection(0), directions(directions), offset(offset), dirty(true) {
 	assert(directions > 0);
 	animations = new Animation::Ptr[directions];
 }
@@ -38,9 +38,21 @@ void DirectionAnimation::eachFrame(uint32_t ticks) {
 	return animations[currentDirection]->eachFrame(ticks);
 }
 
+bool DirectionAnimation::isDirty() const {
+	assert(directions > currentDirection);
+	return dirty || animations[currentDirection]->isDirty();
+}
+
+void DirectionAnimation::setClean() {
+	assert(directions > currentDirection);
+	animations[currentDirection]->setClean();
+	dirty = false;
+}
+
 void DirectionAnimation::setAnimation(uint16_t direction, Animation::Ptr animation) {
 	assert(direction < directions);
 	animations[direction] = animation;
+	if(direction == currentDirection) { dirty = true; }
 }
 
 } // namespace grail
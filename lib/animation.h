@@ -9,6 +9,7 @@
 #include <SDL.h>
 #include <boost/shared_ptr.hpp>
 
+#include "classes.h"
 #include "vector2d.h"
 #include "area.h"
 
@@ -32,6 +33,22 @@ class Animation : public Area {
 				(p.getY() >= 0) && (p.getY() < getSize().getY());
 		}
 		virtual void eachFrame(uint32_t ticks) { }
+		
+		/**
+		 * True iff renderAt() would draw something different than when
+		 * setClean() was called last (used for dirty rectangle rendering).
+		 * Animations that don't keep track assume they always change.
+		 */
+		virtual bool isDirty() const { return true; }
+		virtual void setClean() { }
+		
+		/**
+		 * For animations that always draw the same surface at their
+		 * position, that surface (so it can be flattened together with
+		 * others), an empty pointer otherwise.
+		 */
+		virtual boost::shared_ptr<Surface> getStaticSurface() const { return boost::shared_ptr<Surface>(); }
+		
 		virtual uint16_t getDirection() const { return 0; }
 		virtual void setDirection(uint16_t direction) { }
 		virtual void setDirection(VirtualPosition p) { }
@@ -54,6 +71,7 @@ class DirectionAnimation : public Animation {
 		uint16_t directions;
 		double offset;
 		Animation::Ptr* animations;
+		bool dirty;
 	public:
 		static const std::string className;
 		
@@ -64,12 +82,17 @@ class DirectionAnimation : public Animation {
 		VirtualSize getSize() const;
 		bool hasPoint(VirtualPosition) const;
 		void eachFrame(uint32_t);
+		bool isDirty() const;
+		void setClean();
 		
 		uint16_t getDirection() const { return currentDirection; }
 		
 		void setDirection(uint16_t direction) {
 			assert(direction < directions);
-			currentDirection = direction;
+			if(direction != currentDirection) {
+				currentDirection = direction;
+				dirty = true;
+			}
 		}
 		
 		void setDirection(VirtualPosition p) {
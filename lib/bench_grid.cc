@@ -0,0 +1,106 @@
+// vim: set noexpandtab:
+
+/*
+ * Compares the grid engine with the polygon (visibility graph) engine on
+ * the ground of the demo scene: The polygon from demo/init.lua, and the
+ * same area rasterized at the resolution of scene1/walkable_area.png.
+ */
+
+#include <cstdlib>
+#include <iostream>
+#include <vector>
+#include <sys/time.h>
+#include <boost/shared_ptr.hpp>
+
+#include "ground.h"
+#include "grid_map.h"
+#include "polygon.h"
+
+using namespace grail;
+
+namespace {
+	typedef Polygon<VirtualPosition, IsPosition> polygon_t;
+	typedef VirtualPosition P;
+
+	uint64_t microseconds() {
+		timeval tv;
+		gettimeofday(&tv, 0);
+		return (uint64_t)tv.tv_sec * 1000000 + tv.tv_usec;
+	}
+
+	double pathLength(P source, const Path& path) {
+		double l = 0;
+		for(Path::const_iterator iter = path.begin(); iter != path.end(); ++iter) {
+			l += (*iter - source).length();
+			source = *iter;
+		}
+		return l;
+	}
+
+	/// Time $queries on $ground, return the total path length
+	double run(Ground& ground, const std::vector<std::pair<P, P> >& queries, const char* name) {
+		double length = 0;
+		uint64_t start = microseconds();
+		for(size_t i = 0; i < queries.size(); ++i) {
+			Path path;
+			ground.getPath(queries[i].first, queries[i].second, path);
+			length += pathLength(queries[i].first, path);
+		}
+		uint64_t t = microseconds() - start;
+		std::cout << name << ": " << (double)t / queries.size() << " us/query, "
+			<< "average length " << length / queries.size() << "\n";
+		return length;
+	}
+}
+
+int main(int argc, char** argv) {
+	size_t n = (argc > 1) ? atoi(argv[1]) : 1000;
+
+	const int corners[][2] = {
+		{ 0, 2500 }, { 2650, 2610 }, { 4400, 2500 }, { 5770, 2615 },
+		{ 8000, 2605 }, { 8000, 3000 }, { 7330, 2985 },
+		{ 6730, 2860 }, { 6410, 3000 }, { 5960, 3000 },
+		{ 5200, 2780 }, { 4405, 2890 }, { 3575, 2815 },
+		{ 3105, 3000 }, { 0, 3000 }
+	};
+	polygon_t::Ptr area(new polygon_t);
+	for(size_t i = 0; i < sizeof(corners) / sizeof(corners[0]); ++i) {
+		area->push_back(P(corners[i][0], corners[i][1]));
+	}
+
+	Ground polygons;
+	polygons.addPolygon(area);
+	polygons.setPathCacheSize(0);
+
+	uint64_t start = microseconds();
+	polygons.generateMap();
+	std::cout << "polygon map: " << (microseconds() - start) << " us\n";
+
+	// walkable_area.png is 1600x101 pixels at (0, 2500), 5 units each
+	start = microseconds();
+	GridMap::Ptr grid(new GridMap(P(0, 2500), P(8000, 505), 1600, 101));
+	grid->fill(*area, true);
+	grid->update();
+	std::cout << "grid map: " << (microseconds() - start) << " us, "
+		<< grid->getMemoryUsage() << " bytes\n";
+
+	Ground cells;
+	cells.setGrid(grid);
+	cells.setEngine(Ground::ENGINE_GRID);
+	cells.setPathCacheSize(0);
+
+	std::vector<std::pair<P, P> > queries;
+	srand(1);
+	while(queries.size() < n) {
+		P source(rand() % 8000, 2500 + rand() % 500), target(rand() % 8000, 2500 + rand() % 500);
+		if(area->hasPoint(source) && area->hasPoint(target)) {
+			queries.push_back(std::make_pair(source, target));
+		}
+	}
+
+	double l1 = run(polygons, queries, "polygon");
+	double l2 = run(cells, queries, "grid");
+	std::cout << "grid paths are " << (l2 / l1 - 1.0) * 100.0 << "% longer\n";
+	return 0;
+}
+
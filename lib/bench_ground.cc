@@ -0,0 +1,414 @@
+// vim: set noexpandtab:
+
+/*
+ * Pathfinding benchmark: Builds grounds from generated polygons (stars,
+ * a concave maze, rooms with nested holes), the demo scene and any .scene
+ * files given on the command line, times map generation and the usual
+ * queries on them with the visibility graph and the navmesh engine, and
+ * writes the results as JSON.
+ *
+ * Usage: bench_ground [-n queries] [-s seed] [-o output.json] [file.scene ...]
+ */
+
+#include <cmath>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+#include <sys/time.h>
+#include <boost/shared_ptr.hpp>
+
+#include "ground.h"
+#include "polygon.h"
+#include "utils.h"
+
+using namespace grail;
+
+namespace {
+	typedef Polygon<VirtualPosition, IsPosition> polygon_t;
+	typedef VirtualPosition P;
+
+	struct Layout {
+		std::string name;
+		/// In the order they have to be added to the ground
+		std::vector<polygon_t::Ptr> polygons;
+	};
+
+	uint64_t microseconds() {
+		timeval tv;
+		gettimeofday(&tv, 0);
+		return (uint64_t)tv.tv_sec * 1000000 + tv.tv_usec;
+	}
+
+	int randomInt(int lo, int hi) {
+		return lo + rand() % (hi - lo + 1);
+	}
+
+	polygon_t::Ptr box(int x0, int y0, int x1, int y1) {
+		polygon_t::Ptr p(new polygon_t);
+		p->push_back(P(x0, y0));
+		p->push_back(P(x1, y0));
+		p->push_back(P(x1, y1));
+		p->push_back(P(x0, y1));
+		return p;
+	}
+
+	//
+	// Generators
+	//
+
+	/// Star with $n corners alternating between an outer and an inner radius
+	Layout star(int n) {
+		Layout s;
+		s.name = "star-" + toString(n);
+		polygon_t::Ptr p(new polygon_t);
+		for(int i = 0; i < n; ++i) {
+			double a = 2.0 * M_PI * i / n, r = (i % 2) ? randomInt(300, 500) : randomInt(900, 1100);
+			p->push_back(P((int)(r * cos(a)), (int)(r * sin(a))));
+		}
+		s.polygons.push_back(p);
+		return s;
+	}
+
+	/// A corridor winding around $teeth walls reaching in from top and bottom
+	Layout maze(int teeth) {
+		Layout s;
+		s.name = "maze-" + toString(teeth);
+		int w = (teeth + 1) * 100;
+		polygon_t::Ptr p(new polygon_t);
+		p->push_back(P(0, 0));
+		for(int i = 1; i <= teeth; i += 2) {
+			int x = i * 100, depth = randomInt(750, 850);
+			p->push_back(P(x - 10, 0));
+			p->push_back(P(x - 10, depth));
+			p->push_back(P(x + 10, depth));
+			p->push_back(P(x + 10, 0));
+		}
+		p->push_back(P(w, 0));
+		p->push_back(P(w, 1000));
+		for(int i = teeth - (teeth % 2); i >= 2; i -= 2) {
+			int x = i * 100, depth = randomInt(150, 250);
+			p->push_back(P(x + 10, 1000));
+			p->push_back(P(x + 10, depth));
+			p->push_back(P(x - 10, depth));
+			p->push_back(P(x - 10, 1000));
+		}
+		p->push_back(P(0, 1000));
+		s.polygons.push_back(p);
+		return s;
+	}
+
+	/**
+	 * A room with $n x $n boxes, every other one with a walkable island
+	 * in it that has a hole itself.
+	 */
+	Layout nestedHoles(int n) {
+		Layout s;
+		s.name = "nested-" + toString(n);
+		s.polygons.push_back(box(0, 0, n * 300, n * 300));
+		std::vector<polygon_t::Ptr> islands, inner;
+		for(int i = 0; i < n; ++i) {
+			for(int j = 0; j < n; ++j) {
+				int x = i * 300 + randomInt(30, 70), y = j * 300 + randomInt(30, 70);
+				s.polygons.push_back(box(x, y, x + 200, y + 200));
+				if((i + j) % 2 == 0) {
+					islands.push_back(box(x + 40, y + 40, x + 160, y + 160));
+					inner.push_back(box(x + 80, y + 80, x + 120, y + 120));
+				}
+			}
+		}
+		s.polygons.insert(s.polygons.end(), islands.begin(), islands.end());
+		s.polygons.insert(s.polygons.end(), inner.begin(), inner.end());
+		return s;
+	}
+
+	/// The ground of the demo scene (demo/init.lua)
+	Layout demo() {
+		const int corners[][2] = {
+			{ 0, 2500 }, { 2650, 2610 }, { 4400, 2500 }, { 5770, 2615 },
+			{ 8000, 2605 }, { 8000, 3000 }, { 7330, 2985 },
+			{ 6730, 2860 }, { 6410, 3000 }, { 5960, 3000 },
+			{ 5200, 2780 }, { 4405, 2890 }, { 3575, 2815 },
+			{ 3105, 3000 }, { 0, 3000 }
+		};
+		Layout s;
+		s.name = "demo-scene1";
+		polygon_t::Ptr p(new polygon_t);
+		for(size_t i = 0; i < sizeof(corners) / sizeof(corners[0]); ++i) {
+			p->push_back(P(corners[i][0], corners[i][1]));
+		}
+		s.polygons.push_back(p);
+		return s;
+	}
+
+	/**
+	 * Polygons of a .scene file (as written by the scene editor): The
+	 * biggest one is the walkable area, the ones lying inside of it
+	 * become holes, everything else (e.g. hotspots) is ignored.
+	 */
+	bool loadScene(const std::string& path, Layout& s) {
+		std::ifstream in(path.c_str());
+		if(!in) { return false; }
+
+		std::vector<polygon_t::Ptr> polygons;
+		polygon_t::Ptr nodes;
+		bool isPolygon = false;
+		std::string line;
+		while(true) {
+			bool more = !std::getline(in, line).fail();
+			line = strip(line);
+			if(!more || startsWith(line, "[")) {
+				if(isPolygon && nodes && nodes->size() >= 3) { polygons.push_back(nodes); }
+				if(!more) { break; }
+				nodes.reset();
+				isPolygon = false;
+				continue;
+			}
+
+			std::pair<std::string, std::string> kv = split2(line);
+			std::string key = strip(kv.first), value = strip(kv.second);
+			if(key == "type") {
+				isPolygon = (value == "Polygon");
+			}
+			else if(key == "nodes") {
+				nodes.reset(new polygon_t);
+				for(SplitIterator iter(value, ";"); iter != iter.end(); ++iter) {
+					std::pair<std::string, std::string> xy = split2(*iter, ",");
+					nodes->push_back(P(fromString<int>(xy.first), fromString<int>(xy.second)));
+				}
+			}
+		}
+		if(polygons.empty()) { return false; }
+
+		size_t outer = 0;
+		for(size_t i = 1; i < polygons.size(); ++i) {
+			if(std::fabs(polygons[i]->getArea()) > std::fabs(polygons[outer]->getArea())) { outer = i; }
+		}
+		s.name = path;
+		s.polygons.push_back(polygons[outer]);
+		for(size_t i = 0; i < polygons.size(); ++i) {
+			bool inside = (i != outer);
+			for(polygon_t::ConstNodeIterator iter = polygons[i]->beginNodes(); inside && iter != polygons[i]->endNodes(); ++iter) {
+				inside = polygons[outer]->hasPoint(*iter) && !polygons[outer]->hasBoundaryPoint(*iter);
+			}
+			if(inside) { s.polygons.push_back(polygons[i]); }
+		}
+		return true;
+	}
+
+	//
+	// Measuring
+	//
+
+	void collectWalkable(Ground::Component* c, std::vector<Ground::Component*>& components) {
+		components.push_back(c);
+		for(Ground::Component::const_hole_iter_t h = c->getHoles().begin(); h != c->getHoles().end(); ++h) {
+			for(Ground::Component::const_hole_iter_t i = (*h)->getHoles().begin(); i != (*h)->getHoles().end(); ++i) {
+				collectWalkable(*i, components);
+			}
+		}
+	}
+
+	double pathLength(P source, const Path& path) {
+		double l = 0;
+		for(Path::const_iterator iter = path.begin(); iter != path.end(); ++iter) {
+			l += (*iter - source).length();
+			source = *iter;
+		}
+		return l;
+	}
+
+	/// Random point in the bounding box of $p grown by $margin on each side
+	P randomPoint(const polygon_t& p, int margin) {
+		return P(randomInt(p.getTopLeft().getX() - margin, p.getBottomRight().getX() + margin),
+			randomInt(p.getTopLeft().getY() - margin, p.getBottomRight().getY() + margin));
+	}
+
+	class Json {
+			std::ostream& out;
+			bool first;
+			void separate() { if(!first) { out << ","; } first = false; }
+		public:
+			Json(std::ostream& out) : out(out), first(true) { }
+			void begin(char c) { separate(); out << c; first = true; }
+			void end(char c) { out << c; first = false; }
+			void key(const std::string& k) { string(k); out << ":"; first = true; }
+			void string(const std::string& s) {
+				separate();
+				out << '"';
+				for(std::string::const_iterator c = s.begin(); c != s.end(); ++c) {
+					if(*c == '"' || *c == '\\') { out << '\\'; }
+					out << *c;
+				}
+				out << '"';
+			}
+			void number(double x) { separate(); out << x; }
+			template<typename T> void field(const std::string& k, T x) { key(k); number(x); }
+			void field(const std::string& k, const std::string& s) { key(k); string(s); }
+	};
+
+	void run(const Layout& scene, Ground::Engine engine, size_t queries, unsigned seed, Json& json) {
+		// Same queries for all engines
+		srand(seed);
+		
+		Ground g;
+		g.setEngine(engine);
+		g.setPathCacheSize(0);
+		for(std::vector<polygon_t::Ptr>::const_iterator iter = scene.polygons.begin(); iter != scene.polygons.end(); ++iter) {
+			g.addPolygon(*iter);
+		}
+		if(!g.rootComponent) { return; }
+
+		std::vector<Ground::Component*> components;
+		collectWalkable(g.rootComponent, components);
+		const polygon_t& outer = g.rootComponent->getOuterBoundary();
+		int margin = (outer.getBottomRight().getX() - outer.getTopLeft().getX()) / 10;
+
+		json.begin('{');
+		json.field("engine", std::string(engine == Ground::ENGINE_NAVMESH ? "navmesh" : "visibility_graph"));
+		json.field("components", components.size());
+
+		uint64_t start = microseconds();
+		for(std::vector<Ground::Component*>::iterator iter = components.begin(); iter != components.end(); ++iter) {
+			g.generateMapForComponent(*iter);
+		}
+		json.field("generateMapForComponent_us", microseconds() - start);
+		g.prepareConcurrentQueries();
+
+		size_t mapNodes = 0;
+		for(std::vector<Ground::Component*>::iterator iter = components.begin(); iter != components.end(); ++iter) {
+			mapNodes += (engine == Ground::ENGINE_NAVMESH) ? (*iter)->getNavMesh().size() : (*iter)->getGraph().getPositions().size();
+		}
+		json.field("mapNodes", mapNodes);
+
+		// Pairs of points in the walkable area of the root component
+		std::vector<std::pair<P, P> > pairs;
+		for(size_t tries = 0; pairs.size() < queries && tries < 100 * queries; ++tries) {
+			P a = randomPoint(outer, 0), b = randomPoint(outer, 0);
+			if(g.isWalkable(g.rootComponent, a) && g.isWalkable(g.rootComponent, b)) {
+				pairs.push_back(std::make_pair(a, b));
+			}
+		}
+		if(pairs.empty()) {
+			json.end('}');
+			return;
+		}
+
+		size_t reachable = 0, edges = 0;
+		start = microseconds();
+		for(size_t i = 0; i < pairs.size(); ++i) {
+			if(g.directReachable(g.rootComponent, pairs[i].first, pairs[i].second)) { reachable++; }
+		}
+		json.field("directReachable_us", (double)(microseconds() - start) / pairs.size());
+		for(size_t i = 0; i < pairs.size(); ++i) {
+			edges += g.rootComponent->getEdgeGrid().countCandidates(Line(pairs[i].first, pairs[i].second));
+		}
+		json.field("directReachable_fraction", (double)reachable / pairs.size());
+		json.field("edgesTested", (double)edges / pairs.size());
+
+		// Paths between arbitrary points, some of them off the ground
+		std::vector<std::pair<P, P> > ends;
+		for(size_t i = 0; i < queries; ++i) {
+			ends.push_back(std::make_pair(randomPoint(outer, margin), randomPoint(outer, margin)));
+		}
+		double length = 0;
+		start = microseconds();
+		for(size_t i = 0; i < ends.size(); ++i) {
+			Path path;
+			g.getPath(ends[i].first, ends[i].second, path);
+			length += pathLength(ends[i].first, path);
+		}
+		json.field("getPath_us", (double)(microseconds() - start) / ends.size());
+		json.field("pathLength", length / ends.size());
+
+		// Same queries once more (untimed) for the search statistics, a
+		// fresh search space each so queries without a search count as 0
+		size_t expanded = 0;
+		for(size_t i = 0; i < ends.size(); ++i) {
+			Ground::SearchSpace space;
+			Path path;
+			g.findPath(ends[i].first, ends[i].second, space, path);
+			expanded += (engine == Ground::ENGINE_NAVMESH) ? space.navMesh.getExpanded() : space.waypoints.getExpandedCount();
+		}
+		json.field("expanded", (double)expanded / ends.size());
+
+		start = microseconds();
+		for(size_t i = 0; i < ends.size(); ++i) {
+			g.findWalkablePoint(g.rootComponent, ends[i].first);
+		}
+		json.field("findInnerPoint_us", (double)(microseconds() - start) / ends.size());
+
+		json.end('}');
+	}
+}
+
+int main(int argc, char** argv) {
+	size_t queries = 1000;
+	unsigned seed = 1;
+	std::string output;
+	std::vector<std::string> files;
+	for(int i = 1; i < argc; ++i) {
+		std::string arg = argv[i];
+		if(arg == "-n" && i + 1 < argc) { queries = atoi(argv[++i]); }
+		else if(arg == "-s" && i + 1 < argc) { seed = atoi(argv[++i]); }
+		else if(arg == "-o" && i + 1 < argc) { output = argv[++i]; }
+		else { files.push_back(arg); }
+	}
+
+	srand(seed);
+	std::vector<Layout> scenes;
+	scenes.push_back(star(16));
+	scenes.push_back(star(256));
+	scenes.push_back(maze(20));
+	scenes.push_back(maze(100));
+	scenes.push_back(nestedHoles(4));
+	scenes.push_back(nestedHoles(10));
+	scenes.push_back(demo());
+	for(std::vector<std::string>::iterator iter = files.begin(); iter != files.end(); ++iter) {
+		Layout s;
+		if(!loadScene(*iter, s)) {
+			std::cerr << "bench_ground: no polygons in " << *iter << "\n";
+			return 1;
+		}
+		scenes.push_back(s);
+	}
+
+	std::ofstream file;
+	if(!output.empty()) {
+		file.open(output.c_str());
+		if(!file) {
+			std::cerr << "bench_ground: can't write " << output << "\n";
+			return 1;
+		}
+	}
+	std::ostream& out = output.empty() ? std::cout : file;
+
+	Json json(out);
+	json.begin('{');
+	json.field("queries", queries);
+	json.field("seed", seed);
+	json.key("scenes");
+	json.begin('[');
+	for(std::vector<Layout>::iterator s = scenes.begin(); s != scenes.end(); ++s) {
+		size_t vertices = 0;
+		for(std::vector<polygon_t::Ptr>::iterator p = s->polygons.begin(); p != s->polygons.end(); ++p) {
+			vertices += (*p)->size();
+		}
+		json.begin('{');
+		json.field("name", s->name);
+		json.field("polygons", s->polygons.size());
+		json.field("vertices", vertices);
+		json.key("results");
+		json.begin('[');
+		run(*s, Ground::ENGINE_VISIBILITY_GRAPH, queries, seed, json);
+		run(*s, Ground::ENGINE_NAVMESH, queries, seed, json);
+		json.end(']');
+		json.end('}');
+	}
+	json.end(']');
+	json.end('}');
+	out << "\n";
+	return 0;
+}
+
@@ -24,6 +24,7 @@ namespace grail {
 			}
 			
 			VirtualSize getSize() const { return size; }
+			bool isDirty() const { return false; }
 	};
 	
 }
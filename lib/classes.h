@@ -9,6 +9,7 @@ namespace grail {
 	class Action;
 	class ActionText;
 	class Actor;
+	class ActorIndex;
 	class Animation;
 	class Area;
 	class Audio;
@@ -23,16 +24,26 @@ namespace grail {
 	class DirectoryIteratorImpl;
 	class DirectoryIteratorImpl;
 	class DirectoryResourceHandler;
+	class DirtyRegion;
+	class DirtyTracker;
 	class Event;
 	class Exception;
 	class Font;
 	class Game;
+	class GridMap;
+	class GridSearch;
 	class Ground;
 	class Image;
 	class ImageSprite;
 	class Line;
 	class LineIterator;
 	class MainLoop;
+	class NavMesh;
+	class NavMeshSearch;
+	class PathCache;
+	class PathService;
+	class PathTable;
+	class PathTask;
 	template<typename Node, typename GetPosition> class Polygon;
 	class Rect;
 	class Resource;
@@ -53,9 +64,13 @@ namespace grail {
 	class UserInterfaceElement;
 	class ValueNotSet;
 	class Viewport;
+	class VisibilitySweep;
 	class WaitTask;
 	class WallWaypoint;
 	class Waypoint;
+	class WaypointGraph;
+	class WaypointSearch;
+	class WorkerPool;
 	
 } // namespace grail
 
@@ -9,6 +9,7 @@
 #include "dialog_line.h"
 #include "actor.h"
 #include "text.h"
+#include "dirty_region.h"
 
 namespace grail {
 
@@ -26,6 +27,10 @@ namespace grail {
 			virtual void eachFrame(uint32_t ticks) = 0;
 			virtual void renderAt(SDL_Surface* target, uint32_t ticks, VirtualPosition p) = 0;
 
+			// Add the screen area that changed since the last call to
+			// region. Frontends that don't keep track mark everything.
+			virtual void collectDirty(DirtyRegion& region, VirtualPosition p) { region.addAll(); }
+
 		protected:
 			// map of actors to the text objects used to render
 			// their dialog
@@ -64,6 +64,20 @@ namespace grail {
 		}
 	}
 
+	VirtualPosition DialogFrontendSubtitle::getRenderPosition(const Subtitle& subtitle, int n) const {
+		VirtualPosition renderPosition = subtitlePosition;
+
+		// center the text around the rener position if set to centered
+		if (centered) {
+			renderPosition = renderPosition - (subtitle.getSize()/2);
+		}
+
+		if (n > 1) {
+			renderPosition.setY(renderPosition.getY() - (200 * (n - 1)));
+		}
+		return renderPosition;
+	}
+
 	void DialogFrontendSubtitle::renderAt(SDL_Surface* target, uint32_t ticks, VirtualPosition p) {
 
 		// count active subs
@@ -78,20 +92,36 @@ namespace grail {
 
 				activeSubtitles++;
 
-				VirtualPosition renderPosition = subtitlePosition;
+				(*riter)->renderAt(target, ticks, getRenderPosition(**riter, activeSubtitles));
+			}
+		}
+	}
+
+	void DialogFrontendSubtitle::collectDirty(DirtyRegion& region, VirtualPosition p) {
 
-				// center the text around the rener position if set to centered
-				if (centered) {
-					renderPosition = renderPosition - ((*riter)->getSize()/2);
-				}
+		// same order as in renderAt()
+		size_t activeSubtitles = 0;
+		for (std::vector<boost::shared_ptr<Subtitle> >::reverse_iterator riter = subtitles.rbegin();
+			riter != subtitles.rend(); ++riter) {
 
-				if (activeSubtitles > 1) {
-					renderPosition.setY(renderPosition.getY() - (200 * (activeSubtitles - 1)));
+			if ((*riter)->isStarted()) {
+
+				activeSubtitles++;
+				if (dirtyTrackers.size() < activeSubtitles) {
+					dirtyTrackers.resize(activeSubtitles);
 				}
 
-				(*riter)->renderAt(target, ticks, (renderPosition));
+				dirtyTrackers[activeSubtitles - 1].update(region,
+					getRenderPosition(**riter, activeSubtitles), (*riter)->getSize(),
+					(*riter)->isDirty());
+				(*riter)->setClean();
 			}
 		}
+
+		// subtitles that went away since last time
+		for (size_t i = activeSubtitles; i < dirtyTrackers.size(); i++) {
+			dirtyTrackers[i].hide(region);
+		}
 	}
 
 	void DialogFrontendSubtitle::setFont(std::string path) {
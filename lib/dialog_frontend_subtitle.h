@@ -21,6 +21,10 @@ namespace grail {
 			bool showSpeakersName;
 
 			std::vector<boost::shared_ptr<Subtitle> > subtitles;
+			std::vector<DirtyTracker> dirtyTrackers; // one per subtitle on screen
+
+			// where the n-th started subtitle (counted from the newest) is drawn
+			VirtualPosition getRenderPosition(const Subtitle& subtitle, int n) const;
 
 		public:
 			DialogFrontendSubtitle();
@@ -28,6 +32,7 @@ namespace grail {
 
 			void eachFrame(uint32_t ticks);
 			virtual void renderAt(SDL_Surface* target, uint32_t ticks, VirtualPosition p);
+			virtual void collectDirty(DirtyRegion& region, VirtualPosition p);
 
 			void setFont(std::string);
 			void setCentered(bool); //set whether text should be centered or not
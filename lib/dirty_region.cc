@@ -0,0 +1,136 @@
+// vim: set noexpandtab:
+
+#include <algorithm>
+
+#include "dirty_region.h"
+
+using std::min;
+using std::max;
+
+namespace grail {
+
+void DirtyRegion::merge(int32_t x1, int32_t y1, int32_t x2, int32_t y2) {
+	// Grow the rectangle by everything it touches until it touches
+	// nothing anymore
+	bool grown = true;
+	while(grown) {
+		grown = false;
+		for(size_t i = 0; i < rects.size(); i++) {
+			const SDL_Rect& r = rects[i];
+			if(r.x > x2 || r.y > y2 || r.x + r.w < x1 || r.y + r.h < y1) { continue; }
+
+			x1 = min<int32_t>(x1, r.x); y1 = min<int32_t>(y1, r.y);
+			x2 = max<int32_t>(x2, r.x + r.w); y2 = max<int32_t>(y2, r.y + r.h);
+			rects[i] = rects.back();
+			rects.pop_back();
+			grown = true;
+			break;
+		}
+	}
+
+	SDL_Rect r;
+	r.x = x1; r.y = y1;
+	r.w = x2 - x1; r.h = y2 - y1;
+	rects.push_back(r);
+}
+
+void DirtyRegion::add(PhysicalPosition topLeft, PhysicalSize size) {
+	if(all) { return; }
+
+	int32_t x1 = max<int32_t>(topLeft.getX(), 0);
+	int32_t y1 = max<int32_t>(topLeft.getY(), 0);
+	int32_t x2 = min<int32_t>(topLeft.getX() + size.getX(), bounds.getX());
+	int32_t y2 = min<int32_t>(topLeft.getY() + size.getY(), bounds.getY());
+	if(x1 >= x2 || y1 >= y2) { return; }
+
+	merge(x1, y1, x2, y2);
+
+	if(rects.size() > MAX_RECTS) {
+		SDL_Rect r = rects.back();
+		rects.pop_back();
+		while(!rects.empty()) {
+			const SDL_Rect& s = rects.back();
+			int32_t right = max<int32_t>(r.x + r.w, s.x + s.w), bottom = max<int32_t>(r.y + r.h, s.y + s.h);
+			r.x = min(r.x, s.x); r.y = min(r.y, s.y);
+			r.w = right - r.x; r.h = bottom - r.y;
+			rects.pop_back();
+		}
+		rects.push_back(r);
+	}
+}
+
+void DirtyRegion::toPhysical(VirtualPosition topLeft, VirtualSize size, PhysicalPosition& a, PhysicalPosition& b) {
+	// Conversion truncates, so round outwards by a pixel
+	a = conv<VirtualPosition, PhysicalPosition>(topLeft) - PhysicalPosition(1, 1);
+	b = conv<VirtualPosition, PhysicalPosition>(topLeft + size) + PhysicalPosition(1, 1);
+}
+
+void DirtyRegion::add(VirtualPosition topLeft, VirtualSize size) {
+	PhysicalPosition a, b;
+	toPhysical(topLeft, size, a, b);
+	add(a, b - a);
+}
+
+void DirtyRegion::setScroll(PhysicalPosition delta) {
+	scroll = delta;
+
+	int32_t w = bounds.getX(), h = bounds.getY();
+	int32_t dx = delta.getX(), dy = delta.getY();
+	if(dx > 0) { add(PhysicalPosition(0, 0), PhysicalSize(dx, h)); }
+	else if(dx < 0) { add(PhysicalPosition(w + dx, 0), PhysicalSize(-dx, h)); }
+	if(dy > 0) { add(PhysicalPosition(0, 0), PhysicalSize(w, dy)); }
+	else if(dy < 0) { add(PhysicalPosition(0, h + dy), PhysicalSize(w, -dy)); }
+}
+
+uint64_t DirtyRegion::getArea() const {
+	if(all) { return (uint64_t)bounds.getX() * bounds.getY(); }
+
+	uint64_t area = 0;
+	for(std::vector<SDL_Rect>::const_iterator iter = rects.begin(); iter != rects.end(); ++iter) {
+		area += (uint64_t)iter->w * iter->h;
+	}
+	return area;
+}
+
+void DirtyRegion::clear() {
+	rects.clear();
+	scroll = PhysicalPosition();
+	all = false;
+}
+
+//
+//
+//
+
+void DirtyTracker::update(DirtyRegion& region, VirtualPosition topLeft, VirtualSize size, bool changed) {
+	PhysicalPosition a, b;
+	DirtyRegion::toPhysical(topLeft, size, a, b);
+	update(region, a, b - a, changed);
+}
+
+void DirtyTracker::update(DirtyRegion& region, PhysicalPosition topLeft, PhysicalSize size, bool changed) {
+	PhysicalPosition a = topLeft, b = topLeft + size;
+	
+	// Where the last frame's pixels are now
+	PhysicalPosition scroll = region.getScroll();
+	PhysicalPosition oldA = this->topLeft + scroll, oldB = bottomRight + scroll;
+
+	if(!drawn || changed || a != oldA || b != oldB) {
+		if(drawn) { region.add(oldA, oldB - oldA); }
+		region.add(a, b - a);
+	}
+	this->topLeft = a;
+	bottomRight = b;
+	drawn = true;
+}
+
+void DirtyTracker::hide(DirtyRegion& region) {
+	if(drawn) {
+		PhysicalPosition scroll = region.getScroll();
+		region.add(topLeft + scroll, bottomRight - topLeft);
+		drawn = false;
+	}
+}
+
+} // namespace grail
+
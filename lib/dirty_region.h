@@ -0,0 +1,114 @@
+// vim: set noexpandtab:
+
+#ifndef DIRTY_REGION_H
+#define DIRTY_REGION_H
+
+#include <vector>
+#include <stdint.h>
+
+#include <SDL.h>
+
+#include "vector2d.h"
+
+namespace grail {
+
+/**
+ * The parts of the screen that have to be redrawn for the next frame, as a
+ * (short) list of disjoint rectangles in physical pixels.
+ *
+ * Rectangles are clipped to the bounds and merged with every rectangle they
+ * overlap or touch, so nothing is drawn twice. If there are more than
+ * MAX_RECTS of them they are merged into one.
+ *
+ * When the last frame has been scrolled (moved on the screen as a whole to
+ * reuse it), getScroll() tells by how much, so that whatever was drawn
+ * last frame is looked for at its new place.
+ */
+class DirtyRegion {
+	public:
+		static const size_t MAX_RECTS = 16;
+
+	private:
+		std::vector<SDL_Rect> rects;
+		PhysicalSize bounds;
+		PhysicalPosition scroll;
+		bool all;
+
+		void merge(int32_t x1, int32_t y1, int32_t x2, int32_t y2);
+
+	public:
+		DirtyRegion() : all(false) { }
+
+		/// Size of the screen, nothing outside of it is ever dirty
+		void setBounds(PhysicalSize size) { bounds = size; }
+		PhysicalSize getBounds() const { return bounds; }
+
+		void add(PhysicalPosition topLeft, PhysicalSize size);
+
+		/// Same as above in virtual screen coordinates
+		void add(VirtualPosition topLeft, VirtualSize size);
+
+		/**
+		 * The physical rectangle (top left and bottom right corner) that
+		 * something rendered at $topLeft with $size may touch.
+		 */
+		static void toPhysical(VirtualPosition topLeft, VirtualSize size, PhysicalPosition& a, PhysicalPosition& b);
+
+		/**
+		 * The last frame has been moved by $delta, mark the strips it
+		 * left uncovered dirty.
+		 */
+		void setScroll(PhysicalPosition delta);
+		PhysicalPosition getScroll() const { return scroll; }
+
+		/// Mark the whole screen dirty
+		void addAll() { all = true; }
+
+		bool isAll() const { return all; }
+		bool empty() const { return !all && rects.empty(); }
+
+		/// Number of dirty pixels
+		uint64_t getArea() const;
+
+		/// The dirty rectangles, meaningless if isAll()
+		const std::vector<SDL_Rect>& getRects() const { return rects; }
+
+		/// Mark nothing dirty and forget the scroll
+		void clear();
+};
+
+/**
+ * Remembers where on the screen something was drawn last, so when it
+ * moves, resizes or changes its look both the area it left and the one
+ * it covers now can be reported.
+ *
+ * Positions are compared in physical pixels, something that moved exactly
+ * like the scrolled frame (see DirtyRegion::getScroll()) is already in the
+ * right place.
+ */
+class DirtyTracker {
+		PhysicalPosition topLeft, bottomRight;
+		bool drawn;
+
+	public:
+		DirtyTracker() : drawn(false) { }
+
+		/**
+		 * Tell the tracker the thing is drawn to $topLeft, $size (virtual
+		 * screen coordinates) now. If that differs from last time (moved
+		 * by the scroll) or $changed is true, both areas are added to
+		 * $region.
+		 */
+		void update(DirtyRegion& region, VirtualPosition topLeft, VirtualSize size, bool changed);
+		
+		/// Same as above with the physical area the thing may touch
+		void update(DirtyRegion& region, PhysicalPosition topLeft, PhysicalSize size, bool changed);
+
+		/// Tell the tracker the thing isn't drawn anymore.
+		void hide(DirtyRegion& region);
+};
+
+} // namespace grail
+
+#endif // DIRTY_REGION_H
+
@@ -0,0 +1,390 @@
+// vim: set noexpandtab:
+
+#include <algorithm>
+#include <cstdlib> // abs
+
+#include "edge_arrays.h"
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+	#define EDGE_ARRAYS_X86 1
+	#include <immintrin.h>
+#else
+	#define EDGE_ARRAYS_X86 0
+#endif
+
+namespace grail {
+
+namespace {
+	/*
+	 * The kernels all get the coordinate arrays of the edges to test
+	 * (already offset to the first one) and their number.
+	 */
+	typedef bool (*HasPointKernel)(const double* ax, const double* ay, const double* bx, const double* by, size_t n,
+			double px, double py);
+	typedef void (*CrossingsKernel)(const double* ax, const double* ay, const double* bx, const double* by, size_t n,
+			double px, double py, size_t& right, size_t& left);
+	typedef bool (*IntersectsKernel)(const double* ax, const double* ay, const double* bx, const double* by, size_t n,
+			double lax, double lay, double lbx, double lby, int flags);
+
+	struct Kernels {
+		HasPointKernel hasPoint;
+		CrossingsKernel countCrossings;
+		IntersectsKernel intersects;
+	};
+
+	//
+	// Scalar versions, these also do the remainders of the vector versions
+	//
+
+	int64_t cross(int64_t x1, int64_t y1, int64_t x2, int64_t y2) {
+		return x1 * y2 - y1 * x2;
+	}
+
+	bool hasPointScalar(const double* ax, const double* ay, const double* bx, const double* by, size_t n,
+			double px, double py) {
+		for(size_t i = 0; i < n; ++i) {
+			int64_t ex = (int64_t)bx[i] - (int64_t)ax[i], ey = (int64_t)by[i] - (int64_t)ay[i];
+			int64_t qx = (int64_t)px - (int64_t)ax[i], qy = (int64_t)py - (int64_t)ay[i];
+			if(cross(ex, ey, qx, qy) != 0) { continue; }
+			int64_t dot = ex * qx + ey * qy;
+			if(dot >= 0 && dot <= ex * ex + ey * ey) { return true; }
+		}
+		return false;
+	}
+
+	void countCrossingsScalar(const double* ax, const double* ay, const double* bx, const double* by, size_t n,
+			double px, double py, size_t& right, size_t& left) {
+		for(size_t i = 0; i < n; ++i) {
+			if((ay[i] < py) == (by[i] < py)) { continue; }
+			// x of the crossing minus px, times dy
+			int64_t dy = (int64_t)by[i] - (int64_t)ay[i];
+			int64_t w = ((int64_t)ax[i] - (int64_t)px) * dy + ((int64_t)bx[i] - (int64_t)ax[i]) * ((int64_t)py - (int64_t)ay[i]);
+			if(w == 0) { continue; }
+			if((w > 0) == (dy > 0)) { right++; }
+			else { left++; }
+		}
+	}
+
+	bool opposite(int64_t a, int64_t b) { return (a < 0 && b > 0) || (a > 0 && b < 0); }
+
+	bool intersectsScalar(const double* ax, const double* ay, const double* bx, const double* by, size_t n,
+			double lax, double lay, double lbx, double lby, int flags) {
+		int64_t x1 = (int64_t)lax, y1 = (int64_t)lay, x2 = (int64_t)lbx, y2 = (int64_t)lby;
+		int64_t lx = x2 - x1, ly = y2 - y1;
+		for(size_t i = 0; i < n; ++i) {
+			int64_t ex1 = (int64_t)ax[i], ey1 = (int64_t)ay[i], ex2 = (int64_t)bx[i], ey2 = (int64_t)by[i];
+			int64_t ex = ex2 - ex1, ey = ey2 - ey1;
+
+			// The end points of the edge seen from l and the other way round
+			int64_t c1 = cross(lx, ly, ex1 - x1, ey1 - y1), c2 = cross(lx, ly, ex2 - x1, ey2 - y1);
+			int64_t c3 = cross(ex, ey, x1 - ex1, y1 - ey1), c4 = cross(ex, ey, x2 - ex1, y2 - ey1);
+
+			bool ok12 = ((flags & Line::OTHER_BOUNDARY) && ((c1 == 0) != (c2 == 0))) ||
+				((flags & Line::OTHER_INNER) && opposite(c1, c2));
+			bool ok34 = ((flags & Line::THIS_BOUNDARY) && ((c3 == 0) != (c4 == 0))) ||
+				((flags & Line::THIS_INNER) && opposite(c3, c4));
+			if(ok12 && ok34) { return true; }
+		}
+		return false;
+	}
+
+	const Kernels scalarKernels = { hasPointScalar, countCrossingsScalar, intersectsScalar };
+
+	#if EDGE_ARRAYS_X86
+
+	//
+	// SSE2, two edges at a time
+	//
+
+	__attribute__((target("sse2")))
+	bool hasPointSSE2(const double* ax, const double* ay, const double* bx, const double* by, size_t n,
+			double px, double py) {
+		const __m128d x = _mm_set1_pd(px), y = _mm_set1_pd(py), zero = _mm_setzero_pd();
+		// Points on the boundary are rare, so don't bother stopping early
+		__m128d hits = zero;
+		size_t i = 0;
+		for( ; i + 2 <= n; i += 2) {
+			__m128d a_x = _mm_loadu_pd(ax + i), a_y = _mm_loadu_pd(ay + i);
+			__m128d ex = _mm_sub_pd(_mm_loadu_pd(bx + i), a_x), ey = _mm_sub_pd(_mm_loadu_pd(by + i), a_y);
+			__m128d qx = _mm_sub_pd(x, a_x), qy = _mm_sub_pd(y, a_y);
+			__m128d c = _mm_sub_pd(_mm_mul_pd(ex, qy), _mm_mul_pd(ey, qx));
+			__m128d dot = _mm_add_pd(_mm_mul_pd(ex, qx), _mm_mul_pd(ey, qy));
+			__m128d len2 = _mm_add_pd(_mm_mul_pd(ex, ex), _mm_mul_pd(ey, ey));
+			hits = _mm_or_pd(hits, _mm_and_pd(_mm_cmpeq_pd(c, zero),
+				_mm_and_pd(_mm_cmpge_pd(dot, zero), _mm_cmple_pd(dot, len2))));
+		}
+		if(_mm_movemask_pd(hits)) { return true; }
+		return hasPointScalar(ax + i, ay + i, bx + i, by + i, n - i, px, py);
+	}
+
+	__attribute__((target("sse2")))
+	void countCrossingsSSE2(const double* ax, const double* ay, const double* bx, const double* by, size_t n,
+			double px, double py, size_t& right, size_t& left) {
+		const __m128d x = _mm_set1_pd(px), y = _mm_set1_pd(py), zero = _mm_setzero_pd();
+		// Masks are -1 per lane, so subtracting them counts
+		__m128i rights = _mm_setzero_si128(), lefts = _mm_setzero_si128();
+		size_t i = 0;
+		for( ; i + 2 <= n; i += 2) {
+			__m128d a_x = _mm_loadu_pd(ax + i), a_y = _mm_loadu_pd(ay + i);
+			__m128d b_x = _mm_loadu_pd(bx + i), b_y = _mm_loadu_pd(by + i);
+			__m128d spans = _mm_xor_pd(_mm_cmplt_pd(a_y, y), _mm_cmplt_pd(b_y, y));
+			__m128d dy = _mm_sub_pd(b_y, a_y);
+			__m128d w = _mm_add_pd(_mm_mul_pd(_mm_sub_pd(a_x, x), dy), _mm_mul_pd(_mm_sub_pd(b_x, a_x), _mm_sub_pd(y, a_y)));
+			__m128d pos = _mm_cmpgt_pd(w, zero), neg = _mm_cmplt_pd(w, zero), up = _mm_cmpgt_pd(dy, zero);
+			__m128d r = _mm_and_pd(spans, _mm_or_pd(_mm_and_pd(pos, up), _mm_andnot_pd(up, neg)));
+			__m128d l = _mm_and_pd(spans, _mm_or_pd(_mm_and_pd(neg, up), _mm_andnot_pd(up, pos)));
+			rights = _mm_sub_epi64(rights, _mm_castpd_si128(r));
+			lefts = _mm_sub_epi64(lefts, _mm_castpd_si128(l));
+		}
+		int64_t counts[4];
+		_mm_storeu_si128((__m128i*)counts, rights);
+		_mm_storeu_si128((__m128i*)(counts + 2), lefts);
+		right += counts[0] + counts[1];
+		left += counts[2] + counts[3];
+		countCrossingsScalar(ax + i, ay + i, bx + i, by + i, n - i, px, py, right, left);
+	}
+
+	__attribute__((target("sse2")))
+	bool intersectsSSE2(const double* ax, const double* ay, const double* bx, const double* by, size_t n,
+			double lax, double lay, double lbx, double lby, int flags) {
+		const __m128d zero = _mm_setzero_pd(), all = _mm_cmpeq_pd(zero, zero);
+		const __m128d x1 = _mm_set1_pd(lax), y1 = _mm_set1_pd(lay), x2 = _mm_set1_pd(lbx), y2 = _mm_set1_pd(lby);
+		const __m128d lx = _mm_sub_pd(x2, x1), ly = _mm_sub_pd(y2, y1);
+		const __m128d otherBoundary = (flags & Line::OTHER_BOUNDARY) ? all : zero,
+			otherInner = (flags & Line::OTHER_INNER) ? all : zero,
+			thisBoundary = (flags & Line::THIS_BOUNDARY) ? all : zero,
+			thisInner = (flags & Line::THIS_INNER) ? all : zero;
+		size_t i = 0;
+		for( ; i + 2 <= n; i += 2) {
+			__m128d ex1 = _mm_loadu_pd(ax + i), ey1 = _mm_loadu_pd(ay + i);
+			__m128d ex2 = _mm_loadu_pd(bx + i), ey2 = _mm_loadu_pd(by + i);
+			__m128d ex = _mm_sub_pd(ex2, ex1), ey = _mm_sub_pd(ey2, ey1);
+
+			__m128d c1 = _mm_sub_pd(_mm_mul_pd(lx, _mm_sub_pd(ey1, y1)), _mm_mul_pd(ly, _mm_sub_pd(ex1, x1)));
+			__m128d c2 = _mm_sub_pd(_mm_mul_pd(lx, _mm_sub_pd(ey2, y1)), _mm_mul_pd(ly, _mm_sub_pd(ex2, x1)));
+			__m128d c3 = _mm_sub_pd(_mm_mul_pd(ex, _mm_sub_pd(y1, ey1)), _mm_mul_pd(ey, _mm_sub_pd(x1, ex1)));
+			__m128d c4 = _mm_sub_pd(_mm_mul_pd(ex, _mm_sub_pd(y2, ey1)), _mm_mul_pd(ey, _mm_sub_pd(x2, ex1)));
+
+			__m128d touch12 = _mm_xor_pd(_mm_cmpeq_pd(c1, zero), _mm_cmpeq_pd(c2, zero));
+			__m128d cross12 = _mm_or_pd(_mm_and_pd(_mm_cmplt_pd(c1, zero), _mm_cmpgt_pd(c2, zero)),
+				_mm_and_pd(_mm_cmpgt_pd(c1, zero), _mm_cmplt_pd(c2, zero)));
+			__m128d touch34 = _mm_xor_pd(_mm_cmpeq_pd(c3, zero), _mm_cmpeq_pd(c4, zero));
+			__m128d cross34 = _mm_or_pd(_mm_and_pd(_mm_cmplt_pd(c3, zero), _mm_cmpgt_pd(c4, zero)),
+				_mm_and_pd(_mm_cmpgt_pd(c3, zero), _mm_cmplt_pd(c4, zero)));
+
+			__m128d ok12 = _mm_or_pd(_mm_and_pd(touch12, otherBoundary), _mm_and_pd(cross12, otherInner));
+			__m128d ok34 = _mm_or_pd(_mm_and_pd(touch34, thisBoundary), _mm_and_pd(cross34, thisInner));
+			if(_mm_movemask_pd(_mm_and_pd(ok12, ok34))) { return true; }
+		}
+		return intersectsScalar(ax + i, ay + i, bx + i, by + i, n - i, lax, lay, lbx, lby, flags);
+	}
+
+	const Kernels sse2Kernels = { hasPointSSE2, countCrossingsSSE2, intersectsSSE2 };
+
+	//
+	// AVX2, four edges at a time
+	//
+
+	__attribute__((target("avx2")))
+	bool hasPointAVX2(const double* ax, const double* ay, const double* bx, const double* by, size_t n,
+			double px, double py) {
+		const __m256d x = _mm256_set1_pd(px), y = _mm256_set1_pd(py), zero = _mm256_setzero_pd();
+		__m256d hits = zero;
+		size_t i = 0;
+		for( ; i + 4 <= n; i += 4) {
+			__m256d a_x = _mm256_loadu_pd(ax + i), a_y = _mm256_loadu_pd(ay + i);
+			__m256d ex = _mm256_sub_pd(_mm256_loadu_pd(bx + i), a_x), ey = _mm256_sub_pd(_mm256_loadu_pd(by + i), a_y);
+			__m256d qx = _mm256_sub_pd(x, a_x), qy = _mm256_sub_pd(y, a_y);
+			__m256d c = _mm256_sub_pd(_mm256_mul_pd(ex, qy), _mm256_mul_pd(ey, qx));
+			__m256d dot = _mm256_add_pd(_mm256_mul_pd(ex, qx), _mm256_mul_pd(ey, qy));
+			__m256d len2 = _mm256_add_pd(_mm256_mul_pd(ex, ex), _mm256_mul_pd(ey, ey));
+			hits = _mm256_or_pd(hits, _mm256_and_pd(_mm256_cmp_pd(c, zero, _CMP_EQ_OQ),
+				_mm256_and_pd(_mm256_cmp_pd(dot, zero, _CMP_GE_OQ), _mm256_cmp_pd(dot, len2, _CMP_LE_OQ))));
+		}
+		if(_mm256_movemask_pd(hits)) { return true; }
+		// The compiler might jump to the scalar code without clearing
+		// the upper halves, which makes the SSE instructions there slow
+		_mm256_zeroupper();
+		return hasPointScalar(ax + i, ay + i, bx + i, by + i, n - i, px, py);
+	}
+
+	__attribute__((target("avx2")))
+	void countCrossingsAVX2(const double* ax, const double* ay, const double* bx, const double* by, size_t n,
+			double px, double py, size_t& right, size_t& left) {
+		const __m256d x = _mm256_set1_pd(px), y = _mm256_set1_pd(py), zero = _mm256_setzero_pd();
+		__m256i rights = _mm256_setzero_si256(), lefts = _mm256_setzero_si256();
+		size_t i = 0;
+		for( ; i + 4 <= n; i += 4) {
+			__m256d a_x = _mm256_loadu_pd(ax + i), a_y = _mm256_loadu_pd(ay + i);
+			__m256d b_x = _mm256_loadu_pd(bx + i), b_y = _mm256_loadu_pd(by + i);
+			__m256d spans = _mm256_xor_pd(_mm256_cmp_pd(a_y, y, _CMP_LT_OQ), _mm256_cmp_pd(b_y, y, _CMP_LT_OQ));
+			__m256d dy = _mm256_sub_pd(b_y, a_y);
+			__m256d w = _mm256_add_pd(_mm256_mul_pd(_mm256_sub_pd(a_x, x), dy),
+				_mm256_mul_pd(_mm256_sub_pd(b_x, a_x), _mm256_sub_pd(y, a_y)));
+			__m256d pos = _mm256_cmp_pd(w, zero, _CMP_GT_OQ), neg = _mm256_cmp_pd(w, zero, _CMP_LT_OQ),
+				up = _mm256_cmp_pd(dy, zero, _CMP_GT_OQ);
+			__m256d r = _mm256_and_pd(spans, _mm256_or_pd(_mm256_and_pd(pos, up), _mm256_andnot_pd(up, neg)));
+			__m256d l = _mm256_and_pd(spans, _mm256_or_pd(_mm256_and_pd(neg, up), _mm256_andnot_pd(up, pos)));
+			rights = _mm256_sub_epi64(rights, _mm256_castpd_si256(r));
+			lefts = _mm256_sub_epi64(lefts, _mm256_castpd_si256(l));
+		}
+		int64_t counts[8];
+		_mm256_storeu_si256((__m256i*)counts, rights);
+		_mm256_storeu_si256((__m256i*)(counts + 4), lefts);
+		right += counts[0] + counts[1] + counts[2] + counts[3];
+		left += counts[4] + counts[5] + counts[6] + counts[7];
+		_mm256_zeroupper();
+		countCrossingsScalar(ax + i, ay + i, bx + i, by + i, n - i, px, py, right, left);
+	}
+
+	__attribute__((target("avx2")))
+	bool intersectsAVX2(const double* ax, const double* ay, const double* bx, const double* by, size_t n,
+			double lax, double lay, double lbx, double lby, int flags) {
+		const __m256d zero = _mm256_setzero_pd(), all = _mm256_cmp_pd(zero, zero, _CMP_EQ_OQ);
+		const __m256d x1 = _mm256_set1_pd(lax), y1 = _mm256_set1_pd(lay), x2 = _mm256_set1_pd(lbx), y2 = _mm256_set1_pd(lby);
+		const __m256d lx = _mm256_sub_pd(x2, x1), ly = _mm256_sub_pd(y2, y1);
+		const __m256d otherBoundary = (flags & Line::OTHER_BOUNDARY) ? all : zero,
+			otherInner = (flags & Line::OTHER_INNER) ? all : zero,
+			thisBoundary = (flags & Line::THIS_BOUNDARY) ? all : zero,
+			thisInner = (flags & Line::THIS_INNER) ? all : zero;
+		size_t i = 0;
+		for( ; i + 4 <= n; i += 4) {
+			__m256d ex1 = _mm256_loadu_pd(ax + i), ey1 = _mm256_loadu_pd(ay + i);
+			__m256d ex2 = _mm256_loadu_pd(bx + i), ey2 = _mm256_loadu_pd(by + i);
+			__m256d ex = _mm256_sub_pd(ex2, ex1), ey = _mm256_sub_pd(ey2, ey1);
+
+			__m256d c1 = _mm256_sub_pd(_mm256_mul_pd(lx, _mm256_sub_pd(ey1, y1)), _mm256_mul_pd(ly, _mm256_sub_pd(ex1, x1)));
+			__m256d c2 = _mm256_sub_pd(_mm256_mul_pd(lx, _mm256_sub_pd(ey2, y1)), _mm256_mul_pd(ly, _mm256_sub_pd(ex2, x1)));
+			__m256d c3 = _mm256_sub_pd(_mm256_mul_pd(ex, _mm256_sub_pd(y1, ey1)), _mm256_mul_pd(ey, _mm256_sub_pd(x1, ex1)));
+			__m256d c4 = _mm256_sub_pd(_mm256_mul_pd(ex, _mm256_sub_pd(y2, ey1)), _mm256_mul_pd(ey, _mm256_sub_pd(x2, ex1)));
+
+			__m256d touch12 = _mm256_xor_pd(_mm256_cmp_pd(c1, zero, _CMP_EQ_OQ), _mm256_cmp_pd(c2, zero, _CMP_EQ_OQ));
+			__m256d cross12 = _mm256_or_pd(
+				_mm256_and_pd(_mm256_cmp_pd(c1, zero, _CMP_LT_OQ), _mm256_cmp_pd(c2, zero, _CMP_GT_OQ)),
+				_mm256_and_pd(_mm256_cmp_pd(c1, zero, _CMP_GT_OQ), _mm256_cmp_pd(c2, zero, _CMP_LT_OQ)));
+			__m256d touch34 = _mm256_xor_pd(_mm256_cmp_pd(c3, zero, _CMP_EQ_OQ), _mm256_cmp_pd(c4, zero, _CMP_EQ_OQ));
+			__m256d cross34 = _mm256_or_pd(
+				_mm256_and_pd(_mm256_cmp_pd(c3, zero, _CMP_LT_OQ), _mm256_cmp_pd(c4, zero, _CMP_GT_OQ)),
+				_mm256_and_pd(_mm256_cmp_pd(c3, zero, _CMP_GT_OQ), _mm256_cmp_pd(c4, zero, _CMP_LT_OQ)));
+
+			__m256d ok12 = _mm256_or_pd(_mm256_and_pd(touch12, otherBoundary), _mm256_and_pd(cross12, otherInner));
+			__m256d ok34 = _mm256_or_pd(_mm256_and_pd(touch34, thisBoundary), _mm256_and_pd(cross34, thisInner));
+			if(_mm256_movemask_pd(_mm256_and_pd(ok12, ok34))) { return true; }
+		}
+		_mm256_zeroupper();
+		return intersectsScalar(ax + i, ay + i, bx + i, by + i, n - i, lax, lay, lbx, lby, flags);
+	}
+
+	const Kernels avx2Kernels = { hasPointAVX2, countCrossingsAVX2, intersectsAVX2 };
+
+	#endif // EDGE_ARRAYS_X86
+
+	bool supported(EdgeArrays::Kernel kernel) {
+		#if EDGE_ARRAYS_X86
+		__builtin_cpu_init();
+		switch(kernel) {
+			case EdgeArrays::KERNEL_SCALAR: return true;
+			case EdgeArrays::KERNEL_SSE2: return __builtin_cpu_supports("sse2");
+			case EdgeArrays::KERNEL_AVX2: return __builtin_cpu_supports("avx2");
+		}
+		return false;
+		#else
+		return kernel == EdgeArrays::KERNEL_SCALAR;
+		#endif
+	}
+
+	const Kernels& kernels(EdgeArrays::Kernel kernel) {
+		#if EDGE_ARRAYS_X86
+		if(kernel == EdgeArrays::KERNEL_AVX2) { return avx2Kernels; }
+		if(kernel == EdgeArrays::KERNEL_SSE2) { return sse2Kernels; }
+		#endif
+		return scalarKernels;
+	}
+
+	EdgeArrays::Kernel bestKernel() {
+		if(supported(EdgeArrays::KERNEL_AVX2)) { return EdgeArrays::KERNEL_AVX2; }
+		if(supported(EdgeArrays::KERNEL_SSE2)) { return EdgeArrays::KERNEL_SSE2; }
+		return EdgeArrays::KERNEL_SCALAR;
+	}
+
+	/// Set by setKernel(), 0 means the best one is used
+	const Kernels* chosen = 0;
+	EdgeArrays::Kernel chosenKernel = EdgeArrays::KERNEL_SCALAR;
+
+	/*
+	 * The best kernel is looked up on first use rather than during
+	 * static initialization, so queries from static initializers in other
+	 * translation units work as well.
+	 */
+	EdgeArrays::Kernel defaultKernel() {
+		static const EdgeArrays::Kernel best = bestKernel();
+		return best;
+	}
+
+	const Kernels& activeKernels() {
+		static const Kernels* const best = &kernels(defaultKernel());
+		return chosen ? *chosen : *best;
+	}
+} // namespace
+
+EdgeArrays::Kernel EdgeArrays::getKernel() {
+	return chosen ? chosenKernel : defaultKernel();
+}
+
+bool EdgeArrays::setKernel(Kernel kernel) {
+	if(!supported(kernel)) { return false; }
+	chosenKernel = kernel;
+	chosen = &kernels(kernel);
+	return true;
+}
+
+void EdgeArrays::grow(VirtualPosition p) {
+	maxCoordinate = std::max(maxCoordinate, std::max(std::abs(p.getX()), std::abs(p.getY())));
+}
+
+bool EdgeArrays::exact(VirtualPosition p) const {
+	return maxCoordinate <= EXACT_RANGE && std::abs(p.getX()) <= EXACT_RANGE && std::abs(p.getY()) <= EXACT_RANGE;
+}
+
+void EdgeArrays::clear() {
+	ax.clear(); ay.clear(); bx.clear(); by.clear();
+	maxCoordinate = 0;
+}
+
+void EdgeArrays::push_back(const Line& l) {
+	ax.push_back(l.getA().getX());
+	ay.push_back(l.getA().getY());
+	bx.push_back(l.getB().getX());
+	by.push_back(l.getB().getY());
+	grow(l.getA());
+	grow(l.getB());
+}
+
+void EdgeArrays::setB(size_t i, VirtualPosition b) {
+	bx[i] = b.getX();
+	by[i] = b.getY();
+	grow(b);
+}
+
+bool EdgeArrays::hasPoint(VirtualPosition p, size_t begin, size_t end) const {
+	if(begin >= end) { return false; }
+	const Kernels& k = exact(p) ? activeKernels() : scalarKernels;
+	return k.hasPoint(&ax[begin], &ay[begin], &bx[begin], &by[begin], end - begin, p.getX(), p.getY());
+}
+
+void EdgeArrays::countCrossings(VirtualPosition p, size_t& right, size_t& left) const {
+	right = left = 0;
+	if(ax.empty()) { return; }
+	const Kernels& k = exact(p) ? activeKernels() : scalarKernels;
+	k.countCrossings(&ax[0], &ay[0], &bx[0], &by[0], size(), p.getX(), p.getY(), right, left);
+}
+
+bool EdgeArrays::intersects(const Line& l, int flags, size_t begin, size_t end) const {
+	if(begin >= end) { return false; }
+	const Kernels& k = (exact(l.getA()) && exact(l.getB())) ? activeKernels() : scalarKernels;
+	return k.intersects(&ax[begin], &ay[begin], &bx[begin], &by[begin], end - begin,
+			l.getA().getX(), l.getA().getY(), l.getB().getX(), l.getB().getY(), flags);
+}
+
+} // namespace grail
+
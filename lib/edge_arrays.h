@@ -0,0 +1,91 @@
+// vim: set noexpandtab:
+
+#ifndef EDGE_ARRAYS_H
+#define EDGE_ARRAYS_H
+
+#include <vector>
+#include <stdint.h>
+
+#include "vector2d.h"
+#include "line.h"
+
+namespace grail {
+
+/**
+ * Line segments stored as structure of arrays (one array per coordinate)
+ * with tests of a point or a segment against all of them (or a range of
+ * them) at once.
+ *
+ * The tests run on SSE2 or AVX2 if the CPU has it (chosen once at startup)
+ * and in plain C++ otherwise. All of them are exact: The vector versions
+ * compute in double precision, which holds all products of coordinate
+ * differences exactly as long as the coordinates stay within
+ * +-EXACT_RANGE. Anything farther out is handed to the scalar version,
+ * which uses 64 bit integers (and is exact up to +-2^30).
+ */
+class EdgeArrays {
+	public:
+		enum Kernel { KERNEL_SCALAR, KERNEL_SSE2, KERNEL_AVX2 };
+
+		static const int32_t EXACT_RANGE = 1 << 24;
+
+		/// The kernel used by all queries
+		static Kernel getKernel();
+
+		/**
+		 * Switch all queries to $kernel (for tests and benchmarks), not
+		 * safe while queries are running.
+		 * @return false (and change nothing) iff the CPU doesn't support it
+		 */
+		static bool setKernel(Kernel kernel);
+
+	private:
+		std::vector<double> ax, ay, bx, by;
+		int32_t maxCoordinate;
+
+		void grow(VirtualPosition p);
+		bool exact(VirtualPosition p) const;
+
+	public:
+		EdgeArrays() : maxCoordinate(0) { }
+
+		void clear();
+		void push_back(const Line& l);
+
+		/// Move the end point of edge $i
+		void setB(size_t i, VirtualPosition b);
+
+		size_t size() const { return ax.size(); }
+		Line operator[](size_t i) const {
+			return Line(VirtualPosition((int32_t)ax[i], (int32_t)ay[i]), VirtualPosition((int32_t)bx[i], (int32_t)by[i]));
+		}
+
+		/**
+		 * True iff $p lies on any of the edges $begin ... $end - 1
+		 * (end points included).
+		 */
+		bool hasPoint(VirtualPosition p, size_t begin, size_t end) const;
+		bool hasPoint(VirtualPosition p) const { return hasPoint(p, 0, size()); }
+
+		/**
+		 * Count the edges crossed by the horizontal rays from $p to the
+		 * right and to the left. An edge counts if it spans $p's y
+		 * coordinate, including its lower end point (the one with the
+		 * larger y) but not its upper one, so horizontal edges never
+		 * count and neither do edges passing through $p itself.
+		 */
+		void countCrossings(VirtualPosition p, size_t& right, size_t& left) const;
+
+		/**
+		 * True iff $l intersects any of the edges $begin ... $end - 1
+		 * according to $flags (exactly like Line::intersects() with the
+		 * edges as the other line).
+		 */
+		bool intersects(const Line& l, int flags, size_t begin, size_t end) const;
+		bool intersects(const Line& l, int flags = Line::REAL_INTERSECT) const { return intersects(l, flags, 0, size()); }
+};
+
+} // namespace grail
+
+#endif // EDGE_ARRAYS_H
+
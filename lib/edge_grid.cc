@@ -0,0 +1,252 @@
+// vim: set noexpandtab:
+
+#include <cmath>
+#include <algorithm>
+using std::min;
+using std::max;
+
+#include "edge_grid.h"
+
+namespace grail {
+
+struct EdgeGrid::CountVisitor {
+	std::vector<Index>& counts;
+	CountVisitor(std::vector<Index>& counts) : counts(counts) { }
+	bool operator()(Index cell) { counts[cell + 1]++; return false; }
+};
+
+struct EdgeGrid::FillVisitor {
+	std::vector<Index>& fill;
+	std::vector<Index>& cellEdges;
+	Index edge;
+	FillVisitor(std::vector<Index>& fill, std::vector<Index>& cellEdges, Index edge) :
+		fill(fill), cellEdges(cellEdges), edge(edge) { }
+	bool operator()(Index cell) { cellEdges[fill[cell]++] = edge; return false; }
+};
+
+struct EdgeGrid::IntersectVisitor {
+	const EdgeGrid& grid;
+	const Line& line;
+	int flags;
+	IntersectVisitor(const EdgeGrid& grid, const Line& line, int flags) : grid(grid), line(line), flags(flags) { }
+	bool operator()(Index cell) {
+		// An edge spanning several cells might be tested more than once,
+		// that's cheaper than remembering which ones we already saw.
+		return grid.cellLines.intersects(line, flags, grid.cellOffsets[cell], grid.cellOffsets[cell + 1]);
+	}
+};
+
+namespace {
+	/**
+	 * Squared distance between ($px, $py) and the closest point ($x, $y)
+	 * on $l.
+	 */
+	double closestPoint(const Line& l, double px, double py, double& x, double& y) {
+		double ax = l.getA().getX(), ay = l.getA().getY();
+		double dx = l.getB().getX() - ax, dy = l.getB().getY() - ay;
+		double len2 = dx * dx + dy * dy;
+		double t = (len2 > 0.0) ? ((px - ax) * dx + (py - ay) * dy) / len2 : 0.0;
+		t = max(0.0, min(1.0, t));
+		x = ax + t * dx;
+		y = ay + t * dy;
+		return (px - x) * (px - x) + (py - y) * (py - y);
+	}
+}
+
+struct EdgeGrid::CrossingVisitor {
+	const EdgeGrid& grid;
+	VirtualPosition a, b;
+	bool found;
+	/// position on $a - $b of the best crossing so far, 0 = $a, 1 = $b
+	double best, x, y;
+	CrossingVisitor(const EdgeGrid& grid, VirtualPosition a, VirtualPosition b) :
+		grid(grid), a(a), b(b), found(false), best(0.0), x(0.0), y(0.0) { }
+	bool operator()(Index cell) {
+		double dx = b.getX() - a.getX(), dy = b.getY() - a.getY();
+		for(Index i = grid.cellOffsets[cell]; i != grid.cellOffsets[cell + 1]; ++i) {
+			const Line& e = grid.edges[grid.cellEdges[i]];
+			double ex = e.getB().getX() - e.getA().getX(), ey = e.getB().getY() - e.getA().getY();
+			double denominator = dx * ey - dy * ex;
+			if(denominator == 0.0) { continue; }
+
+			double fx = e.getA().getX() - a.getX(), fy = e.getA().getY() - a.getY();
+			double t = (fx * ey - fy * ex) / denominator;
+			double u = (fx * dy - fy * dx) / denominator;
+			if(t < 0.0 || t > 1.0 || u < 0.0 || u > 1.0) { continue; }
+			if(!found || t > best) {
+				found = true;
+				best = t;
+				x = a.getX() + t * dx;
+				y = a.getY() + t * dy;
+			}
+		}
+		return false;
+	}
+};
+
+struct EdgeGrid::CandidateVisitor {
+	const EdgeGrid& grid;
+	size_t count;
+	CandidateVisitor(const EdgeGrid& grid) : grid(grid), count(0) { }
+	bool operator()(Index cell) {
+		count += grid.cellOffsets[cell + 1] - grid.cellOffsets[cell];
+		return false;
+	}
+};
+
+template<typename Visitor>
+bool EdgeGrid::visitCells(VirtualPosition a, VirtualPosition b, Visitor& visitor) const {
+	// Work in cell units. Points on cell borders count as part of both
+	// cells, thus the epsilons
+	const double eps = 1e-6;
+	double ax = (a.getX() - origin.getX()) / cellSize, ay = (a.getY() - origin.getY()) / cellSize;
+	double bx = (b.getX() - origin.getX()) / cellSize, by = (b.getY() - origin.getY()) / cellSize;
+	double ymin = min(ay, by), ymax = max(ay, by);
+
+	int32_t r0 = max<int32_t>(0, (int32_t)floor(ymin - eps));
+	int32_t r1 = min<int32_t>(rows - 1, (int32_t)floor(ymax + eps));
+
+	for(int32_t r = r0; r <= r1; ++r) {
+		// part of the segment inside this row
+		double lo = max(ymin, (double)r), hi = min(ymax, (double)r + 1.0);
+		if(lo > hi + eps) { continue; }
+
+		double xlo, xhi;
+		if(ay == by) {
+			xlo = min(ax, bx);
+			xhi = max(ax, bx);
+		}
+		else {
+			double x1 = ax + (bx - ax) * (lo - ay) / (by - ay);
+			double x2 = ax + (bx - ax) * (hi - ay) / (by - ay);
+			xlo = min(x1, x2);
+			xhi = max(x1, x2);
+		}
+
+		int32_t c0 = max<int32_t>(0, (int32_t)floor(xlo - eps));
+		int32_t c1 = min<int32_t>(columns - 1, (int32_t)floor(xhi + eps));
+		for(int32_t c = c0; c <= c1; ++c) {
+			if(visitor(r * columns + c)) { return true; }
+		}
+	}
+	return false;
+}
+
+void EdgeGrid::clear() {
+	edges.clear();
+	cellOffsets.clear();
+	cellEdges.clear();
+	cellLines.clear();
+	columns = rows = 0;
+}
+
+void EdgeGrid::build() {
+	cellOffsets.clear();
+	cellEdges.clear();
+	cellLines.clear();
+	columns = rows = 0;
+	if(edges.empty()) { return; }
+
+	VirtualPosition lo = edges[0].getA(), hi = lo;
+	for(std::vector<Line>::const_iterator iter = edges.begin(); iter != edges.end(); ++iter) {
+		VirtualPosition ps[] = { iter->getA(), iter->getB() };
+		for(int i = 0; i < 2; ++i) {
+			lo = VirtualPosition(min(lo.getX(), ps[i].getX()), min(lo.getY(), ps[i].getY()));
+			hi = VirtualPosition(max(hi.getX(), ps[i].getX()), max(hi.getY(), ps[i].getY()));
+		}
+	}
+
+	// Aim for about one edge per cell
+	double w = hi.getX() - lo.getX() + 1.0, h = hi.getY() - lo.getY() + 1.0;
+	origin = lo;
+	cellSize = max(1.0, sqrt(w * h / edges.size()));
+	columns = (int32_t)(w / cellSize) + 1;
+	rows = (int32_t)(h / cellSize) + 1;
+
+	std::vector<Index> counts(columns * rows + 1, 0);
+	CountVisitor cv(counts);
+	for(Index i = 0; i < edges.size(); ++i) {
+		visitCells(edges[i].getA(), edges[i].getB(), cv);
+	}
+	for(size_t i = 1; i < counts.size(); ++i) {
+		counts[i] += counts[i - 1];
+	}
+	cellOffsets = counts;
+	cellEdges.resize(counts.back());
+
+	std::vector<Index> fill(counts.begin(), counts.end() - 1);
+	for(Index i = 0; i < edges.size(); ++i) {
+		FillVisitor fv(fill, cellEdges, i);
+		visitCells(edges[i].getA(), edges[i].getB(), fv);
+	}
+
+	for(std::vector<Index>::const_iterator iter = cellEdges.begin(); iter != cellEdges.end(); ++iter) {
+		cellLines.push_back(edges[*iter]);
+	}
+}
+
+bool EdgeGrid::intersects(const Line& l, int flags) const {
+	if(cellOffsets.empty()) { return false; }
+	IntersectVisitor v(*this, l, flags);
+	return visitCells(l.getA(), l.getB(), v);
+}
+
+size_t EdgeGrid::countCandidates(const Line& l) const {
+	if(cellOffsets.empty()) { return 0; }
+	CandidateVisitor v(*this);
+	visitCells(l.getA(), l.getB(), v);
+	return v.count;
+}
+
+bool EdgeGrid::nearestPoint(VirtualPosition p, double& x, double& y) const {
+	if(cellOffsets.empty()) { return false; }
+
+	double px = p.getX(), py = p.getY();
+	int32_t c0 = (int32_t)floor((px - origin.getX()) / cellSize);
+	int32_t r0 = (int32_t)floor((py - origin.getY()) / cellSize);
+	c0 = max<int32_t>(0, min<int32_t>(columns - 1, c0));
+	r0 = max<int32_t>(0, min<int32_t>(rows - 1, r0));
+	int32_t rings = max(max(c0, columns - 1 - c0), max(r0, rows - 1 - r0));
+
+	bool found = false;
+	double best = 0.0;
+	for(int32_t ring = 0; ring <= rings; ++ring) {
+		// Cells of this ring are at least ring - 1 cells away from $p (also
+		// when $p is outside of the grid, as its cell is the clamped one)
+		if(found && (ring - 1) * cellSize > sqrt(best)) { break; }
+
+		for(int32_t r = max<int32_t>(0, r0 - ring); r <= min<int32_t>(rows - 1, r0 + ring); ++r) {
+			// Only the first and last row of the ring are complete
+			int32_t step = (r == r0 - ring || r == r0 + ring) ? 1 : 2 * ring;
+			for(int32_t c = c0 - ring; c <= c0 + ring; c += step) {
+				if(c < 0 || c >= columns) { continue; }
+
+				Index cell = r * columns + c;
+				for(Index i = cellOffsets[cell]; i != cellOffsets[cell + 1]; ++i) {
+					double ex, ey;
+					double d = closestPoint(edges[cellEdges[i]], px, py, ex, ey);
+					if(!found || d < best) {
+						found = true;
+						best = d;
+						x = ex;
+						y = ey;
+					}
+				}
+			}
+		}
+	}
+	return found;
+}
+
+bool EdgeGrid::lastCrossing(VirtualPosition a, VirtualPosition b, double& x, double& y) const {
+	if(cellOffsets.empty()) { return false; }
+	CrossingVisitor v(*this, a, b);
+	visitCells(a, b, v);
+	if(v.found) {
+		x = v.x;
+		y = v.y;
+	}
+	return v.found;
+}
+
+} // namespace grail
@@ -0,0 +1,102 @@
+// vim: set noexpandtab:
+
+#ifndef EDGE_GRID_H
+#define EDGE_GRID_H
+
+#include <vector>
+#include <stdint.h>
+
+#include "vector2d.h"
+#include "line.h"
+#include "edge_arrays.h"
+
+namespace grail {
+
+/**
+ * Uniform grid over a set of static line segments (e.g. the edges of the
+ * polygons bounding a ground component).
+ *
+ * Segment queries only look at the edges stored in the grid cells the
+ * query segment passes through instead of at all edges.
+ *
+ * Usage: addEdge() all edges, then build(), then query.
+ */
+class EdgeGrid {
+	public:
+		typedef uint32_t Index;
+
+	private:
+		std::vector<Line> edges;
+		std::vector<Index> cellOffsets;
+		std::vector<Index> cellEdges;
+		/// Copies of the edges in the order of $cellEdges
+		EdgeArrays cellLines;
+
+		VirtualPosition origin;
+		double cellSize;
+		int32_t columns, rows;
+
+		/**
+		 * Calls visitor(cell) for all cells whose closed area touches the
+		 * segment $a - $b (plus a few neighbours at cell borders).
+		 * Stops and returns true as soon as a visitor returns true.
+		 */
+		template<typename Visitor>
+		bool visitCells(VirtualPosition a, VirtualPosition b, Visitor& visitor) const;
+
+		struct CountVisitor;
+		struct FillVisitor;
+		struct IntersectVisitor;
+		struct CrossingVisitor;
+		struct CandidateVisitor;
+
+	public:
+		EdgeGrid() : cellSize(1.0), columns(0), rows(0) { }
+
+		void clear();
+		void addEdge(const Line& l) { edges.push_back(l); }
+
+		/**
+		 * Distribute the edges added so far into grid cells.
+		 */
+		void build();
+
+		size_t edgeCount() const { return edges.size(); }
+		const Line& getEdge(Index i) const { return edges[i]; }
+
+		/**
+		 * True iff any stored edge intersects $l according to $flags
+		 * (see Line::intersects).
+		 */
+		bool intersects(const Line& l, int flags = Line::REAL_INTERSECT) const;
+
+		/**
+		 * Number of edge tests intersects() makes for $l at most (it
+		 * stops at the first hit), for statistics.
+		 */
+		size_t countCandidates(const Line& l) const;
+
+		/**
+		 * Find the point on any stored edge that is closest to $p.
+		 * Only looks at the cells around $p, growing the search area until
+		 * no unvisited cell can hold anything closer.
+		 *
+		 * @param x, y exact (not rounded) coordinates of the point
+		 * @return false iff there are no edges
+		 */
+		bool nearestPoint(VirtualPosition p, double& x, double& y) const;
+
+		/**
+		 * Find the point where the segment $a - $b touches or crosses a
+		 * stored edge that is closest to $b.
+		 *
+		 * @param x, y exact (not rounded) coordinates of the point
+		 * @return false iff the segment touches no edge at all
+		 */
+		bool lastCrossing(VirtualPosition a, VirtualPosition b, double& x, double& y) const;
+};
+
+} // namespace grail
+
+#endif // EDGE_GRID_H
+
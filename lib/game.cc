@@ -113,14 +113,7 @@ void Game::eachFrame(uint32_t ticks) {
 
 void Game::renderEverything(uint32_t ticks) {
 	if(viewport) {
-		viewport->startRendering();
-		if(currentScene) {
-			viewport->renderScene(currentScene, ticks);
-		}
-		if(userInterface) {
-			viewport->renderUserInterface(userInterface, ticks);
-		}
-		viewport->finishRendering();
+		viewport->render(currentScene, userInterface, ticks);
 	}
 }
 
@@ -0,0 +1,450 @@
+// vim: set noexpandtab:
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+
+#include "grid_map.h"
+#include "surface.h"
+#include "debug.h"
+
+namespace grail {
+
+const GridSearch::Index GridSearch::NO_INDEX = 0xffffffff;
+
+namespace {
+	/// Index of the lowest set bit, $x must not be 0
+	int lowestBit(uint32_t x) {
+		#ifdef __GNUC__
+			return __builtin_ctz(x);
+		#else
+			int i = 0;
+			for( ; !(x & 1); x >>= 1) { i++; }
+			return i;
+		#endif
+	}
+
+	/// Index of the highest set bit, $x must not be 0
+	int highestBit(uint32_t x) {
+		#ifdef __GNUC__
+			return 31 - __builtin_clz(x);
+		#else
+			int i = 31;
+			for( ; !(x & 0x80000000u); x <<= 1) { i--; }
+			return i;
+		#endif
+	}
+}
+
+GridMap::GridMap(VirtualPosition origin, VirtualSize size, int32_t columns, int32_t rows) :
+	origin(origin), size(size), columns(columns), rows(rows), wordsPerRow((columns + 31) / 32),
+	bits(wordsPerRow * rows, 0), distances(columns * rows, 0xffff) {
+}
+
+GridMap::Ptr GridMap::load(const std::string& path, VirtualPosition position, VirtualSize size) {
+	Surface mask(path);
+	PhysicalSize pixels = mask.getSize();
+	if(size == VirtualSize(0, 0)) {
+		size = conv<PhysicalSize, VirtualSize>(pixels);
+	}
+
+	Ptr grid(new GridMap(position, size, pixels.getX(), pixels.getY()));
+	for(int32_t row = 0; row < pixels.getY(); ++row) {
+		for(int32_t column = 0; column < pixels.getX(); ++column) {
+			grid->setWalkable(column, row, mask.getAlpha(PhysicalPosition(column, row)) > 127);
+		}
+	}
+	grid->update();
+	return grid;
+}
+
+void GridMap::setWalkable(int32_t column, int32_t row, bool walkable) {
+	uint32_t &word = bits[row * wordsPerRow + (column >> 5)];
+	if(walkable) { word |= (1u << (column & 31)); }
+	else { word &= ~(1u << (column & 31)); }
+}
+
+void GridMap::fill(const polygon_t& polygon, bool walkable) {
+	if(polygon.beginNodes() == polygon.endNodes()) { return; }
+
+	// Only look at the cells in the bounding box of $polygon
+	int32_t c0, r0, c1, r1;
+	getCell(polygon.getTopLeft(), c0, r0);
+	getCell(polygon.getBottomRight(), c1, r1);
+
+	for(int32_t row = r0; row <= r1; ++row) {
+		for(int32_t column = c0; column <= c1; ++column) {
+			if(polygon.hasPoint(getCenter(column, row))) {
+				setWalkable(column, row, walkable);
+			}
+		}
+	}
+}
+
+void GridMap::update() {
+	const uint32_t FAR = 0xffff;
+
+	for(int32_t row = 0; row < rows; ++row) {
+		for(int32_t column = 0; column < columns; ++column) {
+			distances[row * columns + column] = isWalkable(column, row) ? 0 : FAR;
+		}
+	}
+
+	// Two pass chamfer transform: first spread the distances down and to
+	// the right, then up and to the left
+	for(int pass = 0; pass < 2; ++pass) {
+		int32_t s = (pass == 0) ? 1 : -1;
+		int32_t r0 = (pass == 0) ? 0 : rows - 1, c0 = (pass == 0) ? 0 : columns - 1;
+
+		for(int32_t row = r0; row >= 0 && row < rows; row += s) {
+			for(int32_t column = c0; column >= 0 && column < columns; column += s) {
+				uint32_t d = distances[row * columns + column];
+				if(d == 0) { continue; }
+
+				// neighbours already visited in this pass
+				const int32_t neighbours[4][3] = {
+					{ -s, 0, STRAIGHT_DISTANCE }, { -s, -s, DIAGONAL_DISTANCE },
+					{ 0, -s, STRAIGHT_DISTANCE }, { s, -s, DIAGONAL_DISTANCE }
+				};
+				for(int i = 0; i < 4; ++i) {
+					int32_t c = column + neighbours[i][0], r = row + neighbours[i][1];
+					if(c < 0 || r < 0 || c >= columns || r >= rows) { continue; }
+					d = std::min(d, distances[r * columns + c] + (uint32_t)neighbours[i][2]);
+				}
+				distances[row * columns + column] = std::min(d, FAR);
+			}
+		}
+	}
+}
+
+bool GridMap::getCell(VirtualPosition p, int32_t& column, int32_t& row) const {
+	double x = (p.getX() - origin.getX()) / getCellWidth(), y = (p.getY() - origin.getY()) / getCellHeight();
+	column = (int32_t)floor(x);
+	row = (int32_t)floor(y);
+	bool inside = (column >= 0 && row >= 0 && column < columns && row < rows);
+	column = std::max<int32_t>(0, std::min<int32_t>(columns - 1, column));
+	row = std::max<int32_t>(0, std::min<int32_t>(rows - 1, row));
+	return inside;
+}
+
+VirtualPosition GridMap::getCenter(int32_t column, int32_t row) const {
+	return VirtualPosition(
+		(int32_t)floor(origin.getX() + (column + 0.5) * getCellWidth() + 0.5),
+		(int32_t)floor(origin.getY() + (row + 0.5) * getCellHeight() + 0.5)
+	);
+}
+
+bool GridMap::findNearestWalkable(VirtualPosition p, int32_t& column, int32_t& row) const {
+	getCell(p, column, row);
+	if(getDistance(column, row) == 0xffff) { return false; }
+
+	// Every blocked cell has a neighbour that is closer to a walkable cell.
+	// Try the orthogonal ones first, so ties don't make us drift sideways.
+	const int32_t neighbours[8][2] = {
+		{ -1, 0 }, { 1, 0 }, { 0, -1 }, { 0, 1 },
+		{ -1, -1 }, { 1, -1 }, { -1, 1 }, { 1, 1 }
+	};
+	while(getDistance(column, row) != 0) {
+		int32_t bestColumn = column, bestRow = row;
+		for(int i = 0; i < 8; ++i) {
+			int32_t c = column + neighbours[i][0], r = row + neighbours[i][1];
+			if(c < 0 || r < 0 || c >= columns || r >= rows) { continue; }
+			if(getDistance(c, r) < getDistance(bestColumn, bestRow)) {
+				bestColumn = c;
+				bestRow = r;
+			}
+		}
+		if(bestColumn == column && bestRow == row) { return false; }
+		column = bestColumn;
+		row = bestRow;
+	}
+	return true;
+}
+
+bool GridMap::isVisible(int32_t column1, int32_t row1, int32_t column2, int32_t row2) const {
+	int64_t dx = std::abs(column2 - column1), dy = std::abs(row2 - row1);
+	int32_t sx = (column2 > column1) ? 1 : -1, sy = (row2 > row1) ? 1 : -1;
+
+	int32_t column = column1, row = row1;
+	if(!isWalkable(column, row)) { return false; }
+
+	// The line crosses its i-th vertical cell border at t = (2i + 1) / 2dx
+	// and its i-th horizontal one at t = (2i + 1) / 2dy, compare those
+	// exactly
+	int64_t ix = 0, iy = 0;
+	while(column != column2 || row != row2) {
+		int64_t tx = (2 * ix + 1) * dy, ty = (2 * iy + 1) * dx;
+		if(tx < ty) {
+			column += sx;
+			ix++;
+		}
+		else if(ty < tx) {
+			row += sy;
+			iy++;
+		}
+		else {
+			if(!isWalkable(column + sx, row) || !isWalkable(column, row + sy)) { return false; }
+			column += sx;
+			row += sy;
+			ix++;
+			iy++;
+		}
+		if(!isWalkable(column, row)) { return false; }
+	}
+	return true;
+}
+
+double GridSearch::distance(int32_t dx, int32_t dy) const {
+	// Octile distance, with cells that need not be square
+	double w = grid->getCellWidth(), h = grid->getCellHeight();
+	dx = std::abs(dx);
+	dy = std::abs(dy);
+	int32_t diagonal = std::min(dx, dy);
+	return diagonal * sqrt(w * w + h * h) + (dx - diagonal) * w + (dy - diagonal) * h;
+}
+
+bool GridSearch::jumpHorizontal(int32_t column, int32_t row, int32_t dx, int32_t& jumpColumn) const {
+	const GridMap &g = *grid;
+	int32_t start = column + dx;
+	if(start < 0 || start >= g.getColumns()) { return false; }
+
+	// Same rules as in jumpStraight(), but for a whole word of cells at
+	// once: Look for the first cell that is blocked or has a forced
+	// neighbour (a walkable cell above or below whose predecessor in
+	// walking direction is blocked).
+	for(int32_t w = start >> 5; w >= 0 && w < g.getWordsPerRow(); w += dx) {
+		uint32_t here = g.getWord(row, w), above = g.getWord(row - 1, w), below = g.getWord(row + 1, w);
+		uint32_t forced;
+		if(dx > 0) {
+			uint32_t abovePrevious = (above << 1) | (g.getWord(row - 1, w - 1) >> 31);
+			uint32_t belowPrevious = (below << 1) | (g.getWord(row + 1, w - 1) >> 31);
+			forced = (above & ~abovePrevious) | (below & ~belowPrevious);
+		}
+		else {
+			uint32_t abovePrevious = (above >> 1) | (g.getWord(row - 1, w + 1) << 31);
+			uint32_t belowPrevious = (below >> 1) | (g.getWord(row + 1, w + 1) << 31);
+			forced = (above & ~abovePrevious) | (below & ~belowPrevious);
+		}
+
+		uint32_t events = ~here | forced;
+		if(row == targetRow && (targetColumn >> 5) == w) {
+			events |= 1u << (targetColumn & 31);
+		}
+		if(w == (start >> 5)) {
+			// ignore the cells behind $start
+			events &= (dx > 0) ? (~0u << (start & 31)) : (~0u >> (31 - (start & 31)));
+		}
+
+		if(events) {
+			int bit = (dx > 0) ? lowestBit(events) : highestBit(events);
+			if(!(here & (1u << bit))) { return false; }
+			jumpColumn = (w << 5) + bit;
+			return true;
+		}
+	}
+	return false;
+}
+
+bool GridSearch::jumpStraight(int32_t column, int32_t row, int32_t dx, int32_t dy, int32_t& jumpColumn, int32_t& jumpRow) const {
+	if(dy == 0) {
+		jumpRow = row;
+		return jumpHorizontal(column, row, dx, jumpColumn);
+	}
+
+	const GridMap &g = *grid;
+	while(true) {
+		row += dy;
+		if(!g.isWalkable(column, row)) { return false; }
+
+		// A jump point is where a neighbour becomes reachable that was
+		// blocked off one step back
+		bool forced = (column == targetColumn && row == targetRow) ||
+			(g.isWalkable(column - 1, row) && !g.isWalkable(column - 1, row - dy)) ||
+			(g.isWalkable(column + 1, row) && !g.isWalkable(column + 1, row - dy));
+		if(forced) {
+			jumpColumn = column;
+			jumpRow = row;
+			return true;
+		}
+	}
+}
+
+bool GridSearch::jump(int32_t column, int32_t row, int32_t dx, int32_t dy, int32_t& jumpColumn, int32_t& jumpRow) const {
+	if(dx == 0 || dy == 0) {
+		return jumpStraight(column, row, dx, dy, jumpColumn, jumpRow);
+	}
+
+	const GridMap &g = *grid;
+	int32_t c, r;
+	while(true) {
+		// No cutting corners
+		if(!g.isWalkable(column + dx, row) || !g.isWalkable(column, row + dy)) { return false; }
+		column += dx;
+		row += dy;
+		if(!g.isWalkable(column, row)) { return false; }
+
+		if((column == targetColumn && row == targetRow) ||
+				jumpStraight(column, row, dx, 0, c, r) || jumpStraight(column, row, 0, dy, c, r)) {
+			jumpColumn = column;
+			jumpRow = row;
+			return true;
+		}
+	}
+}
+
+void GridSearch::addSuccessor(Index from, int32_t column, int32_t row) {
+	int32_t columns = grid->getColumns();
+	Index to = row * columns + column;
+	double cost = nodes[from].costSum + distance(column - (int32_t)(from % columns), row - (int32_t)(from / columns));
+
+	NodeState &n = nodes[to];
+	if(n.searchId != searchCounter) {
+		n.searchId = searchCounter;
+		n.closed = false;
+		n.parent = from;
+		n.costSum = cost;
+		n.estimate = cost + distance(targetColumn - column, targetRow - row);
+		border.push(to);
+	}
+	else if(!n.closed && cost < n.costSum) {
+		n.parent = from;
+		n.estimate -= n.costSum - cost;
+		n.costSum = cost;
+		border.decrease(to);
+	}
+}
+
+bool GridSearch::search(int32_t sourceColumn, int32_t sourceRow, std::vector<Index>& cells) {
+	const GridMap &g = *grid;
+	int32_t columns = g.getColumns();
+
+	if(nodes.size() < (size_t)(columns * g.getRows())) {
+		nodes.resize(columns * g.getRows());
+	}
+	border.clear();
+	if(++searchCounter == 0) {
+		// Wrapped around, make sure no stale state is mistaken for current
+		nodes.assign(nodes.size(), NodeState());
+		searchCounter = 1;
+	}
+	expanded = 0;
+
+	Index source = sourceRow * columns + sourceColumn;
+	NodeState &s = nodes[source];
+	s.searchId = searchCounter;
+	s.closed = false;
+	s.parent = NO_INDEX;
+	s.costSum = 0;
+	s.estimate = distance(targetColumn - sourceColumn, targetRow - sourceRow);
+	border.push(source);
+
+	while(!border.empty()) {
+		Index i = border.pop();
+		nodes[i].closed = true;
+		expanded++;
+
+		int32_t column = i % columns, row = i / columns;
+		if(column == targetColumn && row == targetRow) {
+			for(Index j = i; j != NO_INDEX; j = nodes[j].parent) {
+				cells.push_back(j);
+			}
+			std::reverse(cells.begin(), cells.end());
+			return true;
+		}
+
+		// Only follow the directions the shortest paths through here
+		// might take, coming from the parent
+		int32_t directions[8][2];
+		int n = 0;
+		if(nodes[i].parent == NO_INDEX) {
+			for(int32_t dy = -1; dy <= 1; ++dy) {
+				for(int32_t dx = -1; dx <= 1; ++dx) {
+					if(dx == 0 && dy == 0) { continue; }
+					directions[n][0] = dx; directions[n][1] = dy; n++;
+				}
+			}
+		}
+		else {
+			int32_t pc = nodes[i].parent % columns, pr = nodes[i].parent / columns;
+			int32_t dx = (column > pc) - (column < pc), dy = (row > pr) - (row < pr);
+			if(dx != 0 && dy != 0) {
+				directions[n][0] = dx; directions[n][1] = dy; n++;
+				directions[n][0] = dx; directions[n][1] = 0; n++;
+				directions[n][0] = 0; directions[n][1] = dy; n++;
+			}
+			else {
+				// dy, dx swapped is the perpendicular direction
+				directions[n][0] = dx; directions[n][1] = dy; n++;
+				directions[n][0] = dy; directions[n][1] = dx; n++;
+				directions[n][0] = -dy; directions[n][1] = -dx; n++;
+				directions[n][0] = dx + dy; directions[n][1] = dy + dx; n++;
+				directions[n][0] = dx - dy; directions[n][1] = dy - dx; n++;
+			}
+		}
+
+		for(int k = 0; k < n; ++k) {
+			int32_t c, r;
+			if(jump(column, row, directions[k][0], directions[k][1], c, r)) {
+				addSuccessor(i, c, r);
+			}
+		}
+	}
+	return false;
+}
+
+bool GridSearch::findPath(const GridMap& grid, VirtualPosition source, VirtualPosition target, Path& path) {
+	this->grid = &grid;
+
+	int32_t sourceColumn, sourceRow, column, row;
+	bool sourceInside = grid.getCell(source, column, row);
+	if(!grid.findNearestWalkable(source, sourceColumn, sourceRow) ||
+			!grid.findNearestWalkable(target, targetColumn, targetRow)) {
+		cdbg << "GridSearch: no walkable cells\n";
+		return false;
+	}
+	bool sourceMoved = !sourceInside || sourceColumn != column || sourceRow != row;
+
+	bool targetInside = grid.getCell(target, column, row);
+	VirtualPosition end = target;
+	if(!targetInside || targetColumn != column || targetRow != row) {
+		end = grid.getCenter(targetColumn, targetRow);
+	}
+
+	std::vector<Index> cells;
+	Index sourceIndex = sourceRow * grid.getColumns() + sourceColumn;
+	Index targetIndex = targetRow * grid.getColumns() + targetColumn;
+	if(grid.isVisible(sourceColumn, sourceRow, targetColumn, targetRow)) {
+		expanded = 0;
+		cells.push_back(sourceIndex);
+		cells.push_back(targetIndex);
+	}
+	else if(!search(sourceColumn, sourceRow, cells)) {
+		cdbg << "GridSearch: did not find path :(\n";
+		return false;
+	}
+
+	if(sourceMoved) {
+		path.push_back(grid.getCenter(sourceColumn, sourceRow));
+	}
+
+	// Skip all jump points that can be seen past
+	int32_t columns = grid.getColumns();
+	size_t anchor = 0;
+	while(anchor + 1 < cells.size()) {
+		size_t next = anchor + 1;
+		while(next + 1 < cells.size() && grid.isVisible(
+					cells[anchor] % columns, cells[anchor] / columns,
+					cells[next + 1] % columns, cells[next + 1] / columns)) {
+			next++;
+		}
+		if(next + 1 < cells.size()) {
+			path.push_back(grid.getCenter(cells[next] % columns, cells[next] / columns));
+		}
+		anchor = next;
+	}
+	path.push_back(end);
+	return true;
+}
+
+} // namespace grail
+
@@ -0,0 +1,223 @@
+// vim: set noexpandtab:
+
+#ifndef GRID_MAP_H
+#define GRID_MAP_H
+
+#include <string>
+#include <vector>
+#include <stdint.h>
+#include <boost/shared_ptr.hpp>
+
+#include "vector2d.h"
+#include "polygon.h"
+#include "actor.h" // ->Path
+#include "indexed_heap.h"
+
+namespace grail {
+
+/**
+ * Walkable area given as a grid of cells (e.g. the pixels of a mask
+ * image) instead of polygons.
+ *
+ * Walkability is stored as one bit per cell, each row padded to whole 32
+ * bit words. Along with it a distance transform is kept that tells for
+ * every blocked cell how far the next walkable one is (in 3-4 chamfer
+ * units), so points off the walkable area can be moved onto it by just
+ * walking downhill.
+ *
+ * Usage: setWalkable() or fill() the cells, then update(), then search
+ * with a GridSearch.
+ */
+class GridMap {
+	public:
+		typedef boost::shared_ptr<GridMap> Ptr;
+		typedef Polygon<VirtualPosition, IsPosition> polygon_t;
+
+		/// Chamfer distances of orthogonal and diagonal neighbours
+		static const uint16_t STRAIGHT_DISTANCE = 3, DIAGONAL_DISTANCE = 4;
+
+	private:
+		VirtualPosition origin;
+		VirtualSize size;
+		int32_t columns, rows;
+		int32_t wordsPerRow;
+
+		std::vector<uint32_t> bits;
+		std::vector<uint16_t> distances;
+
+	public:
+		/**
+		 * All cells blocked.
+		 *
+		 * @param origin upper left corner of the area covered by the grid
+		 * @param size size of the area covered by the grid
+		 */
+		GridMap(VirtualPosition origin, VirtualSize size, int32_t columns, int32_t rows);
+
+		/**
+		 * Load the grid from a mask image, pixels with an alpha value above
+		 * 127 are walkable (just like Image::hasPoint()).
+		 *
+		 * @param position where the image is placed in the scene
+		 * @param size size of the image in the scene, (0, 0) means the
+		 * 	size it is displayed with (see Image::getSize())
+		 */
+		static Ptr load(const std::string& path, VirtualPosition position, VirtualSize size = VirtualSize(0, 0));
+
+		int32_t getColumns() const { return columns; }
+		int32_t getRows() const { return rows; }
+		VirtualPosition getOrigin() const { return origin; }
+		VirtualSize getSize() const { return size; }
+
+		/// Width and height of a cell
+		double getCellWidth() const { return (double)size.getX() / columns; }
+		double getCellHeight() const { return (double)size.getY() / rows; }
+
+		/// Bytes used for the cells (not counting the object itself)
+		size_t getMemoryUsage() const {
+			return bits.size() * sizeof(uint32_t) + distances.size() * sizeof(uint16_t);
+		}
+
+		/// Cells outside of the grid are blocked
+		bool isWalkable(int32_t column, int32_t row) const {
+			if(column < 0 || row < 0 || column >= columns || row >= rows) { return false; }
+			return bits[row * wordsPerRow + (column >> 5)] & (1u << (column & 31));
+		}
+
+		void setWalkable(int32_t column, int32_t row, bool walkable);
+
+		/**
+		 * Walkability of columns 32 * $word ... 32 * $word + 31 of $row,
+		 * one bit each (lowest bit first). Words outside of the grid are 0.
+		 */
+		uint32_t getWord(int32_t row, int32_t word) const {
+			if(row < 0 || word < 0 || row >= rows || word >= wordsPerRow) { return 0; }
+			return bits[row * wordsPerRow + word];
+		}
+		int32_t getWordsPerRow() const { return wordsPerRow; }
+
+		/**
+		 * Set all cells whose centers lie in $polygon (borders included).
+		 */
+		void fill(const polygon_t& polygon, bool walkable);
+
+		/**
+		 * Recompute the distance transform, call this after changing any
+		 * cells.
+		 */
+		void update();
+
+		/**
+		 * Chamfer distance from cell ($column, $row) to the nearest walkable
+		 * cell, 0 for walkable cells and 0xffff if there are none.
+		 */
+		uint16_t getDistance(int32_t column, int32_t row) const { return distances[row * columns + column]; }
+
+		/**
+		 * Cell containing $p, points outside of the grid are clamped to its
+		 * border.
+		 * @return true iff $p lies inside of the grid
+		 */
+		bool getCell(VirtualPosition p, int32_t& column, int32_t& row) const;
+
+		VirtualPosition getCenter(int32_t column, int32_t row) const;
+
+		/**
+		 * Find the walkable cell nearest to (the cell containing) $p.
+		 * @return false iff there are no walkable cells
+		 */
+		bool findNearestWalkable(VirtualPosition p, int32_t& column, int32_t& row) const;
+
+		/**
+		 * True iff all cells the straight line between the centers of
+		 * the two cells passes through are walkable. Where the line passes
+		 * exactly through a corner, the cells on both sides of the line
+		 * have to be walkable.
+		 */
+		bool isVisible(int32_t column1, int32_t row1, int32_t column2, int32_t row2) const;
+};
+
+/**
+ * Scratch space for path searches on a GridMap, keep one around per thread
+ * (like WaypointSearch).
+ *
+ * A search runs A* with jump point search, i.e. it moves along straight
+ * and diagonal lines and only puts the cells onto the heap where a
+ * shortest path might have to turn. Diagonal moves are only made where
+ * both orthogonal neighbours are walkable, so paths never cut corners.
+ * Horizontal jumps test 32 cells at once on the row bitsets.
+ * The jump points found are then pulled tight by dropping each one the
+ * path can skip without leaving the walkable area.
+ */
+class GridSearch {
+		typedef uint32_t Index;
+
+		static const Index NO_INDEX;
+
+		struct NodeState {
+			float costSum;
+			float estimate;
+			Index parent;
+			Index heapIndex;
+			uint32_t searchId;
+			bool closed;
+
+			NodeState() : costSum(0), estimate(0), parent(NO_INDEX),
+				heapIndex(0), searchId(0), closed(false) { }
+		};
+
+		struct HeapTraits {
+			std::vector<NodeState>* nodes;
+			HeapTraits(std::vector<NodeState>* nodes) : nodes(nodes) { }
+			bool less(Index a, Index b) const { return (*nodes)[a].estimate < (*nodes)[b].estimate; }
+			void setIndex(Index x, size_t i) const { (*nodes)[x].heapIndex = i; }
+			size_t getIndex(Index x) const { return (*nodes)[x].heapIndex; }
+		};
+
+		typedef IndexedHeap<Index, HeapTraits> Heap;
+
+		std::vector<NodeState> nodes;
+		Heap border;
+		uint32_t searchCounter;
+		size_t expanded;
+
+		const GridMap* grid;
+		int32_t targetColumn, targetRow;
+
+		double distance(int32_t dx, int32_t dy) const;
+		bool jump(int32_t column, int32_t row, int32_t dx, int32_t dy, int32_t& jumpColumn, int32_t& jumpRow) const;
+		bool jumpStraight(int32_t column, int32_t row, int32_t dx, int32_t dy, int32_t& jumpColumn, int32_t& jumpRow) const;
+		bool jumpHorizontal(int32_t column, int32_t row, int32_t dx, int32_t& jumpColumn) const;
+		void addSuccessor(Index from, int32_t column, int32_t row);
+		bool search(int32_t sourceColumn, int32_t sourceRow, std::vector<Index>& cells);
+
+	public:
+		GridSearch() : border(HeapTraits(&nodes)), searchCounter(0), expanded(0), grid(0),
+			targetColumn(0), targetRow(0) { }
+
+		/// Idle copy, the scratch space is not shared
+		GridSearch(const GridSearch& other) : border(HeapTraits(&nodes)), searchCounter(0), expanded(0), grid(0),
+			targetColumn(0), targetRow(0) { }
+
+		/**
+		 * Search a short path from $source to $target.
+		 * Points off the walkable area are moved to the center of the
+		 * nearest walkable cell first.
+		 *
+		 * @param path the path (excluding $source, including $target or
+		 * 	the point it was moved to) is appended here if one was found
+		 * @return true iff a path was found
+		 */
+		bool findPath(const GridMap& grid, VirtualPosition source, VirtualPosition target, Path& path);
+
+		/// Number of cells taken from the heap by the last search
+		size_t getExpanded() const { return expanded; }
+
+	private:
+		GridSearch& operator=(const GridSearch&);
+};
+
+} // namespace grail
+
+#endif // GRID_MAP_H
+
@@ -1,34 +1,103 @@
 // vim: set noexpandtab:
 
 #include <vector>
-using std::vector;
-#include <set>
-using std::set;
-#include <limits>
-using std::numeric_limits;
 #include <algorithm>
-using std::push_heap;
-using std::pop_heap;
+#include <map>
+#include <cmath>
+using std::vector;
 
 #include "ground.h"
+#include "visibility_sweep.h"
+#include "worker_pool.h"
+#include "path_cache.h"
 #include "debug.h"
 
 namespace grail {
 
-Ground::Ground() : rootComponent(0) {
+namespace {
+	/// How far (in pixels) snapToWalkable() moves inwards at most
+	const int MAX_SNAP_STEPS = 4;
+	
+	/**
+	 * Connects waypoint i to all waypoints with higher indices for item i
+	 * and collects the links separately for each worker.
+	 */
+	class ConnectJob : public WorkerPool::Job {
+			Ground& ground;
+			Ground::Component* component;
+			const std::vector<VirtualPosition>& waypoints;
+			const VisibilitySweep* sweep;
+			std::vector< std::vector<WaypointGraph::Link> > links;
+			
+		public:
+			ConnectJob(Ground& ground, Ground::Component* component, const std::vector<VirtualPosition>& waypoints,
+					const VisibilitySweep* sweep, unsigned workers) :
+				ground(ground), component(component), waypoints(waypoints), sweep(sweep), links(workers) { }
+			
+			void run(size_t item, unsigned worker) {
+				WaypointGraph::Index i = item;
+				if(sweep) {
+					sweep->sweep(i, links[worker]);
+					return;
+				}
+				for(WaypointGraph::Index j = i + 1; j < waypoints.size(); ++j) {
+					if(ground.directReachable(component, waypoints[i], waypoints[j])) {
+						links[worker].push_back(WaypointGraph::Link(i, j));
+					}
+				}
+			}
+			
+			/**
+			 * Append the links of all workers to $result, sorted so the
+			 * result doesn't depend on which worker did what.
+			 */
+			void merge(std::vector<WaypointGraph::Link>& result) {
+				size_t first = result.size();
+				for(size_t w = 0; w < links.size(); ++w) {
+					result.insert(result.end(), links[w].begin(), links[w].end());
+				}
+				std::sort(result.begin() + first, result.end());
+			}
+	};
+} // namespace
+
+Ground::Ground() : rootComponent(0), mapBuilder(BUILDER_BRUTE_FORCE), mapThreads(1),
+	engine(ENGINE_VISIBILITY_GRAPH), pathTables(false), version(0) {
+}
+
+Ground::Ground(const Ground& other) : rootComponent(0), nearTarget_(other.nearTarget_),
+	mapBuilder(other.mapBuilder), mapThreads(other.mapThreads), engine(other.engine),
+	pathTables(other.pathTables), grid(other.grid), pathCache(other.pathCache.getCapacity(), other.pathCache.getQuantum()),
+	version(other.version) {
+	if(other.rootComponent) {
+		rootComponent = new Component(*other.rootComponent);
+	}
 }
 
 Ground::~Ground() {
-	/*
-	list<Waypoint*>::iterator iter;
-	for(iter=waypoints.begin(); iter!=waypoints.end(); ++iter) {
+	delete rootComponent;
+}
+
+Ground::Component::Component(const Component& other) :
+	outerBoundary(other.outerBoundary), graph(other.graph), mapValid(other.mapValid),
+	pathTable(other.pathTable), pathTableValid(other.pathTableValid),
+	navMesh(other.navMesh), navMeshValid(other.navMeshValid),
+	edgeGrid(other.edgeGrid), edgeGridValid(other.edgeGridValid), obstacle(other.obstacle) {
+	for(const_hole_iter_t iter = other.holes.begin(); iter != other.holes.end(); ++iter) {
+		holes.push_back(new Component(**iter));
+	}
+}
+
+Ground::Component::~Component() {
+	for(hole_iter_t iter = holes.begin(); iter != holes.end(); ++iter) {
 		delete *iter;
 	}
-	*/
 }
 
 //void Ground::addPolygonToComponent(const Polygon<VirtualPosition, IsPosition>& polygon, Component* node) {
 void Ground::addPolygonToComponent(Polygon<VirtualPosition, IsPosition>::Ptr polygon, Component* node) {
+	version++;
+	
 	if(!node && !rootComponent) {
 		rootComponent = new Component(polygon);
 	}
@@ -38,7 +107,7 @@ void Ground::addPolygonToComponent(Polygon<VirtualPosition, IsPosition>::Ptr pol
 	else {
 		VirtualPosition pos = *(polygon->beginNodes());
 		for(Component::const_hole_iter_t iter = node->getHoles().begin(); iter != node->getHoles().end(); ++iter) {
-			if((*iter)->getOuterBoundary().hasPoint(pos)) {
+			if(!(*iter)->isObstacle() && (*iter)->getOuterBoundary().hasPoint(pos)) {
 				addPolygonToComponent(polygon, *iter);
 				return;
 			}
@@ -47,25 +116,202 @@ void Ground::addPolygonToComponent(Polygon<VirtualPosition, IsPosition>::Ptr pol
 	}
 } // addPolygon
 
-bool Ground::directReachable(Component* component, Waypoint& wp1, Waypoint& wp2) {
-	typedef Polygon<VirtualPosition, IsPosition> polygon_t;
+namespace {
+	struct BoundingBox {
+		VirtualPosition::Scalar left, top, right, bottom;
+		
+		BoundingBox(const Ground::Component::polygon_t& polygon) :
+			left(polygon.getTopLeft().getX()), top(polygon.getTopLeft().getY()),
+			right(polygon.getBottomRight().getX()), bottom(polygon.getBottomRight().getY()) {
+		}
+		
+		/// true iff the bounding box of $a - $b overlaps this one
+		bool touches(VirtualPosition a, VirtualPosition b) const {
+			return std::max(a.getX(), b.getX()) >= left && std::min(a.getX(), b.getX()) <= right &&
+				std::max(a.getY(), b.getY()) >= top && std::min(a.getY(), b.getY()) <= bottom;
+		}
+	};
+} // namespace
+
+bool Ground::addObstacle(Polygon<VirtualPosition, IsPosition>::Ptr polygon) {
+	Component *c = findWalkableComponent(*(polygon->beginNodes()));
+	if(!c || !c->getOuterBoundary().hasPoint(*(polygon->beginNodes()))) {
+		cdbg << "Ground::addObstacle: obstacle is not inside any walkable component\n";
+		return false;
+	}
 	
-	if(wp1 == wp2) { return true; }
+	// All of it has to be in the walkable area of $c: no corner in a hole,
+	// no edge crossing or touching the boundary or a hole and no hole
+	// inside of it
+	for(Polygon<VirtualPosition, IsPosition>::ConstNodeIterator iter = polygon->beginNodes(); iter != polygon->endNodes(); ++iter) {
+		if(!isWalkable(c, *iter)) {
+			cdbg << "Ground::addObstacle: obstacle is not inside the walkable area\n";
+			return false;
+		}
+	}
+	for(Polygon<VirtualPosition, IsPosition>::LineIterator iter = polygon->beginLines(); iter != polygon->endLines(); ++iter) {
+		if(c->getEdgeGrid().intersects(*iter, Line::TOUCH_OR_INTERSECT)) {
+			cdbg << "Ground::addObstacle: obstacle intersects the boundary of its component\n";
+			return false;
+		}
+	}
+	for(Component::const_hole_iter_t iter = c->getHoles().begin(); iter != c->getHoles().end(); ++iter) {
+		if(polygon->hasPoint(*((*iter)->getOuterBoundary().beginNodes()))) {
+			cdbg << "Ground::addObstacle: obstacle contains a hole\n";
+			return false;
+		}
+	}
+	version++;
+	
+	Component *o = new Component(polygon);
+	o->obstacle = true;
+	c->holes.push_back(o);
+	invalidateObstacleMaps(c);
+	
+	if(!c->hasValidMap()) { return true; }
+	
+	// The obstacle is the last hole now, so its corners go to the end of
+	// the waypoint list just like generateWaypoints() would put them.
+	std::vector<VirtualPosition> waypoints(c->getGraph().getPositions());
+	std::vector<WaypointGraph::Link> links;
+	getLinks(c, links);
+	size_t first = waypoints.size();
+	std::vector<Component::Corner> corners;
+	Component::addCorners(*polygon, c->holes.size(), corners);
+	for(std::vector<Component::Corner>::const_iterator iter = corners.begin(); iter != corners.end(); ++iter) {
+		if(iter->bending) {
+			waypoints.push_back(iter->position);
+		}
+	}
 	
-	const polygon_t &p = component->getOuterBoundary();
+	// Links near the obstacle might be blocked now
+	BoundingBox box(*polygon);
+	std::vector<WaypointGraph::Link> kept;
+	for(std::vector<WaypointGraph::Link>::const_iterator iter = links.begin(); iter != links.end(); ++iter) {
+		VirtualPosition a = waypoints[iter->first], b = waypoints[iter->second];
+		if(!box.touches(a, b) || directReachable(c, a, b)) {
+			kept.push_back(*iter);
+		}
+	}
 	
-	// Waypoints outside of the component are not reachable
-	if(!p.hasPoint(wp1.getPosition())) { return false; }
-	if(!p.hasPoint(wp2.getPosition())) { return false; }
+	for(size_t i = first; i < waypoints.size(); ++i) {
+		for(size_t j = 0; j < i; ++j) {
+			if(directReachable(c, waypoints[j], waypoints[i])) {
+				kept.push_back(WaypointGraph::Link(j, i));
+			}
+		}
+	}
 	
-	// Waypoints inside of holes are not reachable
-	for(Component::const_hole_iter_t iter = component->getHoles().begin(); iter != component->getHoles().end(); ++iter) {
-		const polygon_t &h = (*iter)->getOuterBoundary();
-		if(h.hasPoint(wp1.getPosition()) && !h.hasBoundaryPoint(wp1.getPosition())) { return false; }
-		if(h.hasPoint(wp2.getPosition()) && !h.hasBoundaryPoint(wp2.getPosition())) { return false; }
+	std::sort(kept.begin(), kept.end());
+	Component::rebuild(c->graph).build(waypoints, kept);
+	return true;
+}
+
+bool Ground::removeObstacle(Polygon<VirtualPosition, IsPosition>::Ptr polygon) {
+	std::vector<Component*> components;
+	if(rootComponent) {
+		collectWalkableComponents(rootComponent, components);
 	}
 	
-	Line l(wp1.getPosition(), wp2.getPosition());
+	Component *c = 0;
+	size_t hole = 0;
+	for(std::vector<Component*>::iterator iter = components.begin(); !c && iter != components.end(); ++iter) {
+		for(size_t i = 0; i < (*iter)->holes.size(); ++i) {
+			if((*iter)->holes[i]->isObstacle() && (*iter)->holes[i]->outerBoundary == polygon) {
+				c = *iter;
+				hole = i;
+				break;
+			}
+		}
+	}
+	if(!c) { return false; }
+	version++;
+	
+	// Find the block of waypoints that belongs to the obstacle, corners of
+	// hole i are counted as polygon i + 1
+	size_t first = 0, count = 0;
+	if(c->hasValidMap()) {
+		std::vector<Component::Corner> corners;
+		c->getCorners(corners);
+		for(std::vector<Component::Corner>::const_iterator iter = corners.begin(); iter != corners.end(); ++iter) {
+			if(!iter->bending) { continue; }
+			if(iter->polygon < hole + 1) { first++; }
+			else if(iter->polygon == hole + 1) { count++; }
+		}
+	}
+	
+	std::vector<WaypointGraph::Link> links;
+	if(c->hasValidMap()) {
+		getLinks(c, links);
+	}
+	
+	delete c->holes[hole];
+	c->holes.erase(c->holes.begin() + hole);
+	invalidateObstacleMaps(c);
+	
+	if(!c->hasValidMap()) { return true; }
+	
+	// Drop the waypoints of the obstacle and their links
+	const std::vector<VirtualPosition> &old = c->getGraph().getPositions();
+	std::vector<VirtualPosition> waypoints(old.begin(), old.begin() + first);
+	waypoints.insert(waypoints.end(), old.begin() + first + count, old.end());
+	
+	std::vector<WaypointGraph::Link> kept;
+	for(std::vector<WaypointGraph::Link>::const_iterator iter = links.begin(); iter != links.end(); ++iter) {
+		WaypointGraph::Index a = iter->first, b = iter->second;
+		if((a >= first && a < first + count) || (b >= first && b < first + count)) { continue; }
+		if(a >= first + count) { a -= count; }
+		if(b >= first + count) { b -= count; }
+		kept.push_back(WaypointGraph::Link(a, b));
+	}
+	std::sort(kept.begin(), kept.end());
+	
+	// Links near the obstacle might be free now
+	BoundingBox box(*polygon);
+	size_t keptBefore = kept.size();
+	for(size_t i = 0; i < waypoints.size(); ++i) {
+		for(size_t j = i + 1; j < waypoints.size(); ++j) {
+			if(box.touches(waypoints[i], waypoints[j])
+					&& !std::binary_search(kept.begin(), kept.begin() + keptBefore, WaypointGraph::Link(i, j))
+					&& directReachable(c, waypoints[i], waypoints[j])) {
+				kept.push_back(WaypointGraph::Link(i, j));
+			}
+		}
+	}
+	
+	std::sort(kept.begin(), kept.end());
+	Component::rebuild(c->graph).build(waypoints, kept);
+	return true;
+}
+
+void Ground::getLinks(Component* component, std::vector<WaypointGraph::Link>& links) {
+	const WaypointGraph &graph = component->getGraph();
+	for(WaypointGraph::Index i = 0; i < graph.size(); ++i) {
+		for(WaypointGraph::Index e = graph.beginEdges(i); e != graph.endEdges(i); ++e) {
+			if(i < graph.getEdge(e).target) {
+				links.push_back(WaypointGraph::Link(i, graph.getEdge(e).target));
+			}
+		}
+	}
+}
+
+void Ground::invalidateObstacleMaps(Component* component) {
+	// Everything but the waypoint map is rebuilt on next use
+	component->edgeGridValid = false;
+	component->navMeshValid = false;
+	component->pathTableValid = false;
+}
+
+bool Ground::directReachable(Component* component, VirtualPosition p1, VirtualPosition p2) {
+	typedef Polygon<VirtualPosition, IsPosition> polygon_t;
+	
+	if(p1 == p2) { return true; }
+	
+	// Waypoints outside of the component or inside of holes are not
+	// reachable
+	if(!isWalkable(component, p1) || !isWalkable(component, p2)) { return false; }
+	
+	Line l(p1, p2);
 	
 	// Even though no point is outside of the outer boundary (checked above),
 	// the line between them might cross the boundary (e.g. if the boundary
@@ -73,22 +319,11 @@ bool Ground::directReachable(Component* component, Waypoint& wp1, Waypoint& wp2)
 	// if l crosses the boundary that means there is no line of sight between
 	// wp1 and wp2 though.
 	// Ignore crossings when one of them is a boundary point though.
-	
-	for(polygon_t::LineIterator li = p.beginLines(); li != p.endLines(); ++li) {
-		if(/*l != *li &&*/ l.intersects(*li, Line::THIS_INNER | Line::OTHER_INNER | Line::OTHER_BOUNDARY)) {
-			return false;
-		}
-	}
-	
 	// Also, if $l crosses a hole, wp2 is not directly reachable from wp1.
-	for(Component::const_hole_iter_t hi = component->getHoles().begin(); hi != component->getHoles().end(); ++hi) {
-		const polygon_t& p = (*hi)->getOuterBoundary();
-		for(polygon_t::LineIterator li = p.beginLines(); li != p.endLines(); ++li) {
-			//if(l.intersects(*li)) {
-			if(l.intersects(*li, Line::THIS_INNER | Line::OTHER_INNER | Line::OTHER_BOUNDARY)) {
-				return false;
-			}
-		}
+	// The edge grid only hands us the edges near $l for both checks.
+	
+	if(component->getEdgeGrid().intersects(l, Line::THIS_INNER | Line::OTHER_INNER | Line::OTHER_BOUNDARY)) {
+		return false;
 	}
 	
 	// Also, it might happen that both lie directly on the outer boundary
@@ -117,235 +352,444 @@ bool Ground::directReachable(Component* component, Waypoint& wp1, Waypoint& wp2)
 	return true;
 }
 
-void Ground::generateMapForComponent(Component* component, VirtualPosition src, VirtualPosition tgt, Waypoint*& source, Waypoint*& target) {
-	if(!component) {
-		if(rootComponent) {
-			generateMapForComponent(rootComponent, src, tgt, source, target);
-		}
-		return;
-	}
-	
+bool Ground::isWalkable(Component* component, VirtualPosition p) {
 	typedef Polygon<VirtualPosition, IsPosition> polygon_t;
 	
-	component->clearWaypoints();
-	component->generateWaypoints();
-	
-	source = component->createWaypoint(src);
-	target = component->createWaypoint(tgt);
-	
-	// connect waypoints
+	if(!component->getOuterBoundary().hasPoint(p)) { return false; }
 	
-	for(Component::waypoint_iter_t wi = component->getWaypoints().begin(); wi != component->getWaypoints().end(); ++wi) {
-		for(Component::waypoint_iter_t wj = wi; wj != component->getWaypoints().end(); ++wj) {
-			if(directReachable(component, **wi, **wj) && (wi != wj)) {
-				(*wi)->linkBidirectional(**wj);
-			}
-			
-		} // for wj
-	} // for wi
+	for(Component::const_hole_iter_t iter = component->getHoles().begin(); iter != component->getHoles().end(); ++iter) {
+		const polygon_t &h = (*iter)->getOuterBoundary();
+		if(h.hasPoint(p) && !h.hasBoundaryPoint(p)) { return false; }
+	}
+	return true;
 }
 
-VirtualPosition Ground::findBoundaryPoint(VirtualPosition source, VirtualPosition target, const Ground::Component::polygon_t& poly) {
-	Line l(source, target);
-	VirtualPosition nearestPoint = source;
-	double nearestDistance = (target - source).length();
-	for(Component::polygon_t::LineIterator li = poly.beginLines(); li != poly.endLines(); ++li) {
-		if(l.intersects(*li, Line::TOUCH_OR_INTERSECT)) {
-			VirtualPosition p = l.intersection(*li);
-			double len = (target - p).length();
-			if(len < nearestDistance) {
-				len = nearestDistance;
-				nearestPoint = p;
-			}
+void Ground::generateMap() {
+	// The grid doesn't need anything generated
+	if(rootComponent && engine != ENGINE_GRID) {
+		generateMapRecursive(rootComponent);
+	}
+}
+
+bool Ground::hasCurrentMap(Component* component) const {
+	return (engine == ENGINE_NAVMESH) ? component->hasValidNavMesh() : component->hasValidMap();
+}
+
+void Ground::updateMap(Component* component) {
+	if(!hasCurrentMap(component)) {
+		generateMapForComponent(component);
+	}
+	if(engine == ENGINE_VISIBILITY_GRAPH && pathTables && !component->hasValidPathTable()) {
+		Component::rebuild(component->pathTable).build(component->getGraph(), mapThreads);
+		component->pathTableValid = true;
+	}
+}
+
+void Ground::generateMapRecursive(Component* component) {
+	std::vector<Component*> components;
+	collectWalkableComponents(component, components);
+	for(std::vector<Component*>::iterator iter = components.begin(); iter != components.end(); ++iter) {
+		updateMap(*iter);
+	}
+}
+
+void Ground::collectWalkableComponents(Component* component, std::vector<Component*>& components) {
+	components.push_back(component);
+	
+	// islands inside of holes are walkable again
+	for(Component::const_hole_iter_t it_hole = component->getHoles().begin(); it_hole != component->getHoles().end(); ++it_hole) {
+		for(Component::const_hole_iter_t it_island = (*it_hole)->getHoles().begin(); it_island != (*it_hole)->getHoles().end(); ++it_island) {
+			collectWalkableComponents(*it_island, components);
 		}
 	}
+}
+
+bool Ground::savePathTables(const std::string& filename) {
+	std::vector<Component*> components;
+	if(rootComponent) {
+		collectWalkableComponents(rootComponent, components);
+	}
 	
-	VirtualPosition p = nearestPoint; //findInnerPoint(nearestPoint, poly);
+	bool enabled = pathTables;
+	Engine e = engine;
+	pathTables = true;
+	engine = ENGINE_VISIBILITY_GRAPH;
 	
-	cdbg << "-------- found boundary point. " << " p=" << p <<
-		" orig=" << nearestPoint << " inpoly=" << poly.hasPoint(p) << "\n";
+	std::vector<const PathTable*> tables;
+	for(std::vector<Component*>::iterator iter = components.begin(); iter != components.end(); ++iter) {
+		updateMap(*iter);
+		tables.push_back(&(*iter)->getPathTable());
+	}
 	
-	return p;
+	pathTables = enabled;
+	engine = e;
+	return PathTable::save(filename, tables);
+}
+
+bool Ground::loadPathTables(const std::string& filename) {
+	std::vector<PathTable> tables;
+	if(!PathTable::load(filename, tables)) {
+		return false;
+	}
+	
+	std::vector<Component*> components;
+	if(rootComponent) {
+		collectWalkableComponents(rootComponent, components);
+	}
+	if(components.size() != tables.size()) {
+		cdbg << "Ground::loadPathTables: " << filename << " is for a different ground\n";
+		return false;
+	}
 	
-	//double ll = 10.0 / (source - target).length(); 
-	//return nearestPoint + (source - target) * ll;
+	// Tables are only good for exactly the maps they were built for
+	for(size_t i = 0; i < components.size(); ++i) {
+		if(!components[i]->hasValidMap()) {
+			Engine e = engine;
+			engine = ENGINE_VISIBILITY_GRAPH;
+			generateMapForComponent(components[i]);
+			engine = e;
+		}
+		const WaypointGraph &graph = components[i]->getGraph();
+		if(tables[i].size() != graph.size() || tables[i].getFingerprint() != PathTable::fingerprintOf(graph)) {
+			cdbg << "Ground::loadPathTables: " << filename << " is outdated\n";
+			return false;
+		}
+	}
 	
+	for(size_t i = 0; i < components.size(); ++i) {
+		components[i]->pathTable.reset(new PathTable(tables[i]));
+		components[i]->pathTableValid = true;
+	}
+	pathTables = true;
+	return true;
 }
 
-VirtualPosition Ground::findInnerPoint(VirtualPosition source, const Ground::Component::polygon_t& poly) {
-	int tries = 0;
-	int r = 1;
-	VirtualPosition p = source;
-	while(!poly.hasPoint(p) && (r <= 100)) {
-		for(int sx = -1; sx <= 1; sx += 2) {
-			for(int y = -r; y <= r; y++) {
-				tries++;
-				p = source + VirtualPosition(r * sx, y);
-				if(poly.hasPoint(p)) { break; }
-			}
-			if(poly.hasPoint(p)) { break; }
+void Ground::generateMapForComponent(Component* component) {
+	if(engine == ENGINE_NAVMESH) {
+		std::vector<const Component::polygon_t*> holes;
+		for(Component::const_hole_iter_t iter = component->getHoles().begin(); iter != component->getHoles().end(); ++iter) {
+			holes.push_back(&(*iter)->getOuterBoundary());
 		}
-		
-		for(int sy = -1; sy <= 1; sy += 2) {
-			for(int x = -r + 1; x < r; x++) {
-				tries++;
-				p = source + VirtualPosition(x, r * sy);
-				if(poly.hasPoint(p)) { break; }
-			}
-			if(poly.hasPoint(p)) { break; }
+		component->navMeshValid = true;
+		if(Component::rebuild(component->navMesh).build(component->getOuterBoundary(), holes)) {
+			return;
 		}
-		
-		r++;
+		// Searches in this component use the waypoint map instead
+		cdbg << "Ground: no navigation mesh for component, using the waypoint map\n";
 	}
 	
-	cdbg << "rescue from point " << source << " -> " << p << " in " << tries << " tries r=" << r << ".\n";
+	std::vector<VirtualPosition> waypoints;
+	std::vector<WaypointGraph::Link> links;
 	
-	return p;
-}
+	component->generateWaypoints(waypoints);
 	
-
-void Ground::getPath(VirtualPosition source, VirtualPosition target, Path& path) {
+	// The workers only read from the component, so set up everything that
+	// is otherwise created on first use now
+	component->getEdgeGrid();
 	
-	cdbg << "Ground::getPath(" << source << ", " << target << ")\n";
+	// connect waypoints
+	
+	VisibilitySweep *sweep = 0;
+	if(mapBuilder == BUILDER_ROTATIONAL_SWEEP) {
+		sweep = new VisibilitySweep(*this, component);
+	}
 	
-	// find innermost walkable component that contains source
-	// (root component is walkable, holes of holes of walkable components are
-	// walkable)
+	WorkerPool pool(mapThreads);
+	ConnectJob job(*this, component, waypoints, sweep, pool.getThreads());
+	pool.run(job, waypoints.size());
+	job.merge(links);
+	delete sweep;
 	
+	Component::rebuild(component->graph).build(waypoints, links);
+	component->mapValid = true;
+	component->pathTableValid = false;
+}
+
+void Ground::findVisibleWaypoints(Component* component, VirtualPosition p, std::vector<WaypointGraph::Edge>& links) {
+	const WaypointGraph &graph = component->getGraph();
+	for(WaypointGraph::Index i = 0; i < graph.size(); ++i) {
+		if(directReachable(component, p, graph.getPosition(i))) {
+			links.push_back(WaypointGraph::Edge(i, (p - graph.getPosition(i)).length()));
+		}
+	}
+}
+
+Ground::Component* Ground::findWalkableComponent(VirtualPosition p) {
 	Component *island = rootComponent, *c = 0;
-	do {
+	while(island) {
 		c = island;
 		island = 0;
 		
 		// it_hole = hole (not walkable)
-		for(Component::const_hole_iter_t it_hole = c->getHoles().begin(); it_hole != c->getHoles().end(); ++it_hole) {
+		for(Component::const_hole_iter_t it_hole = c->getHoles().begin(); !island && it_hole != c->getHoles().end(); ++it_hole) {
 			// it_island = walkable area inside hole
 			for(Component::const_hole_iter_t it_island = (*it_hole)->getHoles().begin(); it_island != (*it_hole)->getHoles().end(); ++it_island) {
-				if(island->getOuterBoundary().hasPoint(source)) {
+				if((*it_island)->getOuterBoundary().hasPoint(p)) {
 					island = *it_island;
-					// break out of both "for" loops
-					it_island = (*it_hole)->getHoles().end();
-					it_hole = (*it_hole)->getHoles().end();
+					break;
 				}
 			}
 		}
-	} while(island);
-	
-	if(!c) {
-		cdbg << "Ground::getPath: no WA component that contains source found! --> aborting pathfinding!\n";
-		return;
 	}
+	return c;
+}
+
+VirtualPosition Ground::findBoundaryPoint(Component* c, VirtualPosition source, VirtualPosition target) {
+	// The last crossing before $target is on the boundary of the hole
+	// $target is in (or on the outer boundary if it is outside), as no
+	// other edge of the component lies inside of that hole
+	double x, y;
+	if(!c->getEdgeGrid().lastCrossing(source, target, x, y)) {
+		return source;
+	}
+	return snapToWalkable(c, x, y, source.getX() - x, source.getY() - y);
+}
+
+VirtualPosition Ground::findInnerPoint(Component* c, VirtualPosition p) {
+	if(isWalkable(c, p)) { return p; }
 	
-	source = findInnerPoint(source, c->getOuterBoundary());
-	
-	// if target not in the component -> target := nearest polygon node
-	// to target
+	double x, y;
+	if(!c->getEdgeGrid().nearestPoint(p, x, y)) {
+		return p;
+	}
+	return snapToWalkable(c, x, y, x - p.getX(), y - p.getY());
+}
+
+VirtualPosition Ground::snapToWalkable(Component* c, double x, double y, double dx, double dy) {
+	// Rounding might put the boundary point on the wrong side of the
+	// boundary, so try the grid points around it, then move further
+	// inwards if the walkable area is too thin to have any
+	double len = sqrt(dx * dx + dy * dy);
+	if(len > 0.0) {
+		dx /= len;
+		dy /= len;
+	}
 	
-	VirtualPosition nearTarget;
-	if(c->getOuterBoundary().hasPoint(target)) {
-		nearTarget = target;
-		for(Component::const_hole_iter_t it_hole = c->getHoles().begin(); it_hole != c->getHoles().end(); ++it_hole) {
-			if((*it_hole)->getOuterBoundary().hasPoint(target)) {
-				nearTarget = findBoundaryPoint(source, target, (*it_hole)->getOuterBoundary());
-				break;
+	for(int step = 0; step <= MAX_SNAP_STEPS; ++step) {
+		double sx = x + step * dx, sy = y + step * dy;
+		VirtualPosition best;
+		double bestDistance = -1.0;
+		for(int i = 0; i < 4; ++i) {
+			VirtualPosition q((int32_t)floor(sx) + (i & 1), (int32_t)floor(sy) + (i >> 1));
+			double d = (q.getX() - sx) * (q.getX() - sx) + (q.getY() - sy) * (q.getY() - sy);
+			if((bestDistance < 0.0 || d < bestDistance) && isWalkable(c, q)) {
+				best = q;
+				bestDistance = d;
 			}
 		}
+		if(bestDistance >= 0.0) { return best; }
 	}
-	else {
-		nearTarget = findBoundaryPoint(source, target, c->getOuterBoundary());
-		cdbg << "Ground::getPath: nearTarget=" << nearTarget << "\n";
-		nearTarget_ = nearTarget;
-	}
-	
-	Waypoint *sourceWP, *targetWP;
 	
-	generateMapForComponent(c, source, nearTarget, sourceWP, targetWP);
+	cdbg << "Ground: no walkable point near (" << x << ", " << y << ")\n";
+	return VirtualPosition((int32_t)floor(x + 0.5), (int32_t)floor(y + 0.5));
+}
+
+void Ground::getPath(VirtualPosition source, VirtualPosition target, Path& path) {
 	
-	// compute path
-		
-		cdbg << "Ground::getPath: sourceWP: " <<  sourceWP << " " << sourceWP->getPosition()
-			<< " neighbor count: " << sourceWP->neighbours.size() <<   "\n";
+	cdbg << "Ground::getPath(" << source << ", " << target << ")\n";
 	
-	getPath(*sourceWP, *targetWP, path);
-}
+	if(!startPath(source, target, search, path)) {
+		search.advance((size_t)-1);
+		finishPath(source, target, search, path);
+	}
+} // getPath
 
-void Ground::getPath(Waypoint& source, Waypoint& target, Path& path) {
-	//cdbg << "this is getPath\n\n";
-	bool foundPath = false;
-	vector<Waypoint*> border;
-	set<Waypoint*> inner;
-	Waypoint* cheapestNode;
+void Ground::getPaths(VirtualPosition target, const std::vector<VirtualPosition>& sources, std::vector<Path>& paths) {
+	typedef std::pair<Component*, std::pair<VirtualPosition::Scalar, VirtualPosition::Scalar> > GroupKey;
 	
-	source.setCostSum(0);
+	paths.assign(sources.size(), Path());
 	
-	border.push_back(&source);
-	push_heap(border.begin(), border.end(), Waypoint::comparePointer);
+	if(engine == ENGINE_GRID) {
+		for(size_t i = 0; i < sources.size(); ++i) {
+			getPath(sources[i], target, paths[i]);
+		}
+		return;
+	}
 	
-	while(!border.empty()) {
-		//cdbg << "border size: " << border.size() << "\n";
-		
-		pop_heap(border.begin(), border.end(), Waypoint::comparePointer);
-		cheapestNode = border.back();
-		border.pop_back();
-		
-		//cdbg << "cheapestNode: " <<  cheapestNode->getPosition()
-			//<< " costSum: " << cheapestNode->getCostSum() << "\n";
-			//<< " neighbor count: " << cheapestNode->neighbours.size() <<   "\n";
+	// Sources that end up at the same point of the same component share
+	// one search tree
+	std::map<GroupKey, std::vector<size_t> > groups;
+	std::vector<VirtualPosition> innerSources(sources.size());
+	for(size_t i = 0; i < sources.size(); ++i) {
+		Component *c = findWalkableComponent(sources[i]);
+		if(!c) { continue; }
 		
+		updateMap(c);
+		if(engine == ENGINE_NAVMESH || (pathTables && c->hasValidPathTable())) {
+			// Those don't search the waypoint map anyway
+			getPath(sources[i], target, paths[i]);
+			continue;
+		}
 		
-		Waypoint::NeighbourIterator iter;
-		for(iter = cheapestNode->beginNeighbours(); iter != cheapestNode->endNeighbours(); iter++) {
-			//cdbg << "  neighbor: " << (*iter)->getPosition() << "\n";
+		innerSources[i] = findInnerPoint(c, sources[i]);
+		VirtualPosition nearTarget = findTargetPoint(c, innerSources[i], target);
+		groups[GroupKey(c, std::make_pair(nearTarget.getX(), nearTarget.getY()))].push_back(i);
+	}
+	
+	for(std::map<GroupKey, std::vector<size_t> >::const_iterator group = groups.begin(); group != groups.end(); ++group) {
+		Component *c = group->first.first;
+		VirtualPosition nearTarget(group->first.second.first, group->first.second.second);
 		
-			double cost = cheapestNode->costTo(*iter);
-			double newCost = cheapestNode->getCostSum() + cost;
-			
-			if(inner.count(*iter) < 1) {
-				// Node is totally new to us (neither in 'inner' or in 'border')
-				// ==> previous cost value is infinity
-				if(count(border.begin(), border.end(), *iter) < 1) {
-					//cdbg << "  updating cost: infty -> " << newCost << "\n";
-					
-					(*iter)->setCostSum(newCost);
-					(*iter)->cheapestParent = cheapestNode;
-					border.push_back(*iter);
-					push_heap(border.begin(), border.end(), Waypoint::comparePointer);
-					make_heap(border.begin(), border.end(), Waypoint::comparePointer);
-				}
-				else if(newCost < (*iter)->getCostSum()) {
-					//cdbg << "  updating cost: " << (*iter)->getCostSum() << " -> " << newCost << "\n";
-					
-					vector<Waypoint*>::iterator i;
-					i = find(border.begin(), border.end(), *iter);
-					border.erase(i);
-					(*iter)->setCostSum(newCost);
-					(*iter)->cheapestParent = cheapestNode;
-					border.push_back(*iter);
-					push_heap(border.begin(), border.end(), Waypoint::comparePointer);
-					make_heap(border.begin(), border.end(), Waypoint::comparePointer);
-				}
-			}
-		} // for
+		std::vector<WaypointGraph::Edge> targetLinks;
+		findVisibleWaypoints(c, nearTarget, targetLinks);
+		search.buildTree(c->getGraph(), nearTarget, targetLinks);
 		
-		inner.insert(cheapestNode);
-		if(cheapestNode == &target) {
-			foundPath = true;
+		for(std::vector<size_t>::const_iterator iter = group->second.begin(); iter != group->second.end(); ++iter) {
+			VirtualPosition source = innerSources[*iter];
+			std::vector<WaypointGraph::Edge> sourceLinks;
+			findVisibleWaypoints(c, source, sourceLinks);
+			search.getTreePath(source, sourceLinks, directReachable(c, source, nearTarget), paths[*iter]);
+		}
+	}
+}
+
+bool Ground::startPath(VirtualPosition source, VirtualPosition target, WaypointSearch& search, Path& path) {
+	if(engine == ENGINE_GRID) {
+		if(grid) {
+			gridSearch.findPath(*grid, source, target, path);
 		}
-	} // while
+		return true;
+	}
 	
-	if(foundPath) {
-		Waypoint* p = &target;
-		cdbg << "found path:\n";
-		do {
-			cdbg << p->getPosition() << "\n";
-			path.push_front(p->getPosition());
-			p = p->cheapestParent;
-		} while(p && *p != source);
+	Component *c = findWalkableComponent(source);
+	
+	if(!c) {
+		cdbg << "Ground::getPath: no WA component that contains source found! --> aborting pathfinding!\n";
+		return true;
 	}
-	else {
-		cdbg << "did not find path :(\n";
+	
+	// Paths are cached under the walkable point the search starts from,
+	// so clicks that start off the ground find them as well
+	source = findInnerPoint(c, source);
+	
+	pathCache.sync(version);
+	if(getCachedPath(c, source, target, path)) {
+		cdbg << "Ground::getPath: reusing cached path\n";
+		return true;
 	}
-} // getPath
+	
+	updateMap(c);
+	VirtualPosition nearTarget = findTargetPoint(c, source, target);
+	nearTarget_ = nearTarget;
+	
+	Path found;
+	if(!searchPath(c, source, nearTarget, search, navMeshSearch, found)) {
+		return false;
+	}
+	if(!found.empty()) {
+		pathCache.store(c, source, target, found);
+	}
+	path.insert(path.end(), found.begin(), found.end());
+	return true;
+}
+
+void Ground::finishPath(VirtualPosition source, VirtualPosition target, const WaypointSearch& search, Path& path) {
+	Path found;
+	if(!search.getPath(found)) { return; }
+	
+	pathCache.sync(version);
+	Component *c = findWalkableComponent(source);
+	if(c) {
+		// Same key as startPath() uses
+		pathCache.store(c, findInnerPoint(c, source), target, found);
+	}
+	path.insert(path.end(), found.begin(), found.end());
+}
+
+bool Ground::getCachedPath(Component* c, VirtualPosition source, VirtualPosition target, Path& path) {
+	const PathCache::Entry *e = pathCache.lookup(c, source, target);
+	if(!e || e->path.empty()) { return false; }
+	
+	if(e->source == source && e->target == target) {
+		path.insert(path.end(), e->path.begin(), e->path.end());
+		return true;
+	}
+	
+	// The path was found for slightly different end points, it's only good
+	// if both ends can still be walked straight
+	Path p = e->path;
+	if(e->target != target) {
+		if(p.back() != e->target) {
+			// target was moved onto a boundary
+			return false;
+		}
+		p.back() = target;
+	}
+	if(!directReachable(c, source, p.front())) { return false; }
+	if(p.size() > 1 && !directReachable(c, *(++p.rbegin()), p.back())) { return false; }
+	
+	path.insert(path.end(), p.begin(), p.end());
+	return true;
+}
+
+void Ground::prepareConcurrentQueries() {
+	generateMap();
+	
+	std::vector<Component*> components;
+	if(rootComponent) {
+		collectWalkableComponents(rootComponent, components);
+	}
+	for(std::vector<Component*>::iterator iter = components.begin(); iter != components.end(); ++iter) {
+		(*iter)->getEdgeGrid();
+	}
+}
+
+void Ground::findPath(VirtualPosition source, VirtualPosition target, SearchSpace& space, Path& path) {
+	if(engine == ENGINE_GRID) {
+		if(grid) {
+			space.grid.findPath(*grid, source, target, path);
+		}
+		return;
+	}
+	
+	Component *c = findWalkableComponent(source);
+	if(!c || !hasCurrentMap(c)) {
+		return;
+	}
+	
+	source = findInnerPoint(c, source);
+	VirtualPosition nearTarget = findTargetPoint(c, source, target);
+	if(!searchPath(c, source, nearTarget, space.waypoints, space.navMesh, path)) {
+		space.waypoints.advance((size_t)-1);
+		space.waypoints.getPath(path);
+	}
+}
+
+VirtualPosition Ground::findTargetPoint(Component* c, VirtualPosition source, VirtualPosition target) {
+	// if target is outside of the component or in one of its holes ->
+	// target := where the way there leaves the walkable area
+	if(isWalkable(c, target)) {
+		return target;
+	}
+	VirtualPosition nearTarget = findBoundaryPoint(c, source, target);
+	cdbg << "Ground::getPath: nearTarget=" << nearTarget << "\n";
+	return nearTarget;
+}
+
+bool Ground::searchPath(Component* c, VirtualPosition source, VirtualPosition nearTarget, WaypointSearch& search, NavMeshSearch& navMeshSearch, Path& path) {
+	if(engine == ENGINE_NAVMESH && c->getNavMesh().size()) {
+		navMeshSearch.findPath(c->getNavMesh(), source, nearTarget, path);
+		return true;
+	}
+	
+	// Only link source and target into the (cached) map for the duration
+	// of the search
+	std::vector<WaypointGraph::Edge> sourceLinks, targetLinks;
+	findVisibleWaypoints(c, source, sourceLinks);
+	findVisibleWaypoints(c, nearTarget, targetLinks);
+	bool direct = directReachable(c, source, nearTarget);
+	
+	cdbg << "Ground::getPath: source: " << source
+		<< " neighbor count: " << sourceLinks.size() << "\n";
+	
+	if(pathTables && c->hasValidPathTable()) {
+		c->getPathTable().findPath(c->getGraph(), source, sourceLinks, nearTarget, targetLinks, direct, path);
+		return true;
+	}
+	
+	search.start(c->getGraph(), source, sourceLinks, nearTarget, targetLinks, direct);
+	return false;
+} // searchPath
 
 //#ifdef DEBUG
 //std::ostream& operator<<(std::ostream& os, const Ground::Waypoint& wp) {
@@ -11,89 +11,71 @@
 using std::list;
 #include <iostream>
 
+#include <boost/shared_ptr.hpp>
+
 #include "vector2d.h"
 #include "polygon.h"
 #include "actor.h" // ->Path
 #include "line.h"
 #include "utils.h" // ->sgn
+#include "waypoint_graph.h"
+#include "edge_grid.h"
+#include "navmesh.h"
+#include "grid_map.h"
+#include "path_cache.h"
+#include "path_table.h"
 
 namespace grail {
 
 /**
  * The "ground" of a scene. This defines, from where you can go where and how.
  * 
- * The current pathfinding implementation is improveable performance-wise
- * (e.g. we don't use A*, only dijkstra, we don't pre-calculate a
- * shortest-path map, etc...) However for the expected number of waypoints
- * this will handle, this should be more than suffcient.
+ * The visibility graph between the polygon corners of each component (the
+ * "map") is generated once after the last polygon has been added and kept
+ * until the ground changes again. A path query then only has to link its
+ * source and target into that map.
+ * 
+ * The map is stored as a compact @ref WaypointGraph, paths are searched
+ * with A* (euclidean distance heuristic).
+ * 
+ * For grounds that don't change, shortest paths between all waypoints can
+ * be precomputed (see @ref setPathTables) and stored along with the scene
+ * (see @ref savePathTables).
+ * 
+ * Alternatively (see @ref setEngine), each component can be triangulated
+ * into a @ref NavMesh instead. That is cheaper to build and store for big
+ * grounds, paths are then pulled tight inside the triangle corridor found
+ * by A* and thus not always the shortest ones.
+ * 
+ * Grounds drawn as a mask image rather than made of polygons can be
+ * searched on a @ref GridMap instead (see @ref setGrid).
  */
 class Ground {
 	public:
-		class Waypoint {
-			public:
-				typedef list<Waypoint*>::iterator NeighbourIterator;
-				
-				VirtualPosition position;
-				list<Waypoint*> neighbours;
-				double costSum;
-				
-				Waypoint(const Waypoint& other)
-					: position(other.position), neighbours(other.neighbours), costSum(other.costSum) { }
-				Waypoint& operator=(const Waypoint& other) {
-					position = other.position;
-					neighbours = other.neighbours;
-					costSum = other.costSum;
-					return *this;
-				}
-				
-			public:
-				Waypoint(VirtualPosition position) : position(position), costSum(0), cheapestParent(0) { }
-				virtual ~Waypoint() { reset(); }
-				
-				void link(Waypoint& other) { neighbours.push_back(&other); }
-				void unlink(Waypoint& other) {/* neighbours.remove(&other);*/ }
-				
-				Waypoint* cheapestParent;
-				
-				struct GetPosition {
-					static VirtualPosition getPosition(const Waypoint *wp) { return wp->getPosition(); }
-				};
-				
-				void reset() {
-					cheapestParent = 0;
-					NeighbourIterator iter;
-					for(iter = beginNeighbours(); iter != endNeighbours(); ++iter) {
-						(*iter)->unlink(*this);
-					}
-				}
-				
-				VirtualPosition getPosition() const { return position; }
-				bool operator==(const Waypoint& other) const { return position == other.position; }
-				bool operator!=(const Waypoint& other) const { return position != other.position; }
-				
-				void linkBidirectional(Waypoint& other) {
-					link(other);
-					other.link(*this);
-				}
-				
-				void setCostSum(double s) { costSum = s; }
-				double getCostSum() { return costSum; }
-				double costTo(Waypoint* other) { return (position - other->position).length(); }
-				static int comparePointer(Waypoint* a, Waypoint* b) {
-					return a->costSum > b->costSum;
-				}
-				NeighbourIterator beginNeighbours() { return neighbours.begin(); }
-				NeighbourIterator endNeighbours() { return neighbours.end(); }
-				
-				bool hasConnection(Waypoint* other) {
-					for(NeighbourIterator iter = beginNeighbours(); iter != endNeighbours(); ++iter) {
-						if(*iter == other) { return true; }
-					}
-					return false;
-				}
-				
-			friend class Ground;
-		};
+		/**
+		 * Algorithm used to connect the waypoints of a component.
+		 * Both produce the same map.
+		 * 
+		 * BUILDER_BRUTE_FORCE: test every pair of waypoints with
+		 * 	directReachable(), O(n^2) tests.
+		 * BUILDER_ROTATIONAL_SWEEP: for each waypoint, sweep a ray
+		 * 	around it and keep the edges it crosses ordered by distance
+		 * 	(Lee's algorithm, see @ref VisibilitySweep), O(n^2 log n)
+		 * 	in total. Use this for grounds with many corners.
+		 */
+		enum MapBuilder { BUILDER_BRUTE_FORCE, BUILDER_ROTATIONAL_SWEEP };
+		
+		/**
+		 * How paths are found.
+		 * 
+		 * ENGINE_VISIBILITY_GRAPH: shortest paths along the waypoint map.
+		 * ENGINE_NAVMESH: A* on a triangulation of each component, then
+		 * 	funnel smoothing. Components with polygons that touch or
+		 * 	cross can't be triangulated and use the waypoint map.
+		 * ENGINE_GRID: jump point search on the grid set with setGrid(),
+		 * 	then line of sight smoothing. The polygons are not used.
+		 */
+		enum Engine { ENGINE_VISIBILITY_GRAPH, ENGINE_NAVMESH, ENGINE_GRID };
 		
 		/**
 		 * A connected piece of ground area, bounded by one polygon for the
@@ -105,59 +87,162 @@ class Ground {
 				typedef Polygon<VirtualPosition, IsPosition> polygon_t;
 				typedef std::vector<Component*>::iterator hole_iter_t;
 				typedef std::vector<Component*>::const_iterator const_hole_iter_t;
-				typedef std::vector<Waypoint*>::iterator waypoint_iter_t;
-				typedef std::vector<Waypoint*>::const_iterator const_waypoint_iter_t;
 			
 			private:
 				//const polygon_t &outerBoundary;
 				polygon_t::ConstPtr outerBoundary;
 				std::vector<Component*> holes;
-				std::vector<Waypoint*> waypoints;
+				
+				// Shared with copies of the ground (snapshots) and never
+				// changed while shared, see rebuild()
+				boost::shared_ptr<WaypointGraph> graph;
+				bool mapValid;
+				boost::shared_ptr<PathTable> pathTable;
+				bool pathTableValid;
+				boost::shared_ptr<NavMesh> navMesh;
+				bool navMeshValid;
+				boost::shared_ptr<EdgeGrid> edgeGrid;
+				bool edgeGridValid;
+				bool obstacle;
+				
+				/**
+				 * $p to be built anew: a fresh object if the current one
+				 * is shared with a copy of the ground.
+				 */
+				template<typename T>
+				static T& rebuild(boost::shared_ptr<T>& p) {
+					if(!p.unique()) {
+						p.reset(new T);
+					}
+					return *p;
+				}
+				
+				static void addEdges(const polygon_t& polygon, EdgeGrid& grid) {
+					for(polygon_t::LineIterator li = polygon.beginLines(); li != polygon.endLines(); ++li) {
+						grid.addEdge(*li);
+					}
+				}
 				
 			public:
 				//Component(const polygon_t& ob) : outerBoundary(&ob) { }
-				Component(polygon_t::ConstPtr ob) : outerBoundary(ob) { }
+				Component(polygon_t::ConstPtr ob) : outerBoundary(ob),
+					graph(new WaypointGraph), mapValid(false), pathTable(new PathTable), pathTableValid(false),
+					navMesh(new NavMesh), navMeshValid(false), edgeGrid(new EdgeGrid), edgeGridValid(false), obstacle(false) { }
+				
+				/**
+				 * Copy, including all holes. Polygons, maps, path tables,
+				 * meshes and edge grids are shared, not copied.
+				 */
+				Component(const Component& other);
+				~Component();
 				
 				const polygon_t& getOuterBoundary() { return *outerBoundary; }
 				const std::vector<Component*>& getHoles() { return holes; }
-				std::vector<Waypoint*>& getWaypoints() { return waypoints; }
+				const WaypointGraph& getGraph() const { return *graph; }
+				const PathTable& getPathTable() const { return *pathTable; }
+				const NavMesh& getNavMesh() const { return *navMesh; }
 				
 				void addHole(Component* hole) {
 					holes.push_back(hole);
+					mapValid = false;
+					pathTableValid = false;
+					navMeshValid = false;
+					edgeGridValid = false;
 				}
 				
-				void addWaypoint(const Waypoint& wp) {
-					waypoints.push_back(new Waypoint(wp));
+				/**
+				 * Spatial index over the edges of the outer boundary and
+				 * all holes, built on first use.
+				 */
+				const EdgeGrid& getEdgeGrid() {
+					if(!edgeGridValid) {
+						EdgeGrid& grid = rebuild(edgeGrid);
+						grid.clear();
+						addEdges(*outerBoundary, grid);
+						for(hole_iter_t iter = holes.begin(); iter != holes.end(); ++iter) {
+							addEdges(*((*iter)->outerBoundary), grid);
+						}
+						grid.build();
+						edgeGridValid = true;
+					}
+					return *edgeGrid;
 				}
 				
-				Waypoint* createWaypoint(VirtualPosition p) {
-					Waypoint *r = new Waypoint(p);
-					waypoints.push_back(r);
-					return r;
-				}
+				/**
+				 * True iff the waypoints of this component and their links
+				 * are up to date with its boundaries.
+				 */
+				bool hasValidMap() const { return mapValid; }
+				
+				/// True iff the path table matches the current map
+				bool hasValidPathTable() const { return mapValid && pathTableValid; }
+				
+				/// True iff this is a hole added with Ground::addObstacle()
+				bool isObstacle() const { return obstacle; }
 				
-				void clearWaypoints() {
-					for(waypoint_iter_t i = waypoints.begin(); i != waypoints.end(); ++i) {
-						delete *i;
+				/// Same as hasValidMap() for the navigation mesh
+				bool hasValidNavMesh() const { return navMeshValid; }
+				
+				
+				/**
+				 * A polygon node of the outer boundary or of one of the
+				 * holes, together with its neighbours.
+				 */
+				struct Corner {
+					VirtualPosition prev, position, next;
+					polygon_t::Orientation orientation;
+					/// 0 for the outer boundary, i for the i-th hole
+					size_t polygon;
+					/// true iff a shortest path might bend around this corner
+					bool bending;
+				};
+				
+				/**
+				 * Append all corners of the outer boundary and of the holes
+				 * (in that order) to $corners.
+				 * 
+				 * A shortest path only ever bends around corners that
+				 * point into the walkable area, i.e. reflex corners of the
+				 * outer boundary and convex corners of the holes. Only those
+				 * (but not collinear ones) are marked as bending.
+				 */
+				void getCorners(std::vector<Corner>& corners) const {
+					addCorners(*outerBoundary, 0, corners);
+					for(size_t i = 0; i < holes.size(); ++i) {
+						addCorners(*(holes[i]->outerBoundary), i + 1, corners);
 					}
-					waypoints.clear();
 				}
 				
-				void generateWaypoints() {
-					std::vector<const polygon_t*> polygons;
-					polygons.push_back(&*(outerBoundary));
-					for(Component::hole_iter_t iter = holes.begin(); iter != holes.end(); ++iter) {
-						polygons.push_back(&*((*iter)->outerBoundary));
-					}
-	
-					//waypoints.clear();
-					for(std::vector<const polygon_t*>::iterator pi = polygons.begin(); pi != polygons.end(); ++pi) {
-						for(polygon_t::ConstNodeIterator ni = (*pi)->beginNodes(); ni != (*pi)->endNodes(); ++ni) {
-							waypoints.push_back(new Waypoint(*ni));
+				/**
+				 * Append the positions of all bending corners (see
+				 * getCorners()) to $waypoints.
+				 */
+				void generateWaypoints(std::vector<VirtualPosition>& waypoints) const {
+					std::vector<Corner> corners;
+					getCorners(corners);
+					for(std::vector<Corner>::const_iterator iter = corners.begin(); iter != corners.end(); ++iter) {
+						if(iter->bending) {
+							waypoints.push_back(iter->position);
 						}
 					}
 				}
 				
+				static void addCorners(const polygon_t& polygon, size_t index, std::vector<Corner>& corners) {
+					size_t n = polygon.size();
+					bool hole = (index != 0);
+					
+					for(size_t i = 0; i < n; ++i) {
+						Corner c;
+						c.prev = polygon[(i + n - 1) % n];
+						c.position = polygon[i];
+						c.next = polygon[(i + 1) % n];
+						c.orientation = polygon.getOrientation();
+						c.polygon = index;
+						c.bending = (n < 3) || (!polygon.isStraight(i) && polygon.isConvex(i) == hole);
+						corners.push_back(c);
+					}
+				}
+				
 				#if VISUALIZE_GROUND
 				void renderAt(SDL_Surface* target, uint32_t ticks, VirtualPosition p) const {
 					#if VISUALIZE_COMPONENTS
@@ -168,12 +253,22 @@ class Ground {
 					#endif
 					
 					#if VISUALIZE_MAP
-					for(Component::const_waypoint_iter_t wi = waypoints.begin(); wi != waypoints.end(); ++wi) {
-						for(Component::const_waypoint_iter_t wj = wi; wj != waypoints.end(); ++wj) {
-							
-							if((*wi)->hasConnection(*wj)) {
-								PhysicalPosition a = conv<VirtualPosition, PhysicalPosition>((*wi)->getPosition() + p);
-								PhysicalPosition b = conv<VirtualPosition, PhysicalPosition>((*wj)->getPosition() + p);
+					const NavMesh &navMesh = getNavMesh();
+					for(NavMesh::Index i = 0; navMeshValid && i < navMesh.size(); ++i) {
+						const NavMesh::Triangle &t = navMesh.getTriangle(i);
+						for(int k = 0; k < 3; ++k) {
+							PhysicalPosition a = conv<VirtualPosition, PhysicalPosition>(t.corners[k] + p);
+							PhysicalPosition b = conv<VirtualPosition, PhysicalPosition>(t.corners[(k + 1) % 3] + p);
+							aalineColor(target, a.getX(), a.getY(), b.getX(), b.getY(), 0xffffff40);
+						}
+					}
+					const WaypointGraph &graph = getGraph();
+					for(WaypointGraph::Index i = 0; i < graph.size(); ++i) {
+						for(WaypointGraph::Index e = graph.beginEdges(i); e != graph.endEdges(i); ++e) {
+							WaypointGraph::Index j = graph.getEdge(e).target;
+							if(i < j) {
+								PhysicalPosition a = conv<VirtualPosition, PhysicalPosition>(graph.getPosition(i) + p);
+								PhysicalPosition b = conv<VirtualPosition, PhysicalPosition>(graph.getPosition(j) + p);
 								aalineColor(target, a.getX(), a.getY(), b.getX(), b.getY(), 0xffffff40);
 							}
 						}
@@ -182,9 +277,31 @@ class Ground {
 					
 				}
 				#endif
+				
+			friend class Ground;
+			
+			private:
+				Component& operator=(const Component&);
+		};
+		
+		/**
+		 * Scratch space for findPath(), one per thread.
+		 */
+		struct SearchSpace {
+			WaypointSearch waypoints;
+			NavMeshSearch navMesh;
+			GridSearch grid;
 		};
 		
 		Ground();
+		
+		/**
+		 * Copy all components, their maps and the settings (not the cached
+		 * paths), e.g. to get a snapshot that is not affected by later
+		 * changes. Cheap: the maps are shared until one of the grounds
+		 * rebuilds them.
+		 */
+		Ground(const Ground& other);
 		~Ground();
 		
 		/**
@@ -202,30 +319,217 @@ class Ground {
 		void addPolygonToComponent(Polygon<VirtualPosition, IsPosition>::Ptr polygon, Component* node);
 		
 		/**
-		 * Call this after having added all needed walls/polygons.
-		 * It will generate waypoints for all corners and connect them
-		 * appropriately to allow pathfinding.
+		 * Block the area of $polygon until removeObstacle() is called
+		 * with it, e.g. for the footprint of a standing actor or an
+		 * opened chest. Obstacles behave like holes of the walkable
+		 * component that contains them (this also means actors standing
+		 * inside one can't go anywhere, so remove an actor's own footprint
+		 * before searching a path for it).
 		 * 
-		 * @param component the component to construct waypoints for
-		 * @param src source position for navigation
-		 * @param tgt target position for navigation
-		 * @param source used to return address of constructed source waypoint
-		 * @param target used to return address of constructed target waypoint
+		 * An existing map is updated in place: Only links whose line
+		 * passes the bounding box of the obstacle are tested again and
+		 * only the corners of the obstacle are linked in. A navigation mesh
+		 * or path table of the component is rebuilt on next use though.
 		 * 
+		 * @return false (and nothing changed) if $polygon is not
+		 * 	completely inside the walkable area of one component, i.e.
+		 * 	if it touches or crosses its boundary or any of its holes
 		 */
-		void generateMapForComponent(Component* component, VirtualPosition src, VirtualPosition tgt, Waypoint*& source, Waypoint*& target);
+		bool addObstacle(Polygon<VirtualPosition, IsPosition>::Ptr polygon);
 		
 		/**
+		 * Remove an obstacle added with addObstacle(), updating an
+		 * existing map the same way.
+		 * 
+		 * @return false if $polygon is no obstacle of this ground
 		 */
-		bool directReachable(Component*, Waypoint&, Waypoint&);
+		bool removeObstacle(Polygon<VirtualPosition, IsPosition>::Ptr polygon);
+		
+		/**
+		 * Generate the maps of all walkable components that don't have an
+		 * up-to-date one yet.
+		 * Call this after having added all needed walls/polygons, else the
+		 * first path query will do it for you.
+		 */
+		void generateMap();
+		
+		/**
+		 * Select how maps are generated from now on, see @ref MapBuilder.
+		 */
+		void setMapBuilder(MapBuilder builder) { mapBuilder = builder; }
+		MapBuilder getMapBuilder() const { return mapBuilder; }
+		
+		/**
+		 * Number of threads used to connect the waypoints of a component,
+		 * 0 means one per CPU core. Defaults to 1.
+		 * The map does not depend on this setting.
+		 */
+		void setMapThreads(unsigned threads) { mapThreads = threads; }
+		unsigned getMapThreads() const { return mapThreads; }
+		
+		/**
+		 * Select the pathfinding engine, see @ref Engine.
+		 * Maps for the new engine are generated on the next call to
+		 * generateMap() or getPath().
+		 */
+		void setEngine(Engine engine) { this->engine = engine; version++; }
+		Engine getEngine() const { return engine; }
+		
+		/**
+		 * Use $grid for ENGINE_GRID. Copies of the ground share it, so
+		 * don't change its cells afterwards (set a new one instead).
+		 */
+		void setGrid(GridMap::Ptr grid) { this->grid = grid; version++; }
+		GridMap::Ptr getGrid() const { return grid; }
+		
+		/**
+		 * If enabled, shortest paths between all waypoints of each
+		 * component are computed along with its map (see @ref PathTable),
+		 * so getPath() doesn't need to search anymore. Only worth it for
+		 * grounds that don't change. Defaults to false.
+		 * Only used with ENGINE_VISIBILITY_GRAPH.
+		 */
+		void setPathTables(bool enable) { pathTables = enable; }
+		bool getPathTables() const { return pathTables; }
+		
+		/**
+		 * Write the path tables of all components to $filename,
+		 * generating maps and tables first where necessary.
+		 * 
+		 * @return false if the file could not be written
+		 */
+		bool savePathTables(const std::string& filename);
+		
+		/**
+		 * Use the path tables stored in $filename by savePathTables() (the
+		 * file is mapped into memory, not read) and enable path tables.
+		 * Call this after having added all polygons. The maps are
+		 * generated if necessary, but not the tables.
+		 * 
+		 * @return false if the file could not be read or does not fit
+		 * 	this ground, nothing is changed then
+		 */
+		bool loadPathTables(const std::string& filename);
+		
+		/**
+		 * Number of recently found paths to keep around for reuse by
+		 * getPath(), 0 disables caching. Defaults to 64.
+		 */
+		void setPathCacheSize(size_t size) { pathCache.setCapacity(size); }
+		const PathCache& getPathCache() const { return pathCache; }
+		
+		/**
+		 * Counter that changes whenever paths found so far might not be
+		 * valid anymore (polygons added, engine changed).
+		 */
+		uint32_t getVersion() const { return version; }
+		
+		/**
+		 * Generate waypoints for all corners of the given component and
+		 * connect them appropriately to allow pathfinding.
+		 * The waypoints are distributed among @ref getMapThreads() threads.
+		 * With ENGINE_NAVMESH, triangulate the component instead.
+		 * The result is kept in the component until the ground changes.
+		 * 
+		 * @param component the component to construct waypoints for
+		 */
+		void generateMapForComponent(Component* component);
+		
+		/**
+		 * Collect edges from $p (e.g. source or target of a path query) to
+		 * all waypoints of the map of $component it can see.
+		 */
+		void findVisibleWaypoints(Component* component, VirtualPosition p, std::vector<WaypointGraph::Edge>& links);
+		
+		/**
+		 * True iff there is a straight walkable line between $p1 and $p2
+		 * in $component.
+		 */
+		bool directReachable(Component*, VirtualPosition p1, VirtualPosition p2);
+		
+		/**
+		 * True iff $p is inside the outer boundary of $component (or on
+		 * it) and not strictly inside one of its holes.
+		 */
+		bool isWalkable(Component* component, VirtualPosition p);
+		
+		/**
+		 * Return the innermost walkable component that contains $p.
+		 * (root component is walkable, holes of holes of walkable
+		 * components are walkable)
+		 */
+		Component* findWalkableComponent(VirtualPosition p);
+		
+		/**
+		 * Walkable point of $component closest to $p ($p itself if it is
+		 * walkable), i.e. where path queries from $p start.
+		 */
+		VirtualPosition findWalkablePoint(Component* component, VirtualPosition p) { return findInnerPoint(component, p); }
 		
 		/**
 		 * Returns a points of nodes that discribe a path from source to target.
+		 * 
+		 * Recently found paths are reused for queries from and to about the
+		 * same positions (see @ref PathCache) if they are still good for
+		 * the exact positions.
 		 */
 		void getPath(VirtualPosition source, VirtualPosition target, Path& path);
 		
-		/// ditto.
-		void getPath(Waypoint& source, Waypoint& target, Path& path);
+		/**
+		 * Find paths from all $sources to the same $target, like getPath()
+		 * for each of them, but with one search over the waypoint map
+		 * (from $target, building a tree of the shortest paths to all
+		 * waypoints) instead of one per source.
+		 * The path cache is only used where this falls back to getPath(),
+		 * i.e. for the grid and navmesh engines and for components with a
+		 * path table.
+		 * 
+		 * @param paths paths[i] is the path for sources[i] (excluding it,
+		 * 	empty if there is none), anything in $paths before is
+		 * 	replaced
+		 */
+		void getPaths(VirtualPosition target, const std::vector<VirtualPosition>& sources, std::vector<Path>& paths);
+		
+		/**
+		 * Generate everything that is otherwise created on first use, so
+		 * findPath() can be called from several threads at once
+		 * afterwards (as long as the ground isn't changed anymore).
+		 */
+		void prepareConcurrentQueries();
+		
+		/**
+		 * Same as getPath(), but doesn't use or fill the path cache, keeps
+		 * all search state in $space and doesn't generate maps (no path
+		 * is found where they are missing). See prepareConcurrentQueries().
+		 */
+		void findPath(VirtualPosition source, VirtualPosition target, SearchSpace& space, Path& path);
+		
+		/**
+		 * First half of a getPath() query that can be spread over several
+		 * frames (see @ref PathTask): Do everything up to the actual
+		 * search on the waypoint map.
+		 * 
+		 * Only the visibility graph search is split up: With
+		 * ENGINE_NAVMESH, ENGINE_GRID or a path table the whole query
+		 * runs right here.
+		 * 
+		 * @return true if the query is done already (found in the cache,
+		 * 	answered by another engine, no walkable area) and the result
+		 * 	has been appended to $path. Else $search has been started and
+		 * 	the caller should advance() it until it is done, then call
+		 * 	finishPath().
+		 * 	The search is only valid as long as getVersion() doesn't
+		 * 	change.
+		 */
+		bool startPath(VirtualPosition source, VirtualPosition target, WaypointSearch& search, Path& path);
+		
+		/**
+		 * Append the result of a search started by startPath() to
+		 * $path (nothing if none was found) and remember it for later
+		 * queries.
+		 */
+		void finishPath(VirtualPosition source, VirtualPosition target, const WaypointSearch& search, Path& path);
+		
 		
 		#if VISUALIZE_GROUND
 		void renderAt(SDL_Surface* target, uint32_t ticks, VirtualPosition p) const {
@@ -246,12 +550,49 @@ class Ground {
 	private:
 	#endif
 		
-		VirtualPosition findBoundaryPoint(VirtualPosition source, VirtualPosition target, const Component::polygon_t& poly);
-		VirtualPosition findInnerPoint(VirtualPosition p, const Ground::Component::polygon_t& poly);
+		/**
+		 * Point on the way from $source to $target (which is not walkable)
+		 * where it leaves the walkable area of $c.
+		 */
+		VirtualPosition findBoundaryPoint(Component* c, VirtualPosition source, VirtualPosition target);
+		/**
+		 * Walkable point of $c closest to $p, i.e. $p itself or the
+		 * closest point on the boundary of $c or one of its holes.
+		 */
+		VirtualPosition findInnerPoint(Component* c, VirtualPosition p);
+		/**
+		 * Walkable grid point of $c closest to the boundary point ($x, $y),
+		 * searching further in direction ($dx, $dy) (towards the inside)
+		 * if needed.
+		 */
+		VirtualPosition snapToWalkable(Component* c, double x, double y, double dx, double dy);
+		void generateMapRecursive(Component* component);
+		bool hasCurrentMap(Component* component) const;
+		void updateMap(Component* component);
+		void collectWalkableComponents(Component* component, std::vector<Component*>& components);
+		void getLinks(Component* component, std::vector<WaypointGraph::Link>& links);
+		void invalidateObstacleMaps(Component* component);
+		bool getCachedPath(Component* c, VirtualPosition source, VirtualPosition target, Path& path);
+		VirtualPosition findTargetPoint(Component* c, VirtualPosition source, VirtualPosition target);
+		bool searchPath(Component* c, VirtualPosition source, VirtualPosition nearTarget, WaypointSearch& search, NavMeshSearch& navMeshSearch, Path& path);
 		
 	public:
 		Component *rootComponent;
 		VirtualPosition nearTarget_;
+		
+	private:
+		MapBuilder mapBuilder;
+		unsigned mapThreads;
+		Engine engine;
+		bool pathTables;
+		WaypointSearch search;
+		NavMeshSearch navMeshSearch;
+		GridMap::Ptr grid;
+		GridSearch gridSearch;
+		PathCache pathCache;
+		uint32_t version;
+		
+		Ground& operator=(const Ground&);
 };
 
 } // namespace grail
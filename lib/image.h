@@ -25,6 +25,9 @@ class Image : public Animation {
 		Image(std::string path) : surface(new Surface(path)) {
 		}
 		
+		Image(Surface::Ptr surface) : surface(surface) {
+		}
+		
 		virtual ~Image() {
 		}
 		
@@ -42,6 +45,9 @@ class Image : public Animation {
 		bool hasPoint(VirtualPosition p) const {
 			return surface->getAlpha(conv<VirtualPosition, PhysicalPosition>(p)) > 127;
 		}
+		
+		bool isDirty() const { return false; }
+		Surface::Ptr getStaticSurface() const { return surface; }
 };
 
 } // namespace grail
@@ -0,0 +1,103 @@
+// vim: set noexpandtab:
+
+#ifndef INDEXED_HEAP_H
+#define INDEXED_HEAP_H
+
+#include <vector>
+#include <cassert>
+#include <cstddef>
+
+namespace grail {
+
+/**
+ * Binary min-heap that knows where each of its elements is stored and thus
+ * supports a real decrease-key operation (which std::push_heap & co don't).
+ *
+ * The element type T is usually some kind of handle (a pointer or an index).
+ * Traits has to provide:
+ *
+ * - bool less(T a, T b) const: true iff a should be popped before b
+ * - void setIndex(T x, size_t i) const: remember heap position of x
+ * - size_t getIndex(T x) const: return what setIndex stored for x
+ */
+template<typename T, typename Traits>
+class IndexedHeap {
+		std::vector<T> heap;
+		Traits traits;
+
+		void place(T x, size_t i) {
+			heap[i] = x;
+			traits.setIndex(x, i);
+		}
+
+		void siftUp(size_t i) {
+			T x = heap[i];
+			while(i > 0) {
+				size_t parent = (i - 1) / 2;
+				if(!traits.less(x, heap[parent])) { break; }
+				place(heap[parent], i);
+				i = parent;
+			}
+			place(x, i);
+		}
+
+		void siftDown(size_t i) {
+			T x = heap[i];
+			size_t n = heap.size();
+			while(2 * i + 1 < n) {
+				size_t child = 2 * i + 1;
+				if(child + 1 < n && traits.less(heap[child + 1], heap[child])) {
+					child++;
+				}
+				if(!traits.less(heap[child], x)) { break; }
+				place(heap[child], i);
+				i = child;
+			}
+			place(x, i);
+		}
+
+	public:
+		IndexedHeap(Traits traits = Traits()) : traits(traits) { }
+
+		bool empty() const { return heap.empty(); }
+		size_t size() const { return heap.size(); }
+		void clear() { heap.clear(); }
+		void reserve(size_t n) { heap.reserve(n); }
+
+		T top() const {
+			assert(!heap.empty());
+			return heap.front();
+		}
+
+		void push(T x) {
+			heap.push_back(x);
+			siftUp(heap.size() - 1);
+		}
+
+		T pop() {
+			assert(!heap.empty());
+			T r = heap.front();
+			T last = heap.back();
+			heap.pop_back();
+			if(!heap.empty()) {
+				place(last, 0);
+				siftDown(0);
+			}
+			return r;
+		}
+
+		/**
+		 * Call this after the key of $x (which must be in the heap) has
+		 * been lowered.
+		 */
+		void decrease(T x) {
+			size_t i = traits.getIndex(x);
+			assert(i < heap.size() && heap[i] == x);
+			siftUp(i);
+		}
+};
+
+} // namespace grail
+
+#endif // INDEXED_HEAP_H
+
@@ -1,7 +1,9 @@
 // vim: set noexpandtab:
 
+#include <cassert>
+#include <cstdlib>
 #include "line.h"
-#include "utils.h" // -> sgn
+#include "predicates.h"
 
 namespace grail {
 
@@ -17,35 +19,25 @@ bool Line::intersects(const Line& other, int flags) const {
 	if(other.a == b && other.b == a) { return false; }
 	*/
 	
-	VirtualPosition l = b - a;
-	int d1 = sgn(l.cross(other.a - a)) - sgn(l.cross(other.b - a));
+	// On which side of each line the end points of the other one are.
+	// Looking from the other end point of a line would just flip the signs.
+	int d1 = orientation(a, b, other.a) - orientation(a, b, other.b);
 	if(d1 == 0) return false;
 	
-	l = a - b;
-	int d2 = sgn(l.cross(other.a - b)) - sgn(l.cross(other.b - b));
-	if(d2 == 0) return false;
-	
-	l = other.b - other.a;
-	int d3 = sgn(l.cross(a - other.a)) - sgn(l.cross(b - other.a));
+	int d3 = orientation(other.a, other.b, a) - orientation(other.a, other.b, b);
 	if(d3 == 0) return false;
 	
-	l = other.a - other.b;
-	int d4 = sgn(l.cross(a - other.b)) - sgn(l.cross(b - other.b));
-	if(d4 == 0) return false;
-	
-	//printf("f=%d d1=%d d2=%d d3=%d d4=%d\n", flags, d1, d2, d3, d4);
+	//printf("f=%d d1=%d d3=%d\n", flags, d1, d3);
 	
 	// abs(d1) == 1  --> intersection is endpoint of $other
-	// abs(d2) == 1  --> intersection is endpoint of $other
 	// abs(d3) == 1  --> intersection is endpoint of this
-	// abs(d4) == 1  --> intersection is endpoint of this
 	// if == 2, inner
 	// abs(d?) == 0 ruled out before
 
-	bool d12ok = ((flags & OTHER_BOUNDARY) && ((abs(d1) == 1) && (abs(d2) == 1))) ||
-			((flags & OTHER_INNER) && ((abs(d1) == 2) && (abs(d2) == 2)));
-	bool d34ok = ((flags & THIS_BOUNDARY) && ((abs(d3) == 1) && (abs(d4) == 1))) ||
-			((flags & THIS_INNER) && ((abs(d3) == 2) && (abs(d4) == 2)));
+	bool d12ok = ((flags & OTHER_BOUNDARY) && (abs(d1) == 1)) ||
+			((flags & OTHER_INNER) && (abs(d1) == 2));
+	bool d34ok = ((flags & THIS_BOUNDARY) && (abs(d3) == 1)) ||
+			((flags & THIS_INNER) && (abs(d3) == 2));
 	
 	return d12ok && d34ok;
 }
@@ -53,23 +45,21 @@ bool Line::intersects(const Line& other, int flags) const {
 VirtualPosition Line::intersection(const Line& other) const {
 	// source: http://local.wasp.uwa.edu.au/~pbourke/geometry/lineline2d/
 	
-	double x1 = a.getX(), x2 = b.getX(), x3 = other.a.getX(), x4 = other.b.getX();
-	double y1 = a.getY(), y2 = b.getY(), y3 = other.a.getY(), y4 = other.b.getY();
-	
-	double numerator = (x4 - x3)*(y1 - y3) - (y4 - y3)*(x1 - x3);
-	double denominator = (y4 - y3)*(x2 - x1) - (x4 - x3)*(y2 - y1);
+	// Both are exact, so only the final division rounds
+	int64_t numerator = orient(other.a, other.b, a);
+	int64_t denominator =
+		((int64_t)b.getX() - a.getX()) * ((int64_t)other.b.getY() - other.a.getY()) -
+		((int64_t)b.getY() - a.getY()) * ((int64_t)other.b.getX() - other.a.getX());
 	
-	assert((denominator != 0.0) && "lines parallel!");
-	double ua = numerator / denominator;
+	assert((denominator != 0) && "lines parallel!");
+	double ua = (double)numerator / (double)denominator;
 	
+	double x1 = a.getX(), x2 = b.getX(), y1 = a.getY(), y2 = b.getY();
 	return VirtualPosition(x1 + ua*(x2 - x1), y1 + ua*(y2 - y1));
 }
 
 bool Line::hasPoint(VirtualPosition p) const {
-	if(p == a || p == b) { return true; }
-	//if(l.cross(p - a) != 0) { return false; }
-	if(!fequal((b - a) * (p - a), (b - a).length() * (p - a).length())) { return false; }
-	return (p - a).length() <= (b - a).length();
+	return onSegment(p, a, b);
 }
 
 #if VISUALIZE_LINES
@@ -0,0 +1,533 @@
+// vim: set noexpandtab:
+
+#include <map>
+#include <algorithm>
+#include <cmath>
+
+#include "navmesh.h"
+#include "edge_grid.h"
+#include "line.h"
+#include "predicates.h"
+#include "debug.h"
+
+namespace grail {
+
+const NavMesh::Index NavMesh::NO_INDEX = 0xffffffff;
+
+namespace {
+	typedef std::vector<VirtualPosition> Ring;
+
+	int64_t doubleArea(const Ring& ring) {
+		int64_t a = 0;
+		for(size_t i = 0; i < ring.size(); ++i) {
+			a += cross(ring[i], ring[(i + 1) % ring.size()]);
+		}
+		return a;
+	}
+
+	int64_t squaredDistance(VirtualPosition a, VirtualPosition b) {
+		int64_t dx = a.getX() - b.getX(), dy = a.getY() - b.getY();
+		return dx * dx + dy * dy;
+	}
+
+	/**
+	 * True iff direction $d from corner $b (coming from $a, going on to
+	 * $c, area on the left) points strictly into the area.
+	 */
+	bool pointsInside(VirtualPosition a, VirtualPosition b, VirtualPosition c, VirtualPosition d) {
+		VirtualPosition out = c - b, back = a - b;
+		if(cross(out, back) > 0) {
+			return cross(out, d) > 0 && cross(d, back) > 0;
+		}
+		return !(cross(back, d) >= 0 && cross(d, out) >= 0);
+	}
+
+	struct DistanceOrder {
+		const Ring& ring;
+		VirtualPosition p;
+		DistanceOrder(const Ring& ring, VirtualPosition p) : ring(ring), p(p) { }
+		bool operator()(size_t a, size_t b) const {
+			return squaredDistance(ring[a], p) < squaredDistance(ring[b], p);
+		}
+	};
+
+	struct RightmostOrder {
+		const std::vector<Ring>& rings;
+		RightmostOrder(const std::vector<Ring>& rings) : rings(rings) { }
+		int32_t maxX(const Ring& r) const {
+			int32_t x = r[0].getX();
+			for(size_t i = 1; i < r.size(); ++i) { x = std::max(x, r[i].getX()); }
+			return x;
+		}
+		bool operator()(size_t a, size_t b) const { return maxX(rings[a]) > maxX(rings[b]); }
+	};
+
+	/**
+	 * True iff no ring touches or crosses itself or another one (flat
+	 * corners are fine). Ear clipping would give overlapping triangles
+	 * otherwise. $walls holds the edges of all rings.
+	 */
+	bool simple(const Ring& outer, const std::vector<Ring>& holes, const EdgeGrid& walls) {
+		std::vector<std::pair<int32_t, int32_t> > corners;
+		for(size_t i = 0; i <= holes.size(); ++i) {
+			const Ring &r = (i == 0) ? outer : holes[i - 1];
+			for(size_t j = 0; j < r.size(); ++j) {
+				corners.push_back(std::make_pair(r[j].getX(), r[j].getY()));
+
+				// Edges that share an end point are caught below, everything
+				// else meets the inside of one of the edges
+				Line l(r[j], r[(j + 1) % r.size()]);
+				if(walls.intersects(l, Line::THIS_INNER | Line::OTHER_INNER | Line::OTHER_BOUNDARY) ||
+						walls.intersects(l, Line::THIS_BOUNDARY | Line::OTHER_INNER)) {
+					return false;
+				}
+			}
+		}
+		std::sort(corners.begin(), corners.end());
+		return std::adjacent_find(corners.begin(), corners.end()) == corners.end();
+	}
+
+	/**
+	 * Connect each hole to the outer boundary (or an already connected
+	 * hole) with a bridge, making one big (weakly simple) polygon.
+	 * $walls holds the edges of all rings.
+	 *
+	 * Holes are handled from right to left, each bridge starts at the
+	 * rightmost corner of the hole and goes to the nearest corner it can
+	 * see. The rightmost corner always sees something already connected.
+	 */
+	void bridgeHoles(Ring& outer, const std::vector<Ring>& holes, const EdgeGrid& walls) {
+		const int flags = Line::THIS_INNER | Line::OTHER_INNER | Line::OTHER_BOUNDARY;
+
+		std::vector<size_t> order;
+		for(size_t i = 0; i < holes.size(); ++i) { order.push_back(i); }
+		std::sort(order.begin(), order.end(), RightmostOrder(holes));
+
+		std::vector<Line> bridges;
+		for(std::vector<size_t>::const_iterator h = order.begin(); h != order.end(); ++h) {
+			const Ring &hole = holes[*h];
+			size_t m = 0;
+			for(size_t i = 1; i < hole.size(); ++i) {
+				if(hole[i].getX() > hole[m].getX()) { m = i; }
+			}
+			VirtualPosition M = hole[m];
+			VirtualPosition mPrev = hole[(m + hole.size() - 1) % hole.size()], mNext = hole[(m + 1) % hole.size()];
+
+			std::vector<size_t> candidates;
+			for(size_t i = 0; i < outer.size(); ++i) { candidates.push_back(i); }
+			std::sort(candidates.begin(), candidates.end(), DistanceOrder(outer, M));
+
+			bool bridged = false;
+			for(std::vector<size_t>::const_iterator k = candidates.begin(); !bridged && k != candidates.end(); ++k) {
+				VirtualPosition V = outer[*k];
+				if(V == M) { continue; }
+				VirtualPosition vPrev = outer[(*k + outer.size() - 1) % outer.size()], vNext = outer[(*k + 1) % outer.size()];
+				if(!pointsInside(mPrev, M, mNext, V - M) || !pointsInside(vPrev, V, vNext, M - V)) { continue; }
+
+				Line l(M, V);
+				if(walls.intersects(l, flags)) { continue; }
+				bool crossesBridge = false;
+				for(size_t i = 0; !crossesBridge && i < bridges.size(); ++i) {
+					crossesBridge = l.intersects(bridges[i], flags);
+				}
+				if(crossesBridge) { continue; }
+
+				// ... V, M, <rest of the hole>, M, V, ...
+				Ring insert;
+				for(size_t i = 0; i <= hole.size(); ++i) {
+					insert.push_back(hole[(m + i) % hole.size()]);
+				}
+				insert.push_back(V);
+				outer.insert(outer.begin() + *k + 1, insert.begin(), insert.end());
+				bridges.push_back(l);
+				bridged = true;
+			}
+
+			if(!bridged) {
+				cdbg << "NavMesh: could not connect hole at " << M << ", ignoring it\n";
+			}
+		}
+	}
+
+	/**
+	 * Buckets the corners of a polygon by position so ear tests only need
+	 * to look at the corners near the ear.
+	 */
+	class CornerGrid {
+			VirtualPosition origin;
+			double cellSize;
+			int32_t columns, rows;
+			std::vector< std::vector<size_t> > cells;
+
+			int32_t column(int32_t x) const { return std::min<int32_t>(columns - 1, std::max<int32_t>(0, (int32_t)((x - origin.getX()) / cellSize))); }
+			int32_t row(int32_t y) const { return std::min<int32_t>(rows - 1, std::max<int32_t>(0, (int32_t)((y - origin.getY()) / cellSize))); }
+
+		public:
+			CornerGrid(const Ring& ring) {
+				VirtualPosition lo = ring[0], hi = ring[0];
+				for(size_t i = 1; i < ring.size(); ++i) {
+					lo = VirtualPosition(std::min(lo.getX(), ring[i].getX()), std::min(lo.getY(), ring[i].getY()));
+					hi = VirtualPosition(std::max(hi.getX(), ring[i].getX()), std::max(hi.getY(), ring[i].getY()));
+				}
+				double w = hi.getX() - lo.getX() + 1.0, h = hi.getY() - lo.getY() + 1.0;
+				origin = lo;
+				cellSize = std::max(1.0, sqrt(w * h / ring.size()));
+				columns = (int32_t)(w / cellSize) + 1;
+				rows = (int32_t)(h / cellSize) + 1;
+				cells.resize(columns * rows);
+				for(size_t i = 0; i < ring.size(); ++i) {
+					cells[row(ring[i].getY()) * columns + column(ring[i].getX())].push_back(i);
+				}
+			}
+
+			/// Call visitor(i) for (at least) all corners in the rectangle
+			template<typename Visitor>
+			bool visit(VirtualPosition lo, VirtualPosition hi, Visitor& visitor) const {
+				for(int32_t r = row(lo.getY()); r <= row(hi.getY()); ++r) {
+					for(int32_t c = column(lo.getX()); c <= column(hi.getX()); ++c) {
+						const std::vector<size_t> &cell = cells[r * columns + c];
+						for(std::vector<size_t>::const_iterator iter = cell.begin(); iter != cell.end(); ++iter) {
+							if(visitor(*iter)) { return true; }
+						}
+					}
+				}
+				return false;
+			}
+	};
+
+	/**
+	 * Finds corners of the remaining polygon inside of a candidate ear.
+	 */
+	struct EarBlocker {
+		const Ring& ring;
+		const std::vector<size_t>& prev;
+		const std::vector<size_t>& next;
+		const std::vector<bool>& removed;
+		VirtualPosition a, b, c;
+
+		EarBlocker(const Ring& ring, const std::vector<size_t>& prev, const std::vector<size_t>& next,
+				const std::vector<bool>& removed, VirtualPosition a, VirtualPosition b, VirtualPosition c) :
+			ring(ring), prev(prev), next(next), removed(removed), a(a), b(b), c(c) { }
+
+		bool operator()(size_t i) const {
+			VirtualPosition p = ring[i];
+			if(removed[i] || p == a || p == b || p == c) { return false; }
+			// Only corners that are not convex can block an ear
+			if(orient(ring[prev[i]], p, ring[next[i]]) > 0) { return false; }
+			return orient(a, b, p) >= 0 && orient(b, c, p) >= 0 && orient(c, a, p) >= 0;
+		}
+	};
+
+	VirtualPosition nearestOnSegment(VirtualPosition a, VirtualPosition b, VirtualPosition p) {
+		VirtualPosition d = b - a;
+		double len2 = (double)d.getX() * d.getX() + (double)d.getY() * d.getY();
+		if(len2 == 0) { return a; }
+		double t = ((double)(p.getX() - a.getX()) * d.getX() + (double)(p.getY() - a.getY()) * d.getY()) / len2;
+		t = std::max(0.0, std::min(1.0, t));
+		return VirtualPosition((int32_t)floor(a.getX() + t * d.getX() + 0.5), (int32_t)floor(a.getY() + t * d.getY() + 0.5));
+	}
+
+	bool contains(const NavMesh::Triangle& t, VirtualPosition p) {
+		return orient(t.corners[0], t.corners[1], p) >= 0 &&
+			orient(t.corners[1], t.corners[2], p) >= 0 &&
+			orient(t.corners[2], t.corners[0], p) >= 0;
+	}
+} // namespace
+
+bool NavMesh::build(const polygon_t& outerPolygon, const std::vector<const polygon_t*>& holePolygons) {
+	triangles.clear();
+
+	// Outer boundary counter clockwise, holes clockwise, so the walkable
+	// area is always on the left
+	Ring ring(outerPolygon.beginNodes(), outerPolygon.endNodes());
+	if(ring.size() < 3) { return false; }
+	if(doubleArea(ring) < 0) { std::reverse(ring.begin(), ring.end()); }
+
+	std::vector<Ring> holes;
+	for(std::vector<const polygon_t*>::const_iterator iter = holePolygons.begin(); iter != holePolygons.end(); ++iter) {
+		Ring h((*iter)->beginNodes(), (*iter)->endNodes());
+		if(h.size() < 3) { continue; }
+		if(doubleArea(h) > 0) { std::reverse(h.begin(), h.end()); }
+		holes.push_back(h);
+	}
+
+	EdgeGrid walls;
+	for(size_t i = 0; i <= holes.size(); ++i) {
+		const Ring &r = (i == 0) ? ring : holes[i - 1];
+		for(size_t j = 0; j < r.size(); ++j) {
+			walls.addEdge(Line(r[j], r[(j + 1) % r.size()]));
+		}
+	}
+	walls.build();
+
+	if(!simple(ring, holes, walls)) {
+		cdbg << "NavMesh: polygons touch or cross, not building a mesh\n";
+		return false;
+	}
+	bridgeHoles(ring, holes, walls);
+
+	// Ear clipping
+	size_t n = ring.size();
+	std::vector<size_t> prev(n), next(n);
+	std::vector<bool> removed(n, false);
+	for(size_t i = 0; i < n; ++i) {
+		prev[i] = (i + n - 1) % n;
+		next[i] = (i + 1) % n;
+	}
+	CornerGrid grid(ring);
+
+	size_t remaining = n, i = 0, misses = 0;
+	while(remaining >= 3) {
+		VirtualPosition a = ring[prev[i]], b = ring[i], c = ring[next[i]];
+		bool ear = (remaining == 3);
+		if(!ear && orient(a, b, c) > 0) {
+			VirtualPosition lo(std::min(a.getX(), std::min(b.getX(), c.getX())), std::min(a.getY(), std::min(b.getY(), c.getY())));
+			VirtualPosition hi(std::max(a.getX(), std::max(b.getX(), c.getX())), std::max(a.getY(), std::max(b.getY(), c.getY())));
+			EarBlocker blocker(ring, prev, next, removed, a, b, c);
+			ear = !grid.visit(lo, hi, blocker);
+		}
+		if(!ear && misses > remaining && orient(a, b, c) == 0) {
+			// Nothing but flat corners left here, clip a (degenerate)
+			// triangle anyway to keep neighbourhood intact
+			ear = true;
+		}
+		if(!ear && misses > 2 * remaining) {
+			// Clipping anything now would give overlapping triangles
+			cdbg << "NavMesh: no ear found, polygon probably not simple\n";
+			triangles.clear();
+			return false;
+		}
+
+		if(!ear) {
+			i = next[i];
+			misses++;
+			continue;
+		}
+
+		Triangle t;
+		t.corners[0] = a;
+		t.corners[1] = b;
+		t.corners[2] = c;
+		triangles.push_back(t);
+
+		removed[i] = true;
+		next[prev[i]] = next[i];
+		prev[next[i]] = prev[i];
+		i = prev[i];
+		remaining--;
+		misses = 0;
+	}
+
+	link();
+	return true;
+}
+
+void NavMesh::link() {
+	typedef std::pair<int64_t, int64_t> EdgeKey;
+	std::map<EdgeKey, std::pair<Index, int> > edges;
+
+	for(Index t = 0; t < triangles.size(); ++t) {
+		for(int k = 0; k < 3; ++k) {
+			VirtualPosition a = triangles[t].corners[k], b = triangles[t].corners[(k + 1) % 3];
+			triangles[t].neighbours[k] = NO_INDEX;
+			edges.insert(std::make_pair(EdgeKey(((int64_t)a.getX() << 32) | (uint32_t)a.getY(), ((int64_t)b.getX() << 32) | (uint32_t)b.getY()),
+						std::make_pair(t, k)));
+		}
+	}
+
+	// A portal is an edge the neighbour has in reverse direction
+	for(Index t = 0; t < triangles.size(); ++t) {
+		for(int k = 0; k < 3; ++k) {
+			VirtualPosition a = triangles[t].corners[k], b = triangles[t].corners[(k + 1) % 3];
+			std::map<EdgeKey, std::pair<Index, int> >::const_iterator iter =
+				edges.find(EdgeKey(((int64_t)b.getX() << 32) | (uint32_t)b.getY(), ((int64_t)a.getX() << 32) | (uint32_t)a.getY()));
+			if(iter != edges.end() && iter->second.first != t) {
+				triangles[t].neighbours[k] = iter->second.first;
+			}
+		}
+	}
+}
+
+NavMesh::Index NavMesh::locate(VirtualPosition p) const {
+	for(Index t = 0; t < triangles.size(); ++t) {
+		if(contains(triangles[t], p)) { return t; }
+	}
+	return NO_INDEX;
+}
+
+NavMesh::Index NavMesh::locateNearest(VirtualPosition p, VirtualPosition& nearest) const {
+	Index best = locate(p);
+	if(best != NO_INDEX) {
+		nearest = p;
+		return best;
+	}
+
+	int64_t bestDistance = 0;
+	for(Index t = 0; t < triangles.size(); ++t) {
+		for(int k = 0; k < 3; ++k) {
+			VirtualPosition q = nearestOnSegment(triangles[t].corners[k], triangles[t].corners[(k + 1) % 3], p);
+			int64_t d = squaredDistance(p, q);
+			if(best == NO_INDEX || d < bestDistance) {
+				best = t;
+				bestDistance = d;
+				nearest = q;
+			}
+		}
+	}
+	return best;
+}
+
+bool NavMeshSearch::findCorridor(const NavMesh& mesh, Index source, VirtualPosition sourcePosition,
+		Index target, VirtualPosition targetPosition, std::vector<Index>& corridor) {
+
+	if(nodes.size() < mesh.size()) {
+		nodes.resize(mesh.size());
+	}
+
+	uint32_t id = ++searchCounter;
+	if(id == 0) {
+		nodes.assign(nodes.size(), NodeState());
+		id = searchCounter = 1;
+	}
+
+	Heap border = Heap(HeapTraits(&nodes));
+
+	NodeState &s = nodes[source];
+	s.searchId = id;
+	s.closed = false;
+	s.parent = NavMesh::NO_INDEX;
+	s.entry = sourcePosition;
+	s.costSum = 0;
+	s.estimate = (targetPosition - sourcePosition).length();
+	border.push(source);
+
+	bool found = false;
+	while(!border.empty()) {
+		Index current = border.pop();
+		NodeState &c = nodes[current];
+		c.closed = true;
+		expanded++;
+
+		if(current == target) {
+			found = true;
+			break;
+		}
+
+		const NavMesh::Triangle &t = mesh.getTriangle(current);
+		for(int k = 0; k < 3; ++k) {
+			Index to = t.neighbours[k];
+			if(to == NavMesh::NO_INDEX) { continue; }
+
+			// Move to the middle of the portal, or straight to the target
+			// when entering its triangle
+			VirtualPosition entry = (to == target) ? targetPosition :
+				VirtualPosition((t.corners[k].getX() + t.corners[(k + 1) % 3].getX()) / 2,
+						(t.corners[k].getY() + t.corners[(k + 1) % 3].getY()) / 2);
+			double cost = c.costSum + (entry - c.entry).length();
+
+			NodeState &n = nodes[to];
+			if(n.searchId != id) {
+				n.searchId = id;
+				n.closed = false;
+				n.parent = current;
+				n.entry = entry;
+				n.costSum = cost;
+				n.estimate = cost + (targetPosition - entry).length();
+				border.push(to);
+			}
+			else if(!n.closed && cost < n.costSum) {
+				n.parent = current;
+				n.entry = entry;
+				n.costSum = cost;
+				n.estimate = cost + (targetPosition - entry).length();
+				border.decrease(to);
+			}
+		}
+	}
+
+	if(!found) { return false; }
+
+	for(Index t = target; t != NavMesh::NO_INDEX; t = nodes[t].parent) {
+		corridor.push_back(t);
+	}
+	std::reverse(corridor.begin(), corridor.end());
+	return true;
+}
+
+bool NavMeshSearch::findPath(const NavMesh& mesh, VirtualPosition source, VirtualPosition target, Path& path) {
+	expanded = 0;
+	VirtualPosition start, end;
+	Index s = mesh.locateNearest(source, start);
+	Index t = mesh.locateNearest(target, end);
+	if(s == NavMesh::NO_INDEX || t == NavMesh::NO_INDEX) {
+		cdbg << "NavMeshSearch: empty mesh\n";
+		return false;
+	}
+
+	std::vector<Index> corridor;
+	if(!findCorridor(mesh, s, start, t, end, corridor)) {
+		cdbg << "NavMeshSearch: did not find path :(\n";
+		return false;
+	}
+
+	// Portals between the corridor triangles, as (left, right) pairs seen
+	// in walking direction
+	std::vector<VirtualPosition> lefts, rights;
+	lefts.push_back(start);
+	rights.push_back(start);
+	for(size_t i = 0; i + 1 < corridor.size(); ++i) {
+		const NavMesh::Triangle &tri = mesh.getTriangle(corridor[i]);
+		for(int k = 0; k < 3; ++k) {
+			if(tri.neighbours[k] == corridor[i + 1]) {
+				rights.push_back(tri.corners[k]);
+				lefts.push_back(tri.corners[(k + 1) % 3]);
+				break;
+			}
+		}
+	}
+	lefts.push_back(end);
+	rights.push_back(end);
+
+	if(start != source) { path.push_back(start); }
+
+	// Funnel algorithm: Keep the apex and the left and right border of the
+	// area visible from it, narrow it portal by portal. When one border
+	// crosses the other, the path bends around that corner.
+	VirtualPosition apex = start, left = start, right = start;
+	size_t apexIndex = 0, leftIndex = 0, rightIndex = 0;
+	for(size_t i = 1; i < lefts.size(); ++i) {
+		if(orient(apex, right, rights[i]) >= 0) {
+			if(apex == right || orient(apex, left, rights[i]) < 0) {
+				right = rights[i];
+				rightIndex = i;
+			}
+			else {
+				if(path.empty() || path.back() != left) { path.push_back(left); }
+				apex = right = left;
+				apexIndex = rightIndex = leftIndex;
+				i = apexIndex;
+				continue;
+			}
+		}
+
+		if(orient(apex, left, lefts[i]) <= 0) {
+			if(apex == left || orient(apex, right, lefts[i]) > 0) {
+				left = lefts[i];
+				leftIndex = i;
+			}
+			else {
+				if(path.empty() || path.back() != right) { path.push_back(right); }
+				apex = left = right;
+				apexIndex = leftIndex = rightIndex;
+				i = apexIndex;
+				continue;
+			}
+		}
+	}
+
+	if(path.empty() || path.back() != end) { path.push_back(end); }
+	return true;
+}
+
+} // namespace grail
+
@@ -0,0 +1,144 @@
+// vim: set noexpandtab:
+
+#ifndef NAVMESH_H
+#define NAVMESH_H
+
+#include <vector>
+#include <stdint.h>
+
+#include "vector2d.h"
+#include "polygon.h"
+#include "actor.h" // ->Path
+#include "indexed_heap.h"
+
+namespace grail {
+
+/**
+ * Triangulation of a walkable area (one polygon minus any number of
+ * holes), with each triangle knowing its neighbours.
+ *
+ * The triangulation is constrained to the polygon edges, i.e. every edge
+ * of the outer boundary and of the holes is an edge of exactly one
+ * triangle (a wall), all other triangle edges are shared by two triangles
+ * (a portal). Holes are first bridged into the outer boundary, the result
+ * is then split up by ear clipping.
+ *
+ * Memory and search cost are linear in the number of corners.
+ */
+class NavMesh {
+	public:
+		typedef uint32_t Index;
+		typedef Polygon<VirtualPosition, IsPosition> polygon_t;
+
+		static const Index NO_INDEX;
+
+		/**
+		 * Corners in counter clockwise order (with positive y pointing
+		 * up), neighbours[i] is the triangle on the other side of the
+		 * edge from corners[i] to corners[(i + 1) % 3], or NO_INDEX if
+		 * that is a wall.
+		 */
+		struct Triangle {
+			VirtualPosition corners[3];
+			Index neighbours[3];
+		};
+
+	private:
+		std::vector<Triangle> triangles;
+
+		void link();
+
+	public:
+		NavMesh() { }
+
+		/**
+		 * (Re-)build the mesh for the area inside $outer but outside of all
+		 * $holes.
+		 *
+		 * @pre the holes lie inside $outer and no two polygons intersect
+		 * @return false (and an empty mesh) if the polygons can't be
+		 * 	triangulated, e.g. because one of them touches itself
+		 */
+		bool build(const polygon_t& outer, const std::vector<const polygon_t*>& holes);
+
+		void clear() { triangles.clear(); }
+
+		size_t size() const { return triangles.size(); }
+		const Triangle& getTriangle(Index i) const { return triangles[i]; }
+
+		/**
+		 * Return the triangle containing $p (borders included) or NO_INDEX.
+		 */
+		Index locate(VirtualPosition p) const;
+
+		/**
+		 * Return the triangle nearest to $p and store the point of it
+		 * nearest to $p in $nearest, NO_INDEX if the mesh is empty.
+		 */
+		Index locateNearest(VirtualPosition p, VirtualPosition& nearest) const;
+};
+
+/**
+ * Scratch space for path searches on a NavMesh, keep one around per thread
+ * (like WaypointSearch).
+ *
+ * A search first finds a corridor of triangles from source to target with
+ * A* (moving between the midpoints of the portals) and then pulls the path
+ * tight inside that corridor (funnel algorithm).
+ */
+class NavMeshSearch {
+		typedef NavMesh::Index Index;
+
+		struct NodeState {
+			double costSum;
+			double estimate;
+			VirtualPosition entry;
+			Index parent;
+			Index heapIndex;
+			uint32_t searchId;
+			bool closed;
+
+			NodeState() : costSum(0), estimate(0), parent(NavMesh::NO_INDEX),
+				heapIndex(0), searchId(0), closed(false) { }
+		};
+
+		struct HeapTraits {
+			std::vector<NodeState>* nodes;
+			HeapTraits(std::vector<NodeState>* nodes) : nodes(nodes) { }
+			bool less(Index a, Index b) const { return (*nodes)[a].estimate < (*nodes)[b].estimate; }
+			void setIndex(Index x, size_t i) const { (*nodes)[x].heapIndex = i; }
+			size_t getIndex(Index x) const { return (*nodes)[x].heapIndex; }
+		};
+
+		typedef IndexedHeap<Index, HeapTraits> Heap;
+
+		std::vector<NodeState> nodes;
+		uint32_t searchCounter;
+		size_t expanded;
+
+		bool findCorridor(const NavMesh& mesh, Index source, VirtualPosition sourcePosition,
+				Index target, VirtualPosition targetPosition, std::vector<Index>& corridor);
+
+	public:
+		NavMeshSearch() : searchCounter(0), expanded(0) { }
+
+		/**
+		 * Search a short path from $source to $target.
+		 * Points outside of the mesh are moved to the nearest point of it
+		 * first.
+		 *
+		 * @param path the path (excluding $source, including $target or
+		 * 	the point of the mesh nearest to it) is appended here if one
+		 * 	was found
+		 * @return true iff a path was found
+		 */
+		bool findPath(const NavMesh& mesh, VirtualPosition source, VirtualPosition target, Path& path);
+
+		/// Number of triangles taken from the heap by the last search
+		size_t getExpanded() const { return expanded; }
+};
+
+} // namespace grail
+
+#endif // NAVMESH_H
+
@@ -0,0 +1,95 @@
+// vim: set noexpandtab:
+
+#include "path_cache.h"
+
+namespace grail {
+
+bool PathCache::Key::operator<(const Key& other) const {
+	if(area != other.area) { return area < other.area; }
+	if(sourceX != other.sourceX) { return sourceX < other.sourceX; }
+	if(sourceY != other.sourceY) { return sourceY < other.sourceY; }
+	if(targetX != other.targetX) { return targetX < other.targetX; }
+	return targetY < other.targetY;
+}
+
+PathCache::PathCache(size_t capacity, int32_t quantum) :
+	capacity(capacity), quantum(quantum > 0 ? quantum : 1), version(0), hits(0), misses(0) {
+}
+
+int32_t PathCache::quantize(int32_t v) const {
+	// Round towards negative infinity so 0 isn't twice as large as the
+	// other cells
+	return (v >= 0) ? (v / quantum) : -((-v + quantum - 1) / quantum);
+}
+
+PathCache::Key PathCache::makeKey(const void* area, VirtualPosition source, VirtualPosition target) const {
+	Key k;
+	k.area = area;
+	k.sourceX = quantize(source.getX());
+	k.sourceY = quantize(source.getY());
+	k.targetX = quantize(target.getX());
+	k.targetY = quantize(target.getY());
+	return k;
+}
+
+void PathCache::setCapacity(size_t capacity) {
+	this->capacity = capacity;
+	while(entries.size() > capacity) {
+		index.erase(entries.back().key);
+		entries.pop_back();
+	}
+}
+
+void PathCache::setQuantum(int32_t quantum) {
+	this->quantum = (quantum > 0) ? quantum : 1;
+	clear();
+}
+
+void PathCache::sync(uint32_t version) {
+	if(version != this->version) {
+		clear();
+		this->version = version;
+	}
+}
+
+const PathCache::Entry* PathCache::lookup(const void* area, VirtualPosition source, VirtualPosition target) {
+	std::map<Key, EntryList::iterator>::iterator iter = index.find(makeKey(area, source, target));
+	if(iter == index.end()) {
+		misses++;
+		return 0;
+	}
+	hits++;
+	entries.splice(entries.begin(), entries, iter->second);
+	return &(*(iter->second));
+}
+
+void PathCache::store(const void* area, VirtualPosition source, VirtualPosition target, const Path& path) {
+	if(capacity == 0) { return; }
+
+	Key k = makeKey(area, source, target);
+	std::map<Key, EntryList::iterator>::iterator iter = index.find(k);
+	if(iter != index.end()) {
+		entries.erase(iter->second);
+		index.erase(iter);
+	}
+	else if(entries.size() >= capacity) {
+		index.erase(entries.back().key);
+		entries.pop_back();
+	}
+
+	Entry e;
+	e.key = k;
+	e.source = source;
+	e.target = target;
+	e.path = path;
+	entries.push_front(e);
+	index[k] = entries.begin();
+}
+
+void PathCache::clear() {
+	entries.clear();
+	index.clear();
+}
+
+} // namespace grail
+
@@ -0,0 +1,94 @@
+// vim: set noexpandtab:
+
+#ifndef PATH_CACHE_H
+#define PATH_CACHE_H
+
+#include <list>
+#include <map>
+#include <stdint.h>
+
+#include "vector2d.h"
+#include "actor.h" // ->Path
+
+namespace grail {
+
+/**
+ * Remembers the most recently found paths.
+ *
+ * Paths are looked up by the area they were searched in (e.g. a ground
+ * component) and by source and target, rounded to a grid of $quantum
+ * units, so queries from about the same place to about the same place
+ * share an entry. The caller is responsible for checking whether a path
+ * found for slightly different end points is still good.
+ *
+ * All entries are tagged with a version number of the searched ground and
+ * are dropped as soon as it changes (see sync()).
+ * When full, the least recently used entry is thrown away.
+ */
+class PathCache {
+	public:
+		struct Key {
+			const void* area;
+			int32_t sourceX, sourceY, targetX, targetY;
+			bool operator<(const Key& other) const;
+		};
+
+		struct Entry {
+			Key key;
+			/// the exact query this path was found for
+			VirtualPosition source, target;
+			Path path;
+		};
+
+	private:
+		typedef std::list<Entry> EntryList;
+
+		/// most recently used first
+		EntryList entries;
+		std::map<Key, EntryList::iterator> index;
+		size_t capacity;
+		int32_t quantum;
+		uint32_t version;
+		size_t hits, misses;
+
+		int32_t quantize(int32_t v) const;
+		Key makeKey(const void* area, VirtualPosition source, VirtualPosition target) const;
+
+	public:
+		PathCache(size_t capacity = 64, int32_t quantum = 8);
+
+		/**
+		 * Set the number of paths to keep, 0 disables caching.
+		 */
+		void setCapacity(size_t capacity);
+		size_t getCapacity() const { return capacity; }
+
+		void setQuantum(int32_t quantum);
+		int32_t getQuantum() const { return quantum; }
+
+		/**
+		 * Drop all entries unless they were stored for ground version
+		 * $version.
+		 */
+		void sync(uint32_t version);
+
+		/**
+		 * Return the entry for the given query or 0.
+		 * The pointer stays valid until the next call to store() or clear().
+		 */
+		const Entry* lookup(const void* area, VirtualPosition source, VirtualPosition target);
+
+		void store(const void* area, VirtualPosition source, VirtualPosition target, const Path& path);
+
+		void clear();
+		size_t size() const { return entries.size(); }
+
+		/// Statistics, for tuning
+		size_t getHits() const { return hits; }
+		size_t getMisses() const { return misses; }
+};
+
+} // namespace grail
+
+#endif // PATH_CACHE_H
+
@@ -0,0 +1,168 @@
+
+#include "path_service.h"
+
+#include "ground.h"
+#include "worker_pool.h"
+#include "debug.h"
+
+namespace grail {
+
+	PathService::PathService(Ground& ground, unsigned threads) :
+		Task(ENDLESS), ground(ground), quit(false), nextTicket(0),
+		mutex(SDL_CreateMutex()), wakeup(SDL_CreateCond()) {
+
+		if(threads == 0) {
+			threads = WorkerPool::hardwareThreads();
+		}
+		for(unsigned i = 0; i < threads; ++i) {
+			SDL_Thread *t = SDL_CreateThread(workerMain, this);
+			if(!t) {
+				cdbg << "PathService: could not start thread " << i << "\n";
+				break;
+			}
+			workers.push_back(t);
+		}
+	}
+
+	PathService::~PathService() {
+		SDL_mutexP(mutex);
+		quit = true;
+		SDL_CondBroadcast(wakeup);
+		SDL_mutexV(mutex);
+
+		for(std::vector<SDL_Thread*>::iterator iter = workers.begin(); iter != workers.end(); ++iter) {
+			SDL_WaitThread(*iter, 0);
+		}
+		SDL_DestroyCond(wakeup);
+		SDL_DestroyMutex(mutex);
+	}
+
+	int PathService::workerMain(void* service) {
+		static_cast<PathService*>(service)->work(true);
+		return 0;
+	}
+
+	void PathService::work(bool wait) {
+		Ground::SearchSpace space;
+
+		SDL_mutexP(mutex);
+		while(true) {
+			while(wait && !quit && requests.empty()) {
+				SDL_CondWait(wakeup, mutex);
+			}
+			if(quit || requests.empty()) { break; }
+
+			Request r = requests.front();
+			requests.pop_front();
+
+			Result result;
+			result.actor = r.actor;
+			result.target = r.target;
+			result.ticket = r.ticket;
+			result.version = r.snapshot->getVersion();
+			result.searched = false;
+
+			// Don't bother if a newer request for the actor came in, but
+			// still report back so the main thread lets go of the request
+			std::map<const Actor*, uint32_t>::const_iterator iter = tickets.find(r.actor);
+			if(iter == tickets.end() || iter->second != r.ticket) {
+				results.push_back(result);
+				continue;
+			}
+			SDL_mutexV(mutex);
+
+			r.snapshot->findPath(r.source, r.target, space, result.path);
+			result.searched = true;
+
+			SDL_mutexP(mutex);
+			results.push_back(result);
+		}
+		SDL_mutexV(mutex);
+	}
+
+	void PathService::updateSnapshot() {
+		if(snapshot && snapshot->getVersion() == ground.getVersion()) {
+			return;
+		}
+
+		// Generate everything on the real ground, so it is done only once
+		// and the copy has it as well
+		ground.prepareConcurrentQueries();
+		snapshot = GroundPtr(new Ground(ground));
+		snapshot->prepareConcurrentQueries();
+	}
+
+	void PathService::request(Actor::Ptr actor, VirtualPosition target) {
+		updateSnapshot();
+
+		Request r;
+		r.actor = actor.get();
+		r.source = actor->getPosition();
+		r.target = target;
+		r.ticket = ++nextTicket;
+		r.snapshot = snapshot.get();
+
+		Owner& owner = owners[r.ticket];
+		owner.actor = actor;
+		owner.snapshot = snapshot;
+
+		SDL_mutexP(mutex);
+		tickets[r.actor] = r.ticket;
+		requests.push_back(r);
+		SDL_CondSignal(wakeup);
+		SDL_mutexV(mutex);
+	}
+
+	void PathService::cancel(Actor::Ptr actor) {
+		SDL_mutexP(mutex);
+		tickets.erase(actor.get());
+		SDL_mutexV(mutex);
+	}
+
+	size_t PathService::getPending() {
+		SDL_mutexP(mutex);
+		size_t r = tickets.size();
+		SDL_mutexV(mutex);
+		return r;
+	}
+
+	void PathService::eachFrame(uint32_t ticks) {
+		if(workers.empty()) {
+			// No threads, search here
+			work(false);
+		}
+
+		std::deque<Result> done;
+		SDL_mutexP(mutex);
+		done.swap(results);
+		SDL_mutexV(mutex);
+
+		for(std::deque<Result>::iterator iter = done.begin(); iter != done.end(); ++iter) {
+			// Take the references back, the request is over either way
+			std::map<uint32_t, Owner>::iterator owner = owners.find(iter->ticket);
+			Actor::Ptr actor = owner->second.actor;
+			owners.erase(owner);
+
+			SDL_mutexP(mutex);
+			std::map<const Actor*, uint32_t>::iterator ticket = tickets.find(iter->actor);
+			bool current = iter->searched && (ticket != tickets.end() && ticket->second == iter->ticket);
+			if(current) {
+				tickets.erase(ticket);
+			}
+			SDL_mutexV(mutex);
+
+			if(!current) { continue; }
+
+			if(iter->version != ground.getVersion()) {
+				// The ground changed in the meantime, the path might be
+				// blocked now
+				request(actor, iter->target);
+			}
+			else {
+				actor->walk(iter->path);
+			}
+		}
+	}
+
+}
+
@@ -0,0 +1,119 @@
+// vim: set noexpandtab ts=4 sw=4:
+
+#ifndef PATH_SERVICE_H
+#define PATH_SERVICE_H
+
+#include <deque>
+#include <map>
+#include <vector>
+#include <stdint.h>
+#include <boost/shared_ptr.hpp>
+#include <SDL.h>
+#include <SDL_thread.h>
+
+#include "task.h"
+#include "actor.h"
+#include "vector2d.h"
+
+namespace grail {
+
+	/**
+	 * Finds paths for actors on background threads, so the frame that
+	 * asks for one doesn't have to wait for the search.
+	 *
+	 * Searches run on a snapshot (a copy) of the ground that is taken
+	 * whenever the ground changed (see Ground::getVersion()) and never
+	 * modified, so the workers don't need to lock anything while
+	 * searching. Finished paths are handed to their actors from
+	 * eachFrame(), i.e. on the main thread, so add the service to the main
+	 * loop with start().
+	 *
+	 * A new request for an actor replaces any older one that isn't done
+	 * yet. Paths found on a snapshot that is outdated by the time they
+	 * are delivered are searched again.
+	 */
+	class PathService : public Task {
+		public:
+			typedef boost::shared_ptr<PathService> Ptr;
+
+		private:
+			typedef boost::shared_ptr<Ground> GroundPtr;
+
+			/**
+			 * What the workers get to see of a request: no owning
+			 * pointers, so nothing can be destroyed on a worker thread.
+			 * The references are kept in $owners by the main thread.
+			 */
+			struct Request {
+				const Actor* actor;
+				VirtualPosition source, target;
+				uint32_t ticket;
+				Ground* snapshot;
+			};
+
+			struct Result {
+				const Actor* actor;
+				VirtualPosition target;
+				uint32_t ticket;
+				uint32_t version;
+				bool searched; ///< false if the request was dropped as stale
+				Path path;
+			};
+
+			/// Keeps actor and snapshot of a request alive until its result is back
+			struct Owner {
+				Actor::Ptr actor;
+				GroundPtr snapshot;
+			};
+
+			Ground &ground;
+			GroundPtr snapshot;
+			/// Per ticket, only touched by the main thread
+			std::map<uint32_t, Owner> owners;
+
+			// shared with the workers, guarded by mutex
+			std::deque<Request> requests;
+			std::deque<Result> results;
+			/// latest ticket per actor that is still waiting
+			std::map<const Actor*, uint32_t> tickets;
+			bool quit;
+
+			uint32_t nextTicket;
+			SDL_mutex *mutex;
+			SDL_cond *wakeup;
+			std::vector<SDL_Thread*> workers;
+
+			static int workerMain(void* service);
+			/// Process requests, wait for new ones if $wait is true
+			void work(bool wait);
+			void updateSnapshot();
+
+		public:
+			/**
+			 * \param threads Number of worker threads, 0 means one per CPU
+			 * 	core.
+			 */
+			PathService(Ground& ground, unsigned threads = 1);
+			~PathService();
+
+			/**
+			 * Search a path from where $actor is now to $target and let the
+			 * actor walk it once it is found.
+			 */
+			void request(Actor::Ptr actor, VirtualPosition target);
+
+			/**
+			 * Forget about the pending request of $actor, if any.
+			 */
+			void cancel(Actor::Ptr actor);
+
+			/// Number of actors still waiting for their path
+			size_t getPending();
+
+			void eachFrame(uint32_t ticks);
+	};
+
+}
+
+#endif // PATH_SERVICE_H
+
@@ -0,0 +1,356 @@
+// vim: set noexpandtab:
+
+#include <fstream>
+#include <limits>
+#include <cstring>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "path_table.h"
+#include "indexed_heap.h"
+#include "worker_pool.h"
+#include "debug.h"
+
+namespace grail {
+
+namespace {
+	/*
+	 * File layout (native byte order, everything 4 byte aligned):
+	 *
+	 * FileHeader
+	 * for each table:
+	 * 	TableHeader
+	 * 	count * count next hops (uint32)
+	 * 	count * count distances (float)
+	 */
+	const char MAGIC[4] = { 'G', 'P', 'T', 'B' };
+	const uint32_t FORMAT_VERSION = 1;
+
+	struct FileHeader {
+		char magic[4];
+		uint32_t formatVersion;
+		uint32_t tables;
+		uint32_t reserved;
+	};
+
+	struct TableHeader {
+		uint32_t count;
+		uint32_t fingerprint;
+	};
+
+	/**
+	 * Runs one Dijkstra search per waypoint, each filling one row of
+	 * the table.
+	 */
+	class RowJob : public WorkerPool::Job {
+			typedef PathTable::Index Index;
+
+			struct NodeState {
+				double costSum;
+				Index heapIndex;
+				bool closed;
+			};
+
+			struct HeapTraits {
+				std::vector<NodeState>* nodes;
+				HeapTraits(std::vector<NodeState>* nodes) : nodes(nodes) { }
+				bool less(Index a, Index b) const { return (*nodes)[a].costSum < (*nodes)[b].costSum; }
+				void setIndex(Index x, size_t i) const { (*nodes)[x].heapIndex = i; }
+				size_t getIndex(Index x) const { return (*nodes)[x].heapIndex; }
+			};
+
+			const WaypointGraph& graph;
+			Index* next;
+			float* distances;
+			std::vector< std::vector<NodeState> > scratch;
+
+		public:
+			RowJob(const WaypointGraph& graph, Index* next, float* distances, unsigned workers) :
+				graph(graph), next(next), distances(distances), scratch(workers) { }
+
+			void run(size_t item, unsigned worker) {
+				const Index n = graph.size(), source = item;
+				std::vector<NodeState> &nodes = scratch[worker];
+				nodes.resize(n);
+				for(Index i = 0; i < n; ++i) {
+					nodes[i].costSum = std::numeric_limits<double>::infinity();
+					nodes[i].closed = false;
+				}
+
+				Index *rowNext = next + (size_t)source * n;
+				float *rowDistances = distances + (size_t)source * n;
+				for(Index i = 0; i < n; ++i) {
+					rowNext[i] = WaypointGraph::NO_INDEX;
+					rowDistances[i] = std::numeric_limits<float>::infinity();
+				}
+
+				IndexedHeap<Index, HeapTraits> border = IndexedHeap<Index, HeapTraits>(HeapTraits(&nodes));
+				nodes[source].costSum = 0;
+				rowNext[source] = source;
+				border.push(source);
+
+				while(!border.empty()) {
+					Index current = border.pop();
+					nodes[current].closed = true;
+					rowDistances[current] = nodes[current].costSum;
+
+					for(Index e = graph.beginEdges(current); e != graph.endEdges(current); ++e) {
+						const WaypointGraph::Edge &edge = graph.getEdge(e);
+						NodeState &to = nodes[edge.target];
+						double cost = nodes[current].costSum + edge.cost;
+						if(to.closed || cost >= to.costSum) { continue; }
+
+						bool queued = (to.costSum != std::numeric_limits<double>::infinity());
+						to.costSum = cost;
+						// The first hop is inherited from the parent, except
+						// for the neighbours of the source
+						rowNext[edge.target] = (current == source) ? edge.target : rowNext[current];
+						if(queued) { border.decrease(edge.target); }
+						else { border.push(edge.target); }
+					}
+				}
+			}
+	};
+} // namespace
+
+/**
+ * Read-only mapping of a whole file, unmapped when the last table
+ * pointing into it is gone.
+ */
+class PathTable::MappedFile {
+		void *data;
+		size_t size;
+
+	public:
+		MappedFile() : data(MAP_FAILED), size(0) { }
+
+		~MappedFile() {
+			if(data != MAP_FAILED) { munmap(data, size); }
+		}
+
+		bool open(const std::string& filename) {
+			int fd = ::open(filename.c_str(), O_RDONLY);
+			if(fd < 0) { return false; }
+
+			struct stat st;
+			if(fstat(fd, &st) == 0 && st.st_size > 0) {
+				size = st.st_size;
+				data = mmap(0, size, PROT_READ, MAP_PRIVATE, fd, 0);
+			}
+			// The mapping stays valid after closing the descriptor
+			::close(fd);
+			return data != MAP_FAILED;
+		}
+
+		const char* getData() const { return static_cast<const char*>(data); }
+		size_t getSize() const { return size; }
+};
+
+PathTable::PathTable() : count(0), fingerprint(0), next(0), distances(0) {
+}
+
+PathTable::PathTable(const PathTable& other) {
+	*this = other;
+}
+
+PathTable& PathTable::operator=(const PathTable& other) {
+	count = other.count;
+	fingerprint = other.fingerprint;
+	nextStorage = other.nextStorage;
+	distanceStorage = other.distanceStorage;
+	file = other.file;
+	if(file) {
+		next = other.next;
+		distances = other.distances;
+	}
+	else {
+		useStorage();
+	}
+	return *this;
+}
+
+void PathTable::useStorage() {
+	next = nextStorage.empty() ? 0 : &nextStorage[0];
+	distances = distanceStorage.empty() ? 0 : &distanceStorage[0];
+}
+
+void PathTable::build(const WaypointGraph& graph, unsigned threads) {
+	clear();
+	count = graph.size();
+	fingerprint = fingerprintOf(graph);
+	nextStorage.resize((size_t)count * count);
+	distanceStorage.resize((size_t)count * count);
+	useStorage();
+
+	WorkerPool pool(threads);
+	RowJob job(graph, next ? &nextStorage[0] : 0, distances ? &distanceStorage[0] : 0, pool.getThreads());
+	pool.run(job, count);
+}
+
+void PathTable::clear() {
+	count = 0;
+	fingerprint = 0;
+	nextStorage.clear();
+	distanceStorage.clear();
+	file.reset();
+	useStorage();
+}
+
+bool PathTable::findPath(const WaypointGraph& graph,
+		VirtualPosition source, const std::vector<Edge>& sourceLinks,
+		VirtualPosition target, const std::vector<Edge>& targetLinks,
+		bool direct, Path& path) const {
+
+	// Nothing beats the straight line
+	if(direct) {
+		path.push_back(target);
+		return true;
+	}
+
+	double best = std::numeric_limits<double>::infinity();
+	Index bestSource = WaypointGraph::NO_INDEX, bestTarget = WaypointGraph::NO_INDEX;
+	for(std::vector<Edge>::const_iterator s = sourceLinks.begin(); s != sourceLinks.end(); ++s) {
+		const float *row = distances + (size_t)s->target * count;
+		for(std::vector<Edge>::const_iterator t = targetLinks.begin(); t != targetLinks.end(); ++t) {
+			double cost = s->cost + row[t->target] + t->cost;
+			if(cost < best) {
+				best = cost;
+				bestSource = s->target;
+				bestTarget = t->target;
+			}
+		}
+	}
+
+	if(bestSource == WaypointGraph::NO_INDEX) {
+		cdbg << "did not find path :(\n";
+		return false;
+	}
+
+	// A shortest path visits every waypoint at most once, anything else
+	// means the table is damaged
+	size_t start = path.size();
+	Index p = bestSource;
+	path.push_back(graph.getPosition(p));
+	for(Index hops = 0; p != bestTarget; ++hops) {
+		p = getNext(p, bestTarget);
+		if(p >= count || hops >= count) {
+			cdbg << "PathTable::findPath: damaged table\n";
+			path.resize(start);
+			return false;
+		}
+		path.push_back(graph.getPosition(p));
+	}
+	path.push_back(target);
+	return true;
+}
+
+uint32_t PathTable::fingerprintOf(const WaypointGraph& graph) {
+	// FNV-1a
+	uint32_t h = 2166136261u;
+	#define HASH_WORD(w) do { \
+			uint32_t x = (w); \
+			for(int i = 0; i < 4; ++i) { h = (h ^ ((x >> (8 * i)) & 0xff)) * 16777619u; } \
+		} while(false)
+
+	HASH_WORD(graph.size());
+	for(Index i = 0; i < graph.size(); ++i) {
+		HASH_WORD(graph.getPosition(i).getX());
+		HASH_WORD(graph.getPosition(i).getY());
+		HASH_WORD(graph.endEdges(i) - graph.beginEdges(i));
+		for(Index e = graph.beginEdges(i); e != graph.endEdges(i); ++e) {
+			HASH_WORD(graph.getEdge(e).target);
+		}
+	}
+
+	#undef HASH_WORD
+	return h;
+}
+
+bool PathTable::save(const std::string& filename, const std::vector<const PathTable*>& tables) {
+	std::ofstream out(filename.c_str(), std::ios::out | std::ios::binary | std::ios::trunc);
+	if(!out) { return false; }
+
+	FileHeader header;
+	std::memcpy(header.magic, MAGIC, sizeof(MAGIC));
+	header.formatVersion = FORMAT_VERSION;
+	header.tables = tables.size();
+	header.reserved = 0;
+	out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+
+	for(std::vector<const PathTable*>::const_iterator iter = tables.begin(); iter != tables.end(); ++iter) {
+		const PathTable &t = **iter;
+		TableHeader th;
+		th.count = t.count;
+		th.fingerprint = t.fingerprint;
+		out.write(reinterpret_cast<const char*>(&th), sizeof(th));
+		if(t.count) {
+			size_t cells = (size_t)t.count * t.count;
+			out.write(reinterpret_cast<const char*>(t.next), cells * sizeof(Index));
+			out.write(reinterpret_cast<const char*>(t.distances), cells * sizeof(float));
+		}
+	}
+	return out.good();
+}
+
+bool PathTable::load(const std::string& filename, std::vector<PathTable>& tables) {
+	boost::shared_ptr<MappedFile> file(new MappedFile);
+	if(!file->open(filename)) {
+		cdbg << "PathTable::load: could not map " << filename << "\n";
+		return false;
+	}
+
+	const char *data = file->getData(), *end = data + file->getSize();
+	if((size_t)(end - data) < sizeof(FileHeader)) { return false; }
+	const FileHeader &header = *reinterpret_cast<const FileHeader*>(data);
+	if(std::memcmp(header.magic, MAGIC, sizeof(MAGIC)) != 0 || header.formatVersion != FORMAT_VERSION) {
+		cdbg << "PathTable::load: " << filename << " is not a path table file\n";
+		return false;
+	}
+	data += sizeof(FileHeader);
+
+	// Every table takes at least its header, don't allocate for more
+	// tables than the file can hold
+	if((size_t)(end - data) / sizeof(TableHeader) < header.tables) {
+		cdbg << "PathTable::load: " << filename << " is truncated\n";
+		return false;
+	}
+
+	std::vector<PathTable> loaded(header.tables);
+	for(std::vector<PathTable>::iterator iter = loaded.begin(); iter != loaded.end(); ++iter) {
+		if((size_t)(end - data) < sizeof(TableHeader)) { return false; }
+		const TableHeader &th = *reinterpret_cast<const TableHeader*>(data);
+		data += sizeof(TableHeader);
+
+		size_t cells = (size_t)th.count * th.count;
+		if((size_t)(end - data) / (sizeof(Index) + sizeof(float)) < cells) {
+			cdbg << "PathTable::load: " << filename << " is truncated\n";
+			return false;
+		}
+
+		// findPath() follows the next hops without checking them again
+		const Index *next = reinterpret_cast<const Index*>(data);
+		for(size_t i = 0; i < cells; ++i) {
+			if(next[i] >= th.count && next[i] != WaypointGraph::NO_INDEX) {
+				cdbg << "PathTable::load: " << filename << " is damaged\n";
+				return false;
+			}
+		}
+
+		iter->count = th.count;
+		iter->fingerprint = th.fingerprint;
+		iter->file = file;
+		iter->next = next;
+		data += cells * sizeof(Index);
+		iter->distances = reinterpret_cast<const float*>(data);
+		data += cells * sizeof(float);
+	}
+
+	tables.swap(loaded);
+	return true;
+}
+
+} // namespace grail
+
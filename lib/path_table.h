@@ -0,0 +1,118 @@
+// vim: set noexpandtab:
+
+#ifndef PATH_TABLE_H
+#define PATH_TABLE_H
+
+#include <string>
+#include <vector>
+#include <stdint.h>
+#include <boost/shared_ptr.hpp>
+
+#include "vector2d.h"
+#include "actor.h" // ->Path
+#include "waypoint_graph.h"
+
+namespace grail {
+
+/**
+ * Precomputed shortest paths between all pairs of waypoints of a
+ * WaypointGraph: for each pair (a, b) the length of the shortest path and
+ * the first waypoint after a on it (the next hop).
+ *
+ * A query then only needs the edges from its source and its target into
+ * the graph and reads the best combination from the table, no search
+ * needed. Memory is quadratic in the number of waypoints (8 bytes per
+ * pair), so this is meant for grounds that don't change and don't have
+ * too many corners.
+ *
+ * Tables can be written to a file (e.g. next to the scene media) and
+ * loaded back by mapping that file into memory, loaded tables point
+ * directly into the mapping. The file is in native byte order and carries
+ * a fingerprint of each graph so stale files can be detected.
+ */
+class PathTable {
+	public:
+		typedef WaypointGraph::Index Index;
+		typedef WaypointGraph::Edge Edge;
+
+	private:
+		class MappedFile;
+
+		Index count;
+		uint32_t fingerprint;
+
+		/// row-major count * count arrays, pointing into the vectors
+		/// below or into a mapped file
+		const Index *next;
+		const float *distances;
+
+		std::vector<Index> nextStorage;
+		std::vector<float> distanceStorage;
+		boost::shared_ptr<MappedFile> file;
+
+		void useStorage();
+
+	public:
+		PathTable();
+		PathTable(const PathTable& other);
+		PathTable& operator=(const PathTable& other);
+
+		/**
+		 * (Re-)compute the table for $graph with a Dijkstra search from
+		 * every waypoint, distributed among $threads threads (0: one per
+		 * CPU core).
+		 */
+		void build(const WaypointGraph& graph, unsigned threads = 1);
+
+		void clear();
+
+		/// Number of waypoints, 0 if not built
+		Index size() const { return count; }
+
+		/// Fingerprint of the graph this table was built for
+		uint32_t getFingerprint() const { return fingerprint; }
+
+		/**
+		 * The waypoint following $from on the shortest path to $to ($to
+		 * itself if they are linked directly, $from if they are equal),
+		 * NO_INDEX if $to can't be reached.
+		 */
+		Index getNext(Index from, Index to) const { return next[(size_t)from * count + to]; }
+
+		/// Length of the shortest path, infinity if there is none
+		float getDistance(Index from, Index to) const { return distances[(size_t)from * count + to]; }
+
+		/**
+		 * Same interface and result (up to equally long alternatives) as
+		 * WaypointSearch::findPath(), @pre the table was built for $graph.
+		 * Also false (and $path unchanged) if the next hops lead nowhere
+		 * or in circles.
+		 */
+		bool findPath(const WaypointGraph& graph,
+				VirtualPosition source, const std::vector<Edge>& sourceLinks,
+				VirtualPosition target, const std::vector<Edge>& targetLinks,
+				bool direct, Path& path) const;
+
+		/**
+		 * Hash over the waypoint positions and links of $graph.
+		 */
+		static uint32_t fingerprintOf(const WaypointGraph& graph);
+
+		/**
+		 * Write $tables to file $filename.
+		 * @return false if the file could not be written
+		 */
+		static bool save(const std::string& filename, const std::vector<const PathTable*>& tables);
+
+		/**
+		 * Map the file $filename into memory and replace the contents of
+		 * $tables with the tables stored in it.
+		 * @return false if the file could not be read or is damaged
+		 */
+		static bool load(const std::string& filename, std::vector<PathTable>& tables);
+};
+
+} // namespace grail
+
+#endif // PATH_TABLE_H
+
@@ -0,0 +1,138 @@
+
+#include "path_task.h"
+
+#include <algorithm>
+#include <iterator>
+#include <vector>
+#include <sys/time.h>
+#include "game.h"
+#include "scene.h"
+#include "ground.h"
+#include "debug.h"
+
+namespace grail {
+
+	namespace {
+		/// Nodes to expand between two looks at the clock
+		const size_t EXPANSIONS_PER_CHECK = 32;
+
+		uint64_t microseconds() {
+			timeval tv;
+			gettimeofday(&tv, 0);
+			return (uint64_t)tv.tv_sec * 1000000 + tv.tv_usec;
+		}
+	}
+
+	PathTask::PathTask(Actor::Ptr actor, VirtualPosition target, uint32_t budget, bool walkPartial) :
+		actor(actor), target(target), budget(budget), walkPartial(walkPartial), ground(0), version(0) {
+	}
+
+	void PathTask::onStart() {
+		Scene::Ptr s = Game::getInstance().getCurrentScene();
+		if(!s) {
+			signalComplete();
+			return;
+		}
+		ground = &s->getGround();
+		restart();
+	}
+
+	void PathTask::restart() {
+		if(!branch.empty()) {
+			actor->walk(Path());
+			branch.clear();
+		}
+		source = actor->getPosition();
+		version = ground->getVersion();
+
+		Path path;
+		if(ground->startPath(source, target, search, path)) {
+			complete(path);
+		}
+	}
+
+	void PathTask::complete(const Path& path) {
+		if(path.empty()) {
+			actor->walk(path);
+		}
+		else {
+			actor->walk(rejoin(branch, actor->getWalkPath().size(), source, path));
+		}
+		signalComplete();
+	}
+
+	void PathTask::eachFrame(uint32_t ticks) {
+		if(!ground || getState() == STATE_COMPLETED) { return; }
+
+		if(ground->getVersion() != version) {
+			cdbg << "PathTask: ground changed, starting over\n";
+			restart();
+			if(getState() == STATE_COMPLETED) { return; }
+		}
+
+		uint64_t end = microseconds() + budget;
+		WaypointSearch::State state;
+		do {
+			state = search.advance(EXPANSIONS_PER_CHECK);
+		} while(state == WaypointSearch::STATE_RUNNING && microseconds() < end);
+
+		if(state == WaypointSearch::STATE_RUNNING) {
+			if(walkPartial) {
+				followPartialPath();
+			}
+			return;
+		}
+
+		Path path;
+		ground->finishPath(source, target, search, path);
+		complete(path);
+	}
+
+	void PathTask::followPartialPath() {
+		// Only move on once the actor is done with the last partial path,
+		// and only if the new one continues it, so it never has to turn back
+		// before the search is done
+		if(!actor->getWalkPath().empty()) { return; }
+
+		Path partial;
+		search.getPartialPath(partial);
+		if(partial.size() <= branch.size() || !std::equal(branch.begin(), branch.end(), partial.begin())) {
+			return;
+		}
+
+		Path::iterator iter = partial.begin();
+		std::advance(iter, branch.size());
+		actor->walk(Path(iter, partial.end()));
+		branch = partial;
+	}
+
+	Path PathTask::rejoin(const Path& branch, size_t remaining, VirtualPosition source, const Path& path) {
+		std::vector<VirtualPosition> q(branch.begin(), branch.end()), f(path.begin(), path.end());
+
+		// q[next] is the point the actor is heading for
+		size_t next = q.size() - std::min(remaining, q.size());
+
+		size_t common = 0;
+		while(common < q.size() && common < f.size() && q[common] == f[common]) {
+			common++;
+		}
+
+		Path r;
+		if(next < common) {
+			r.insert(r.end(), f.begin() + next, f.end());
+			return r;
+		}
+
+		// Walk back to where the paths branch off
+		for(size_t i = next; i >= common && i > 0; --i) {
+			r.push_back(q[i - 1]);
+		}
+		if(common == 0) {
+			r.push_back(source);
+		}
+		r.insert(r.end(), f.begin() + common, f.end());
+		return r;
+	}
+
+}
+
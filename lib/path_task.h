@@ -0,0 +1,77 @@
+// vim: set noexpandtab ts=4 sw=4:
+
+#ifndef PATH_TASK_H
+#define PATH_TASK_H
+
+#include <stdint.h>
+#include "task.h"
+#include "actor.h"
+#include "vector2d.h"
+#include "waypoint_graph.h"
+
+namespace grail {
+
+	/**
+	 * Finds a path for an actor on the ground of the current scene and
+	 * lets it walk there, spreading the search over as many frames as
+	 * needed so each frame spends at most about $budget microseconds on
+	 * it (unlike Actor::walkTo(), which searches at once).
+	 *
+	 * Optionally the actor starts walking right away towards the waypoint
+	 * nearest to the target found so far. All those partial paths branch
+	 * off the final one at some waypoint, so when the search is done the
+	 * actor just walks back to where its path branched off if necessary.
+	 *
+	 * If the ground changes during the search (see Ground::getVersion()),
+	 * the search is started over from where the actor is then.
+	 *
+	 * Only searches on the visibility graph (Ground::ENGINE_VISIBILITY_GRAPH
+	 * without path tables) are spread over frames. The navigation mesh and
+	 * grid engines search all at once in the first frame (see
+	 * Ground::startPath()), so the budget doesn't hold for them.
+	 */
+	class PathTask : public Task {
+		private:
+			Actor::Ptr actor;
+			VirtualPosition target;
+			uint32_t budget;
+			bool walkPartial;
+
+			Ground *ground;
+			uint32_t version;
+			VirtualPosition source;
+			WaypointSearch search;
+
+			/// partial path the actor was sent along last (excluding source)
+			Path branch;
+
+			void restart();
+			void complete(const Path& path);
+			void followPartialPath();
+
+		public:
+			/**
+			 * \param budget Time to spend searching per frame in
+			 * 	microseconds.
+			 * \param walkPartial Start walking before the path is known
+			 */
+			PathTask(Actor::Ptr actor, VirtualPosition target, uint32_t budget = 2000, bool walkPartial = false);
+			~PathTask() { };
+
+			void onStart();
+			void eachFrame(uint32_t ticks);
+
+			/**
+			 * Turn $path (excluding source) into a path for an actor that
+			 * had been sent along $branch (from the same source) and still
+			 * has $remaining points of it left to go.
+			 * Both must be paths of the same search, e.g. a partial path and
+			 * the final path.
+			 */
+			static Path rejoin(const Path& branch, size_t remaining, VirtualPosition source, const Path& path);
+	};
+
+}
+
+#endif // PATH_TASK_H
+
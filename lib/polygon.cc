@@ -1,6 +1,7 @@
 // vim: set noexpandtab:
 
-#include <list>
+#include <algorithm>
+#include <cassert>
 #include "polygon.h"
 #include "vector2d.h"
 #include "debug.h"
@@ -9,15 +10,54 @@
 namespace grail {
 
 template<typename Node, typename GetPosition>
-Polygon<Node, GetPosition>::Polygon() : orientation(UNKNOWN) {
+Polygon<Node, GetPosition>::Polygon() : doubleArea(0) {
 }
 
 template<typename Node, typename GetPosition>
 Polygon<Node, GetPosition>::~Polygon() {
 }
 
+template<typename Node, typename GetPosition>
+void Polygon<Node, GetPosition>::push_back(const Node& n) {
+	VirtualPosition p = GetPosition::getPosition(n);
+	assert(inPredicateRange(p));
+	
+	// Keeps the first node if there are several at p
+	nodeIndex.insert(std::make_pair(p, nodes.size()));
+	
+	if(nodes.empty()) {
+		topLeft = bottomRight = p;
+		nodes.push_back(n);
+		edges.push_back(Line(p, p));
+		turns.push_back(0);
+		return;
+	}
+	
+	topLeft = VirtualPosition(std::min(topLeft.getX(), p.getX()), std::min(topLeft.getY(), p.getY()));
+	bottomRight = VirtualPosition(std::max(bottomRight.getX(), p.getX()), std::max(bottomRight.getY(), p.getY()));
+	
+	// p goes between the last and the first node, so only the closing
+	// edge and the turns at its ends change
+	VirtualPosition first = GetPosition::getPosition(nodes.front()),
+		last = GetPosition::getPosition(nodes.back());
+	doubleArea += cross(last, p) + cross(p, first) - cross(last, first);
+	
+	VirtualPosition beforeLast = GetPosition::getPosition(nodes[nodes.size() > 1 ? nodes.size() - 2 : 0]),
+		second = GetPosition::getPosition(nodes[nodes.size() > 1 ? 1 : 0]);
+	nodes.push_back(n);
+	edges.setB(edges.size() - 1, p);
+	edges.push_back(Line(p, first));
+	turns.back() = orientation(beforeLast, last, p);
+	turns.push_back(orientation(last, p, first));
+	turns.front() = orientation(p, first, nodes.size() > 2 ? second : p);
+}
+
 template<typename Node, typename GetPosition>
 bool Polygon<Node, GetPosition>::hasPoint(VirtualPosition p) const {
+	if(!inBounds(p)) {
+		return false;
+	}
+	
 	if(hasBoundaryPoint(p)) {
 		return true;
 	}
@@ -25,53 +65,42 @@ bool Polygon<Node, GetPosition>::hasPoint(VirtualPosition p) const {
 	// If there is an uneven number of intersections
 	// in both directions, the Offset is inside the
 	// polygon
-	bool unevenIntersectionsRight = false;
-	bool unevenIntersectionsLeft = false;
-	
-	// Consider all lines from one point to the next one
-	// plus one line from the last one to the first
-	typename list<Node>::const_iterator iter, iter2;
-	for(iter = nodes.begin(); iter != nodes.end(); iter++) {
-		iter2 = iter;
-		iter2++;
-		if(iter2 == nodes.end()) { iter2 = nodes.begin(); }
-		unevenIntersectionsRight ^= intersects(p, GetPosition::getPosition(*iter), GetPosition::getPosition(*iter2), true);
-		unevenIntersectionsLeft ^= intersects(p, GetPosition::getPosition(*iter), GetPosition::getPosition(*iter2), false);
-	}
-	return unevenIntersectionsRight && unevenIntersectionsLeft;
+	size_t right, left;
+	edges.countCrossings(p, right, left);
+	return (right & 1) && (left & 1);
 }
 
 template<typename Node, typename GetPosition>
 bool Polygon<Node, GetPosition>::hasBoundaryPoint(VirtualPosition p) const {
-	LineIterator li;
-	for(li = beginLines(); li != endLines(); ++li) {
-		if((*li).hasPoint(p)) { return true; }
-	}
-	return false;
+	if(!inBounds(p)) { return false; }
+	
+	return edges.hasPoint(p);
 }
 
 
 template<typename Node, typename GetPosition>
 typename Polygon<Node, GetPosition>::LineDirection Polygon<Node, GetPosition>::getLineDirection(Line l) const {
 	
-	LineIterator li;
-	Line prev(GetPosition::getPosition(nodes.back()), GetPosition::getPosition(nodes.front()));
-	Orientation o = getOrientation();
+	if(!inBounds(l.getA())) { return NOT_ATTACHED; }
 	
-	for(li = beginLines(); li != endLines(); ++li) {
-		if((*li).getA() == l.getA()) {
-			break;
-		}
-		prev = *li;
-	}
+	size_t i = indexOf(l.getA());
+	if(i == nodes.size()) { return NOT_ATTACHED; }
 	
-	if(li == endLines()) { return NOT_ATTACHED; }
-	
-	VirtualPosition::Scalar turn = (prev.getB() - prev.getA()).cross((*li).getB() - (*li).getA());
-	bool convex = (turn == 0) || ((turn > 0) == (o == CW));
-	
-	VirtualPosition::Scalar s_prev = (prev.getB() - prev.getA()).cross(l.getB() - l.getA()),
-		s_li = ((*li).getB() - (*li).getA()).cross(l.getB() - l.getA());
+	VirtualPosition prev = GetPosition::getPosition(nodes[i ? i - 1 : nodes.size() - 1]),
+		next = GetPosition::getPosition(nodes[(i + 1) % nodes.size()]);
+	return getLineDirection(prev, l.getA(), next, isConvex(i), getOrientation(), l);
+} // getLineDirection()
+
+template<typename Node, typename GetPosition>
+typename Polygon<Node, GetPosition>::LineDirection Polygon<Node, GetPosition>::getLineDirection(VirtualPosition prev, VirtualPosition node, VirtualPosition next, Orientation o, Line l) {
+	int turn = orientation(prev, node, next);
+	return getLineDirection(prev, node, next, (turn == 0) || ((turn > 0) == (o == CW)), o, l);
+}
+
+template<typename Node, typename GetPosition>
+typename Polygon<Node, GetPosition>::LineDirection Polygon<Node, GetPosition>::getLineDirection(VirtualPosition prev, VirtualPosition node, VirtualPosition next, bool convex, Orientation o, Line l) {
+	int64_t s_prev = cross(node - prev, l.getB() - l.getA()),
+		s_li = cross(next - node, l.getB() - l.getA());
 	
 	if(o == CCW) {
 		s_li *= -1;
@@ -91,72 +120,6 @@ typename Polygon<Node, GetPosition>::LineDirection Polygon<Node, GetPosition>::g
 	return OUT;
 } // getLineDirection()
 
-template<typename Node, typename GetPosition>
-bool Polygon<Node, GetPosition>::intersects(VirtualPosition q, VirtualPosition pa, VirtualPosition pb, bool right) {
-	// Think a horizontal line drawn from q to the right and look
-	// for an intersection.
-	VirtualPosition::Y dy = pb.getY() - pa.getY();
-	
-	// If dy is 0, we test against a horizontal line. In this border-case we
-	// define the lines as non-intersecting.
-	if(dy == 0) {
-		return false;
-	}
-	
-	// We assumed endless straight lines up to now. Now look if the
-	// intersection point is really between pa and pb.
-	// t == 0 would mean: The intersection point is pa, t == 1 would mean the
-	// intersection point is pb.
-
-	double t = static_cast<double>(q.getY() - pa.getY()) / static_cast<double>(dy);
-	if(t < 0.0 || t > 1.0) {
-		return false;
-	}
-	
-	if(t == 0.0 || t == 1.0) {
-		// DARN! We hit a node. To make sure we didnt just strive the polygon,
-		// consider it as intersection if the other point has a lower y-value.
-		// (See http://alienryderflex.com/polygon/)
-		
-		if(!((t == 0.0 && pa.getY() > pb.getY()) || (t == 1.0 && pb.getY() > pa.getY()))) {
-			return false;
-		}
-	}
-	
-	// w is the distance from q to the intersection point.
-	// If it is not positive, we would have to draw our line to the left, but
-	// we only consider one drawn to the right.
-	VirtualPosition::X w = pa.getX() - q.getX() + (pb.getX() - pa.getX()) * t;
-	if(right) {
-		return w > 0;
-	}
-	else {
-		return w < 0;
-	}
-} // intersects()
-
-template<typename Node, typename GetPosition>
-void Polygon<Node, GetPosition>::updateOrientation() const {
-	LineIterator li = beginLines();
-	double a = ((*li).getB() - (*li).getA()).getAngle(), new_a = 0, angleSum = 0;
-	for(++li ; li != endLines(); ++li) {
-		a = normalizeAngle(a);
-		new_a = ((*li).getB() - (*li).getA()).getAngle();
-		double x = a + M_PI - new_a;
-		x = normalizeAngle(x);
-		angleSum += x;
-		a = new_a;
-	}
-	
-	li = beginLines();
-	new_a = ((*li).getB() - (*li).getA()).getAngle();
-	a = normalizeAngle(a);
-	double x = a + M_PI - new_a;
-	x = normalizeAngle(x);
-	angleSum += x;
-	
-	orientation = fequal(angleSum / (nodes.size() - 2.0), M_PI) ? CCW : CW;
-}
 
 
 #if VISUALIZE_POLYGONS
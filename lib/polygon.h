@@ -3,14 +3,17 @@
 #ifndef POLYGON_H
 #define POLYGON_H
 
-#include <list>
-using std::list;
+#include <vector>
+#include <stdint.h>
 
 #include "area.h"
 #include "vector2d.h"
 #include "line.h"
+#include "edge_arrays.h"
+#include "predicates.h"
 #include "visualize.h"
 #include <boost/shared_ptr.hpp>
+#include <boost/unordered_map.hpp>
 
 namespace grail {
 
@@ -28,25 +31,18 @@ class Polygon : public Area {
 		
 		class LineIterator {
 				const Polygon *parent;
-				typename list<Node>::const_iterator iter;
+				size_t index;
 			public:
-				LineIterator() : parent(0) { }
-				LineIterator(const Polygon* parent, typename list<Node>::const_iterator iter) :
-					parent(parent), iter(iter) { }
-				void operator++() { ++iter; }
-				void operator++(int) { iter++; }
-				bool operator==(const LineIterator& other) const { return iter == other.iter; }
-				bool operator!=(const LineIterator& other) const { return iter != other.iter; }
-				Line operator*() {
-					typename list<Node>::const_iterator iter2;
-					iter2 = iter;
-					++iter2;
-					if(iter2 == parent->nodes.end()) { iter2 = (parent->nodes).begin(); }
-					return Line(GetPosition::getPosition(*iter), GetPosition::getPosition(*iter2));
-				}
+				LineIterator() : parent(0), index(0) { }
+				LineIterator(const Polygon* parent, size_t index) :
+					parent(parent), index(index) { }
+				void operator++() { ++index; }
+				void operator++(int) { index++; }
+				bool operator==(const LineIterator& other) const { return index == other.index; }
+				bool operator!=(const LineIterator& other) const { return index != other.index; }
+				Line operator*() const { return parent->edges[index]; }
 		};
-		typedef typename list<Node>::iterator NodeIterator;
-		typedef typename list<Node>::const_iterator ConstNodeIterator;
+		typedef typename std::vector<Node>::const_iterator ConstNodeIterator;
 		
 		Polygon();
 		virtual ~Polygon();
@@ -61,40 +57,96 @@ class Polygon : public Area {
 		 */
 		bool hasBoundaryPoint(VirtualPosition p) const;
 		
-		Orientation getOrientation() const {
-			if(orientation == UNKNOWN) { updateOrientation(); }
-			return orientation;
+		/**
+		 * Orientation as the polygon appears on screen (y pointing
+		 * down). Self-intersecting polygons are oriented like the
+		 * bigger part of their area.
+		 */
+		Orientation getOrientation() const { return (doubleArea >= 0) ? CW : CCW; }
+		
+		/**
+		 * Signed area, positive for CW polygons.
+		 */
+		double getArea() const { return doubleArea / 2.0; }
+		
+		/**
+		 * Corners of the axis aligned bounding box (both inclusive),
+		 * (0, 0) for an empty polygon.
+		 */
+		VirtualPosition getTopLeft() const { return topLeft; }
+		VirtualPosition getBottomRight() const { return bottomRight; }
+		
+		/**
+		 * \return true iff $p lies in the bounding box.
+		 */
+		bool inBounds(VirtualPosition p) const {
+			return !nodes.empty() &&
+				p.getX() >= topLeft.getX() && p.getX() <= bottomRight.getX() &&
+				p.getY() >= topLeft.getY() && p.getY() <= bottomRight.getY();
 		}
 		
+		size_t size() const { return nodes.size(); }
+		const Node& operator[](size_t i) const { return nodes[i]; }
+		
+		/**
+		 * \return true iff the polygon does not bend inwards at node $i,
+		 * (straight nodes count as convex).
+		 */
+		bool isConvex(size_t i) const { return turns[i] == 0 || ((turns[i] > 0) == (getOrientation() == CW)); }
+		
+		/// \return true iff the polygon goes straight on at node $i
+		bool isStraight(size_t i) const { return turns[i] == 0; }
+		
 		LineDirection getLineDirection(Line l) const;
 		
-		LineIterator beginLines() const { return LineIterator(this, nodes.begin()); }
-		LineIterator endLines() const { return LineIterator(this, nodes.end()); }
-		LineIterator beginLines() { return LineIterator(this, nodes.begin()); }
-		LineIterator endLines() { return LineIterator(this, nodes.end()); }
+		/**
+		 * Same as getLineDirection() for a polygon with orientation $o
+		 * where $node is the start point of $l and $prev / $next are the
+		 * nodes before and after it.
+		 */
+		static LineDirection getLineDirection(VirtualPosition prev, VirtualPosition node, VirtualPosition next, Orientation o, Line l);
+		
+		/// \return index of the first node at $p, or size() if there is none
+		size_t indexOf(VirtualPosition p) const {
+			typename NodeIndex::const_iterator iter = nodeIndex.find(p);
+			return (iter == nodeIndex.end()) ? nodes.size() : iter->second;
+		}
+		
+		LineIterator beginLines() const { return LineIterator(this, 0); }
+		LineIterator endLines() const { return LineIterator(this, nodes.size()); }
 		
 		ConstNodeIterator beginNodes() const { return nodes.begin(); }
 		ConstNodeIterator endNodes() const { return nodes.end(); }
-		NodeIterator beginNodes() { return nodes.begin(); }
-		NodeIterator endNodes() { return nodes.end(); }
 		
-		void push_back(const Node& p) { nodes.push_back(p); orientation = UNKNOWN; }
-		void clear() { nodes.clear(); orientation = UNKNOWN; }
+		/**
+		 * Bounding box, edges, area, turns and the node index are
+		 * updated in (amortized) constant time here, so all queries can
+		 * be run concurrently without any lazily computed state.
+		 */
+		void push_back(const Node& p);
+		void clear() { nodes.clear(); nodeIndex.clear(); edges.clear(); turns.clear(); doubleArea = 0; topLeft = bottomRight = VirtualPosition(0, 0); }
 		
 		#if VISUALIZE_POLYGONS
 		void renderAt(SDL_Surface* target, uint32_t ticks, VirtualPosition p) const;
 		#endif
 		
 	private:
-		/**
-		 * Return true iff TODO
-		 */
-		static bool intersects(VirtualPosition q, VirtualPosition pa, VirtualPosition pb, bool right);
+		struct PositionHash {
+			size_t operator()(VirtualPosition p) const { return (size_t)p.getX() * 73856093u ^ (size_t)p.getY() * 19349663u; }
+		};
+		typedef boost::unordered_map<VirtualPosition, size_t, PositionHash> NodeIndex;
 		
-		void updateOrientation() const;
+		static LineDirection getLineDirection(VirtualPosition prev, VirtualPosition node, VirtualPosition next, bool convex, Orientation o, Line l);
 		
-		list<Node> nodes;
-		mutable Orientation orientation;
+		std::vector<Node> nodes;
+		/// Position -> index of the first node there, so corners are
+		/// found without a scan
+		NodeIndex nodeIndex;
+		/// Edge i goes from node i to node i + 1
+		EdgeArrays edges;
+		std::vector<signed char> turns;
+		int64_t doubleArea;
+		VirtualPosition topLeft, bottomRight;
 		
 };
 
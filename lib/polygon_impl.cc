@@ -8,7 +8,6 @@
 namespace grail {
 	
 	template class Polygon<VirtualPosition, IsPosition>;
-	template class Polygon<Ground::Waypoint*, Ground::Waypoint::GetPosition>;
 	
 } // namespace grail
 
@@ -0,0 +1,71 @@
+// vim: set noexpandtab:
+
+#ifndef PREDICATES_H
+#define PREDICATES_H
+
+#include <stdint.h>
+
+#include "vector2d.h"
+
+namespace grail {
+
+/*
+ * Exact geometric predicates on positions.
+ *
+ * Everything is computed with 64 bit integers, so the results are exact
+ * (no epsilons, no sqrt). orient(), orientation() and onSegment() widen
+ * before subtracting and hold for coordinates within +-2^30 (exclusive).
+ * cross() and dot() are mostly called on differences of two positions,
+ * which are 32 bit vectors themselves; for those to not overflow,
+ * coordinates have to stay within +-MAX_COORDINATE. Polygon asserts this
+ * for its nodes.
+ */
+
+const int32_t MAX_COORDINATE = 1 << 29;
+
+/// True iff $p is within the range the predicates are exact for
+inline bool inPredicateRange(VirtualPosition p) {
+	return p.getX() >= -MAX_COORDINATE && p.getX() <= MAX_COORDINATE &&
+		p.getY() >= -MAX_COORDINATE && p.getY() <= MAX_COORDINATE;
+}
+
+/// z component of the cross product of $a and $b
+inline int64_t cross(VirtualPosition a, VirtualPosition b) {
+	return (int64_t)a.getX() * b.getY() - (int64_t)a.getY() * b.getX();
+}
+
+inline int64_t dot(VirtualPosition a, VirtualPosition b) {
+	return (int64_t)a.getX() * b.getX() + (int64_t)a.getY() * b.getY();
+}
+
+/**
+ * Twice the signed area of the triangle $o, $a, $b: > 0 iff $b is left of
+ * $a as seen from $o (with positive y pointing up, i.e. right of it on
+ * screen), 0 iff the three are collinear.
+ */
+inline int64_t orient(VirtualPosition o, VirtualPosition a, VirtualPosition b) {
+	int64_t ax = (int64_t)a.getX() - o.getX(), ay = (int64_t)a.getY() - o.getY();
+	int64_t bx = (int64_t)b.getX() - o.getX(), by = (int64_t)b.getY() - o.getY();
+	return ax * by - ay * bx;
+}
+
+/// Sign of orient(), i.e. -1, 0 or 1
+inline int orientation(VirtualPosition o, VirtualPosition a, VirtualPosition b) {
+	int64_t s = orient(o, a, b);
+	return (s > 0) - (s < 0);
+}
+
+/**
+ * True iff $p lies on the segment $a - $b (end points included).
+ */
+inline bool onSegment(VirtualPosition p, VirtualPosition a, VirtualPosition b) {
+	if(orient(a, b, p) != 0) { return false; }
+	int64_t dx = (int64_t)b.getX() - a.getX(), dy = (int64_t)b.getY() - a.getY();
+	int64_t d = dx * ((int64_t)p.getX() - a.getX()) + dy * ((int64_t)p.getY() - a.getY());
+	return d >= 0 && d <= dx * dx + dy * dy;
+}
+
+} // namespace grail
+
+#endif // PREDICATES_H
+
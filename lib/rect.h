@@ -20,6 +20,18 @@ class Rect : public Area {
 				p.getY() >= topLeft.getY() &&
 				p.getY() < (topLeft + size).getY();
 		}
+		
+		VirtualPosition getTopLeft() const { return topLeft; }
+		VirtualSize getSize() const { return size; }
+		
+		/// True iff both rectangles have at least one point in common
+		bool intersects(const Rect& other) const {
+			VirtualPosition a = topLeft + size, b = other.topLeft + other.size;
+			return topLeft.getX() < b.getX() && other.topLeft.getX() < a.getX() &&
+				topLeft.getY() < b.getY() && other.topLeft.getY() < a.getY() &&
+				size.getX() > 0 && size.getY() > 0 &&
+				other.size.getX() > 0 && other.size.getY() > 0;
+		}
 };
 
 } // namespace grail
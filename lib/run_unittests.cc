@@ -1,6 +1,12 @@
 // vim: set noexpandtab:
 
 #include <utility>
+#include <cstdlib>
+#include <cstdio>
+#include <cmath>
+#include <algorithm>
+#include <queue>
+#include <functional>
 #include <boost/shared_ptr.hpp>
 #include <SDL.h>
 
@@ -8,11 +14,25 @@
 
 #include "vector2d.h"
 #include "utils.h"
+#include "sdlutils.h"
+#include "surface.h"
+#include "dirty_region.h"
+#include "rect.h"
 #include "task.h"
 #include "wait_task.h"
+#include "path_task.h"
 #include "ground.h"
+#include "waypoint_graph.h"
+#include "edge_arrays.h"
+#include "edge_grid.h"
+#include "navmesh.h"
+#include "grid_map.h"
+#include "worker_pool.h"
 #include "actor.h"
+#include "actor_index.h"
 #include "polygon.h"
+#include "predicates.h"
+#include "indexed_heap.h"
 #include "debug.h"
 
 using std::make_pair;
@@ -53,6 +73,82 @@ TEST(Vector2d, nearestDirection) {
 	CHECK_EQUAL((int)VirtualPosition(-10, -9).nearestDirection(4), 3);
 }
 
+TEST(Rect, intersects) {
+	Rect view(VirtualPosition(0, 0), VirtualSize(100, 50));
+	
+	CHECK_EQUAL(view.intersects(Rect(VirtualPosition(10, 10), VirtualSize(5, 5))), true);
+	CHECK_EQUAL(view.intersects(Rect(VirtualPosition(-10, -10), VirtualSize(200, 200))), true);
+	CHECK_EQUAL(view.intersects(Rect(VirtualPosition(99, 49), VirtualSize(10, 10))), true);
+	CHECK_EQUAL(view.intersects(Rect(VirtualPosition(-9, 0), VirtualSize(10, 10))), true);
+	
+	// Only touching edges
+	CHECK_EQUAL(view.intersects(Rect(VirtualPosition(100, 0), VirtualSize(10, 10))), false);
+	CHECK_EQUAL(view.intersects(Rect(VirtualPosition(-10, 0), VirtualSize(10, 10))), false);
+	CHECK_EQUAL(view.intersects(Rect(VirtualPosition(0, 50), VirtualSize(10, 10))), false);
+	
+	// Empty rectangles intersect nothing
+	CHECK_EQUAL(view.intersects(Rect(VirtualPosition(10, 10), VirtualSize(0, 0))), false);
+	CHECK_EQUAL(Rect(VirtualSize(0, 0)).intersects(view), false);
+}
+
+/// Only the right half of it is solid
+class DummyShape : public Animation {
+		VirtualSize size;
+	public:
+		DummyShape(VirtualSize size) : size(size) { }
+		void renderAt(SDL_Surface* target, uint32_t ticks, VirtualPosition p) const { }
+		VirtualSize getSize() const { return size; }
+		bool hasPoint(VirtualPosition p) const {
+			return Animation::hasPoint(p) && 2 * p.getX() >= size.getX();
+		}
+};
+
+TEST(ActorIndex, getActorAt) {
+	// Drawn in this order, so c covers b covers a
+	Actor::Ptr a(new Actor("a")), b(new Actor("b")), c(new Actor("c"));
+	a->addAnimation("default", Animation::Ptr(new DummyShape(VirtualSize(400, 400))));
+	b->addAnimation("default", Animation::Ptr(new DummyShape(VirtualSize(200, 200))));
+	c->addAnimation("default", Animation::Ptr(new DummyShape(VirtualSize(100, 100))));
+	a->setPosition(VirtualPosition(200, 400)); // bounds (0, 0) - (400, 400)
+	b->setPosition(VirtualPosition(400, 500)); // (300, 300) - (500, 500)
+	c->setPosition(VirtualPosition(-50, 100)); // (-100, 0) - (0, 100)
+	
+	std::list<Actor::Ptr> actors;
+	actors.push_back(a);
+	actors.push_back(b);
+	actors.push_back(c);
+	
+	ActorIndex index;
+	index.update(actors);
+	CHECK_EQUAL(index.size(), 3U);
+	
+	CHECK_EQUAL(index.getActorAt(VirtualPosition(450, 350)), b);
+	// b's bounds but not b itself
+	CHECK_EQUAL(index.countCandidates(VirtualPosition(320, 350)), 2U);
+	CHECK_EQUAL(index.getActorAt(VirtualPosition(320, 350)), a);
+	CHECK_EQUAL(index.getActorAt(VirtualPosition(-20, 50)), c);
+	CHECK_EQUAL(index.getActorAt(VirtualPosition(100, 100)), Actor::Ptr());
+	CHECK_EQUAL(index.getActorAt(VirtualPosition(1000, 1000)), Actor::Ptr());
+	
+	// Moving
+	b->setPosition(VirtualPosition(1400, 1500));
+	index.update(actors);
+	CHECK_EQUAL(index.getActorAt(VirtualPosition(450, 350)), Actor::Ptr());
+	CHECK_EQUAL(index.getActorAt(VirtualPosition(1450, 1350)), b);
+	CHECK_EQUAL(index.countCandidates(VirtualPosition(450, 450)), 0U);
+	
+	// Depth order follows the list, removed actors are dropped
+	actors.clear();
+	actors.push_back(c);
+	actors.push_back(a);
+	index.update(actors);
+	CHECK_EQUAL(index.size(), 2U);
+	CHECK_EQUAL(index.getActorAt(VirtualPosition(1450, 1350)), Actor::Ptr());
+	c->setPosition(VirtualPosition(300, 100)); // (250, 0) - (350, 100)
+	index.update(actors);
+	CHECK_EQUAL(index.getActorAt(VirtualPosition(330, 50)), a);
+}
+
 TEST(Line, realIntersect) {
 	double eps = 1.0; //0.001;
 	Line li(VirtualPosition(0,-10), VirtualPosition(0,10));
@@ -82,6 +178,50 @@ TEST(Line, touchIntersect) {
 	}
 }
 
+TEST(Line, exactPredicates) {
+	typedef VirtualPosition P;
+	
+	CHECK_EQUAL(orientation(P(0, 0), P(10, 0), P(5, 1)), 1);
+	CHECK_EQUAL(orientation(P(0, 0), P(10, 0), P(5, -1)), -1);
+	CHECK_EQUAL(orientation(P(0, 0), P(10, 0), P(20, 0)), 0);
+	
+	// Products that don't fit into 32 bits
+	CHECK_EQUAL(orient(P(-100000, -100000), P(100000, 100000), P(100000, -100000)), (int64_t)-40000 * 1000000);
+	CHECK_EQUAL(orientation(P(0, 0), P(1000000, 999999), P(999999, 999998)), -1);
+	
+	// Still exact at the limits of the range
+	const int32_t M = MAX_COORDINATE;
+	CHECK_EQUAL(orient(P(-M, -M), P(M, M), P(M, -M)), -((int64_t)1 << 60));
+	CHECK_EQUAL(Line(P(-M, -M), P(M, M)).intersection(Line(P(-M, M), P(M, -M))), P(0, 0));
+	CHECK_EQUAL(inPredicateRange(P(M, -M)), true);
+	CHECK_EQUAL(inPredicateRange(P(M + 1, 0)), false);
+	
+	// Line widens before subtracting, so it goes up to 2^30
+	const int32_t L = (1 << 30) - 1;
+	CHECK_EQUAL(Line(P(-L, -L), P(L, L)).intersection(Line(P(-L, L), P(L, -L))), P(0, 0));
+	CHECK_EQUAL(Line(P(-L, -L), P(L, L)).intersects(Line(P(-L, L), P(L, -L))), true);
+	
+	// Comparing the dot product with the product of the lengths misses
+	// this one by rounding
+	CHECK_EQUAL(Line(P(0, 0), P(251790, 279720)).hasPoint(P(107910, 119880)), true);
+	
+	Line l(P(0, 0), P(100000, 30000));
+	CHECK_EQUAL(l.hasPoint(P(50000, 15000)), true);
+	CHECK_EQUAL(l.hasPoint(P(50000, 15001)), false);
+	CHECK_EQUAL(l.hasPoint(P(100000, 30000)), true);
+	CHECK_EQUAL(l.hasPoint(P(100010, 30003)), false);
+	CHECK_EQUAL(l.hasPoint(P(-10, -3)), false);
+	CHECK_EQUAL(Line(P(3, 3), P(3, 3)).hasPoint(P(3, 3)), true);
+	
+	CHECK_EQUAL(l.intersects(Line(P(50000, 15001), P(50000, 20000)), Line::TOUCH_OR_INTERSECT), false);
+	CHECK_EQUAL(l.intersects(Line(P(50000, 15000), P(50000, 20000)), Line::TOUCH_OR_INTERSECT), true);
+	CHECK_EQUAL(l.intersects(Line(P(50000, 15000), P(50000, 20000)), Line::REAL_INTERSECT), false);
+	CHECK_EQUAL(l.intersects(Line(P(50000, 14999), P(50000, 20000)), Line::REAL_INTERSECT), true);
+	
+	CHECK_EQUAL(l.intersection(Line(P(50000, 0), P(50000, 20000))), P(50000, 15000));
+	CHECK_EQUAL(Line(P(0, 0), P(10, 10)).intersection(Line(P(0, 10), P(10, 0))), P(5, 5));
+}
+
 TEST(Polygon, LineIterator) {
 	typedef Polygon<VirtualPosition, IsPosition> polygon_t;
 	
@@ -144,6 +284,69 @@ TEST(Polygon, orientation) {
 	CHECK_EQUAL(p.getOrientation(), polygon_t::CCW);
 }
 
+TEST(Polygon, cachedGeometry) {
+	typedef Polygon<VirtualPosition, IsPosition> polygon_t;
+	
+	polygon_t p;
+	CHECK_EQUAL(p.inBounds(VirtualPosition(0, 0)), false);
+	CHECK_EQUAL(p.hasPoint(VirtualPosition(0, 0)), false);
+	
+	// CW "L" shape, bending inwards at (10, 10)
+	p.push_back(VirtualPosition(0, 0));
+	p.push_back(VirtualPosition(20, 0));
+	p.push_back(VirtualPosition(20, 10));
+	p.push_back(VirtualPosition(10, 10));
+	p.push_back(VirtualPosition(10, 30));
+	p.push_back(VirtualPosition(0, 30));
+	
+	CHECK_EQUAL(p.getTopLeft(), VirtualPosition(0, 0));
+	CHECK_EQUAL(p.getBottomRight(), VirtualPosition(20, 30));
+	CHECK_EQUAL(p.getArea(), 400.0);
+	CHECK_EQUAL(p.getOrientation(), polygon_t::CW);
+	for(size_t i = 0; i < p.size(); ++i) {
+		CHECK_EQUAL(p.isConvex(i), i != 3);
+	}
+	
+	CHECK_EQUAL(p.inBounds(VirtualPosition(20, 30)), true);
+	CHECK_EQUAL(p.inBounds(VirtualPosition(21, 30)), false);
+	CHECK_EQUAL(p.hasPoint(VirtualPosition(5, 25)), true);
+	CHECK_EQUAL(p.hasPoint(VirtualPosition(15, 25)), false);
+	CHECK_EQUAL(p.hasPoint(VirtualPosition(25, 5)), false);
+	CHECK_EQUAL(p.hasBoundaryPoint(VirtualPosition(10, 20)), true);
+	CHECK_EQUAL(p.hasBoundaryPoint(VirtualPosition(-1, 20)), false);
+	
+	CHECK_EQUAL(p.getLineDirection(Line(VirtualPosition(10, 10), VirtualPosition(15, 15))), polygon_t::OUT);
+	CHECK_EQUAL(p.getLineDirection(Line(VirtualPosition(10, 10), VirtualPosition(5, 5))), polygon_t::IN);
+	CHECK_EQUAL(p.getLineDirection(Line(VirtualPosition(30, 10), VirtualPosition(5, 5))), polygon_t::NOT_ATTACHED);
+	CHECK_EQUAL(p.indexOf(p[3]), 3u);
+	CHECK_EQUAL(p.indexOf(VirtualPosition(5, 5)), p.size());
+	
+	// Same shape the other way round
+	polygon_t q;
+	for(size_t i = p.size(); i > 0; --i) {
+		q.push_back(p[i - 1]);
+	}
+	CHECK_EQUAL(q.getArea(), -400.0);
+	CHECK_EQUAL(q.getOrientation(), polygon_t::CCW);
+	for(size_t i = 0; i < q.size(); ++i) {
+		CHECK_EQUAL(q.isConvex(i), i != 2);
+	}
+	CHECK_EQUAL(q.isStraight(0), false);
+	
+	// A node in the middle of an edge
+	q.push_back(VirtualPosition(0, 15));
+	CHECK_EQUAL(q.isStraight(6), true);
+	CHECK_EQUAL(q.isConvex(6), true);
+	CHECK_EQUAL(q.getLineDirection(Line(VirtualPosition(10, 10), VirtualPosition(15, 15))), polygon_t::OUT);
+	CHECK_EQUAL(q.getLineDirection(Line(VirtualPosition(10, 10), VirtualPosition(5, 5))), polygon_t::IN);
+	
+	p.clear();
+	CHECK_EQUAL(p.size(), 0u);
+	CHECK_EQUAL(p.indexOf(VirtualPosition(10, 10)), 0u);
+	CHECK_EQUAL(p.getArea(), 0.0);
+	CHECK_EQUAL(p.inBounds(VirtualPosition(5, 5)), false);
+}
+
 TEST(Utils, strip) {
 	CHECK_EQUAL(lstrip(""), "");
 	CHECK_EQUAL(lstrip("foobar"), "foobar");
@@ -212,6 +415,170 @@ TEST(Utils, math) {
 }
 
 
+struct TestHeapTraits {
+	std::vector<int>* keys;
+	std::vector<size_t>* indices;
+	TestHeapTraits(std::vector<int>* keys, std::vector<size_t>* indices) : keys(keys), indices(indices) { }
+	bool less(size_t a, size_t b) const { return (*keys)[a] < (*keys)[b]; }
+	void setIndex(size_t x, size_t i) const { (*indices)[x] = i; }
+	size_t getIndex(size_t x) const { return (*indices)[x]; }
+};
+
+TEST(DirtyRegion, merge) {
+	typedef PhysicalPosition P;
+	
+	DirtyRegion region;
+	region.setBounds(P(100, 100));
+	CHECK_EQUAL(region.empty(), true);
+	
+	// Disjoint rects stay apart, overlapping and touching ones are merged
+	region.add(P(10, 10), P(10, 10));
+	region.add(P(50, 50), P(10, 10));
+	CHECK_EQUAL(region.getRects().size(), 2);
+	region.add(P(15, 15), P(10, 10));
+	CHECK_EQUAL(region.getRects().size(), 2);
+	CHECK_EQUAL(region.getArea(), 15 * 15 + 10 * 10);
+	region.add(P(25, 10), P(25, 40));
+	CHECK_EQUAL(region.getRects().size(), 1);
+	CHECK_EQUAL(region.getArea(), 50 * 50);
+	
+	// Clipped to the bounds, nothing outside of them
+	region.clear();
+	region.add(P(-20, 90), P(40, 40));
+	region.add(P(200, 10), P(10, 10));
+	CHECK_EQUAL(region.getRects().size(), 1);
+	CHECK_EQUAL(region.getRects()[0].x, 0);
+	CHECK_EQUAL(region.getRects()[0].y, 90);
+	CHECK_EQUAL(region.getArea(), 20 * 10);
+	
+	// Too many rects become one
+	region.clear();
+	for(size_t i = 0; i <= DirtyRegion::MAX_RECTS; i++) {
+		region.add(P(6 * (int)i, 3 * (int)i), P(2, 2));
+	}
+	CHECK_EQUAL(region.getRects().size(), 1);
+	CHECK_EQUAL(region.getArea(), (6 * DirtyRegion::MAX_RECTS + 2) * (3 * DirtyRegion::MAX_RECTS + 2));
+	
+	region.addAll();
+	CHECK_EQUAL(region.isAll(), true);
+	CHECK_EQUAL(region.getArea(), 100 * 100);
+	
+	// A tracker reports the old and the new area only on changes
+	DirtyTracker tracker;
+	region.clear();
+	tracker.update(region, P(10, 10), P(5, 5), false);
+	CHECK_EQUAL(region.empty(), false);
+	region.clear();
+	tracker.update(region, P(10, 10), P(5, 5), false);
+	CHECK_EQUAL(region.empty(), true);
+	tracker.update(region, P(60, 10), P(5, 5), false);
+	CHECK_EQUAL(region.getRects().size(), 2);
+	region.clear();
+	tracker.hide(region);
+	CHECK_EQUAL(region.getRects().size(), 1);
+	region.clear();
+	tracker.hide(region);
+	CHECK_EQUAL(region.empty(), true);
+}
+
+TEST(DirtyRegion, scroll) {
+	typedef PhysicalPosition P;
+	
+	DirtyRegion region;
+	region.setBounds(P(100, 100));
+	
+	DirtyTracker still, moving, fixed;
+	still.update(region, P(10, 10), P(5, 5), false);
+	moving.update(region, P(50, 10), P(5, 5), false);
+	fixed.update(region, P(80, 80), P(5, 5), false);
+	region.clear();
+	
+	// The frame moved 3 to the left, so did the first thing, the second
+	// one moved more and the third one is fixed to the screen
+	region.setScroll(P(-3, 0));
+	CHECK_EQUAL(region.getRects().size(), 1);
+	CHECK_EQUAL(region.getArea(), 3 * 100);
+	still.update(region, P(7, 10), P(5, 5), false);
+	CHECK_EQUAL(region.getRects().size(), 1);
+	moving.update(region, P(20, 10), P(5, 5), false);
+	CHECK_EQUAL(region.getRects().size(), 3);
+	fixed.update(region, P(80, 80), P(5, 5), false);
+	CHECK_EQUAL(region.getRects().size(), 4);
+	
+	// The right end of where the second one was before the scroll isn't
+	// dirty anymore
+	std::vector<SDL_Rect> rects = region.getRects();
+	for(std::vector<SDL_Rect>::iterator iter = rects.begin(); iter != rects.end(); ++iter) {
+		CHECK_EQUAL(iter->x <= 54 && iter->x + iter->w > 54 && iter->y <= 10 && iter->y + iter->h > 10, false);
+	}
+	
+	region.clear();
+	CHECK_EQUAL(region.getScroll(), P(0, 0));
+	
+	// Moving the pixels
+	SDL_Surface* s = SDL_CreateRGBSurface(SDL_SWSURFACE, 4, 3, 32, 0, 0, 0, 0);
+	uint32_t* pixels = (uint32_t*)s->pixels;
+	for(int i = 0; i < 12; i++) { pixels[(i / 4) * s->pitch / 4 + i % 4] = i; }
+	
+	scrollSurface(s, 1, 1);
+	CHECK_EQUAL(pixels[1 * s->pitch / 4 + 1], 0);
+	CHECK_EQUAL(pixels[2 * s->pitch / 4 + 3], 6);
+	CHECK_EQUAL(pixels[0 * s->pitch / 4 + 0], 0);
+	scrollSurface(s, -1, -1);
+	CHECK_EQUAL(pixels[0 * s->pitch / 4 + 0], 0);
+	CHECK_EQUAL(pixels[1 * s->pitch / 4 + 2], 6);
+	SDL_FreeSurface(s);
+}
+
+#ifndef WITH_OPENGL // surfaces would need a GL context
+TEST(Surface, flatten) {
+	typedef PhysicalPosition P;
+	
+	// Opaque red and half transparent blue, overlapping by a pixel
+	SDL_Surface* red = SDL_CreateRGBSurface(SDL_SWSURFACE, 2, 1, 32, 0xff, 0xff00, 0xff0000, 0xff000000);
+	SDL_FillRect(red, 0, SDL_MapRGBA(red->format, 255, 0, 0, 255));
+	SDL_Surface* blue = SDL_CreateRGBSurface(SDL_SWSURFACE, 2, 1, 32, 0xff, 0xff00, 0xff0000, 0xff000000);
+	SDL_FillRect(blue, 0, SDL_MapRGBA(blue->format, 0, 0, 255, 128));
+	
+	std::vector<Surface::Layer> layers;
+	layers.push_back(Surface::Layer(Surface::Ptr(new Surface(red)), P(0, 0)));
+	layers.push_back(Surface::Layer(Surface::Ptr(new Surface(blue)), P(1, 0)));
+	Surface::Ptr flat = Surface::flatten(P(4, 1), layers);
+	
+	CHECK_EQUAL(flat->getSize(), P(4, 1));
+	CHECK_EQUAL((int)flat->getAlpha(P(0, 0)), 255);
+	CHECK_EQUAL((int)flat->getAlpha(P(1, 0)), 255);
+	CHECK_EQUAL((int)flat->getAlpha(P(2, 0)), 128);
+	CHECK_EQUAL((int)flat->getAlpha(P(3, 0)), 0);
+}
+#endif
+
+TEST(IndexedHeap, decrease) {
+	int k[] = { 50, 20, 70, 10, 40, 60, 30 };
+	std::vector<int> keys(k, k + 7);
+	std::vector<size_t> indices(7);
+	IndexedHeap<size_t, TestHeapTraits> heap(TestHeapTraits(&keys, &indices));
+	
+	for(size_t i = 0; i < keys.size(); ++i) {
+		heap.push(i);
+	}
+	CHECK_EQUAL(heap.size(), 7);
+	CHECK_EQUAL(heap.top(), 3);
+	
+	keys[2] = 5;
+	heap.decrease(2);
+	keys[5] = 15;
+	heap.decrease(5);
+	
+	// (CHECK_EQUAL evaluates its arguments more than once)
+	size_t expected[] = { 2, 3, 5, 1, 6, 4, 0 };
+	for(size_t i = 0; i < 7; ++i) {
+		size_t x = heap.pop();
+		CHECK_EQUAL(x, expected[i]);
+	}
+	CHECK_EQUAL(heap.empty(), true);
+}
+
 class DummyTask : public Task {
 	public:
 		typedef boost::shared_ptr<DummyTask> Ptr;
@@ -251,6 +618,329 @@ TEST(Task, WaitTask) {
 	CHECK_LOWER(SDL_GetTicks(), now + 200);
 }
 
+TEST(WaypointGraph, build) {
+	typedef VirtualPosition P;
+	typedef WaypointGraph::Link L;
+	
+	//  0 ---- 1
+	//  |    /
+	//  |  /
+	//  2      3
+	std::vector<P> positions;
+	positions.push_back(P(0, 0));
+	positions.push_back(P(30, 0));
+	positions.push_back(P(0, 40));
+	positions.push_back(P(30, 40));
+	
+	std::vector<L> links;
+	links.push_back(L(0, 1));
+	links.push_back(L(2, 0));
+	links.push_back(L(1, 2));
+	
+	WaypointGraph g;
+	g.build(positions, links);
+	
+	CHECK_EQUAL(g.size(), 4);
+	CHECK_EQUAL(g.edgeCount(), 6);
+	CHECK_EQUAL(g.endEdges(0) - g.beginEdges(0), 2);
+	CHECK_EQUAL(g.endEdges(3) - g.beginEdges(3), 0);
+	CHECK_EQUAL(g.hasEdge(0, 1), true);
+	CHECK_EQUAL(g.hasEdge(1, 0), true);
+	CHECK_EQUAL(g.hasEdge(2, 1), true);
+	CHECK_EQUAL(g.hasEdge(0, 3), false);
+	CHECK_EQUAL(g.getEdge(g.beginEdges(1) + 1).cost, 50.0);
+	
+	// Path through the graph from a temporary source near 1 to a temporary
+	// target near 0 (which can't see each other)
+	std::vector<WaypointGraph::Edge> sourceLinks, targetLinks;
+	sourceLinks.push_back(WaypointGraph::Edge(1, 10));
+	targetLinks.push_back(WaypointGraph::Edge(0, 10));
+	
+	WaypointSearch search;
+	Path path;
+	bool found = search.findPath(g, P(30, -10), sourceLinks, P(-10, 0), targetLinks, false, path);
+	CHECK_EQUAL(found, true);
+	CHECK_EQUAL(path.size(), 3);
+	CHECK_EQUAL(path.front(), P(30, 0));
+	CHECK_EQUAL(path.back(), P(-10, 0));
+	
+	targetLinks.clear();
+	targetLinks.push_back(WaypointGraph::Edge(3, 10));
+	path.clear();
+	found = search.findPath(g, P(30, -10), sourceLinks, P(40, 40), targetLinks, false, path);
+	CHECK_EQUAL(found, false);
+	CHECK_EQUAL(path.size(), 0);
+}
+
+TEST(WaypointSearch, advance) {
+	typedef VirtualPosition P;
+
+	// 10x10 lattice, each point linked to its right and lower neighbour
+	std::vector<P> positions;
+	std::vector<WaypointGraph::Link> links;
+	for(int y = 0; y < 10; ++y) {
+		for(int x = 0; x < 10; ++x) {
+			WaypointGraph::Index i = positions.size();
+			positions.push_back(P(10 * x, 10 * y));
+			if(x < 9) { links.push_back(WaypointGraph::Link(i, i + 1)); }
+			if(y < 9) { links.push_back(WaypointGraph::Link(i, i + 10)); }
+		}
+	}
+	WaypointGraph g;
+	g.build(positions, links);
+
+	std::vector<WaypointGraph::Edge> sourceLinks, targetLinks;
+	sourceLinks.push_back(WaypointGraph::Edge(0, 5));
+	targetLinks.push_back(WaypointGraph::Edge(99, 5));
+
+	WaypointSearch whole, piecewise;
+	Path path;
+	whole.findPath(g, P(-5, 0), sourceLinks, P(95, 95), targetLinks, false, path);
+
+	piecewise.start(g, P(-5, 0), sourceLinks, P(95, 95), targetLinks, false);
+	CHECK_EQUAL(piecewise.getState(), WaypointSearch::STATE_RUNNING);
+	Path partial;
+	size_t steps = 0, detours = 0;
+	while(piecewise.advance(3) == WaypointSearch::STATE_RUNNING) {
+		steps++;
+		// Partial paths never jump, they are made of lattice links
+		partial.clear();
+		piecewise.getPartialPath(partial);
+		P prev(0, 0);
+		for(Path::const_iterator iter = partial.begin(); iter != partial.end(); ++iter) {
+			if((*iter - prev).length() > 10.001) { detours++; }
+			prev = *iter;
+		}
+	}
+	CHECK_EQUAL(piecewise.getState(), WaypointSearch::STATE_FOUND);
+	CHECK_GREATER(steps, 3);
+	CHECK_EQUAL(detours, 0);
+	CHECK_GREATER(partial.size(), 1);
+
+	Path found;
+	bool ok = piecewise.getPath(found);
+	CHECK_EQUAL(ok, true);
+	CHECK_EQUAL(found.size(), path.size());
+	CHECK_EQUAL(found.back(), P(95, 95));
+	CHECK_EQUAL(piecewise.getExpandedCount(), whole.getExpandedCount());
+}
+
+TEST(PathTask, rejoin) {
+	typedef VirtualPosition P;
+
+	// Partial path 1-2-3, final path 1-4
+	Path branch, path;
+	branch.push_back(P(10, 0)); branch.push_back(P(20, 0)); branch.push_back(P(30, 0));
+	path.push_back(P(10, 0)); path.push_back(P(10, 10));
+
+	// Still on the way to 1
+	Path r = PathTask::rejoin(branch, 3, P(0, 0), path);
+	CHECK_EQUAL(r.size(), 2);
+	CHECK_EQUAL(r.front(), P(10, 0));
+
+	// On the way to 3: back to 2 and 1, then on
+	r = PathTask::rejoin(branch, 1, P(0, 0), path);
+	CHECK_EQUAL(r.size(), 3);
+	CHECK_EQUAL(r.front(), P(20, 0));
+	CHECK_EQUAL(r.back(), P(10, 10));
+
+	// No common waypoint: back to the source
+	path.clear();
+	path.push_back(P(0, 10));
+	r = PathTask::rejoin(branch, 2, P(0, 0), path);
+	CHECK_EQUAL(r.size(), 3);
+	CHECK_EQUAL(*(++r.begin()), P(0, 0));
+	CHECK_EQUAL(r.back(), P(0, 10));
+}
+
+/// Queries can run before edge_arrays.cc is initialized
+bool queryDuringStaticInit() {
+	EdgeArrays arrays;
+	arrays.push_back(Line(VirtualPosition(0, 0), VirtualPosition(10, 0)));
+	return arrays.hasPoint(VirtualPosition(5, 0));
+}
+const bool staticQuery = queryDuringStaticInit();
+
+TEST(EdgeArrays, kernels) {
+	typedef VirtualPosition P;
+	
+	CHECK_EQUAL(staticQuery, true);
+	
+	// An odd number of edges, so the vector kernels have a remainder
+	srand(11);
+	EdgeArrays arrays;
+	std::vector<Line> edges;
+	for(int i = 0; i < 37; ++i) {
+		Line l(P(rand() % 41 - 20, rand() % 41 - 20), P(rand() % 41 - 20, rand() % 41 - 20));
+		if(i % 5 == 0) { l = Line(l.getA(), P(l.getB().getX(), l.getA().getY())); }
+		edges.push_back(l);
+		arrays.push_back(l);
+	}
+	CHECK_EQUAL(arrays.size(), edges.size());
+	CHECK_EQUAL(arrays[3], edges[3]);
+	
+	const int flags[] = { Line::REAL_INTERSECT, Line::TOUCH_OR_INTERSECT,
+		Line::THIS_INNER | Line::OTHER_INNER | Line::OTHER_BOUNDARY, Line::THIS_BOUNDARY | Line::OTHER_INNER };
+	const EdgeArrays::Kernel kernels[] = { EdgeArrays::KERNEL_SCALAR, EdgeArrays::KERNEL_SSE2, EdgeArrays::KERNEL_AVX2 };
+	EdgeArrays::Kernel initial = EdgeArrays::getKernel();
+	
+	for(size_t k = 0; k < sizeof(kernels) / sizeof(kernels[0]); ++k) {
+		if(!EdgeArrays::setKernel(kernels[k])) { continue; }
+		CHECK_EQUAL(EdgeArrays::getKernel(), kernels[k]);
+		
+		size_t mismatches = 0;
+		for(int n = 0; n < 2000; ++n) {
+			P p(rand() % 45 - 22, rand() % 45 - 22), q(rand() % 45 - 22, rand() % 45 - 22);
+			if(n % 3 == 0) { p = edges[n % edges.size()].getA() + (edges[n % edges.size()].getB() - edges[n % edges.size()].getA()) / 2.0; }
+			
+			bool onEdge = false;
+			size_t right = 0, left = 0;
+			for(size_t i = 0; i < edges.size(); ++i) {
+				P a = edges[i].getA(), b = edges[i].getB();
+				int64_t c = (int64_t)(b - a).getX() * (p - a).getY() - (int64_t)(b - a).getY() * (p - a).getX();
+				int64_t d = (b - a) * (p - a);
+				onEdge = onEdge || (c == 0 && d >= 0 && d <= (b - a) * (b - a));
+				
+				if((a.getY() < p.getY()) != (b.getY() < p.getY())) {
+					double x = a.getX() + (double)(b.getX() - a.getX()) * (p.getY() - a.getY()) / (b.getY() - a.getY());
+					if(x > p.getX()) { right++; }
+					else if(x < p.getX()) { left++; }
+				}
+			}
+			if(arrays.hasPoint(p) != onEdge) { mismatches++; }
+			
+			size_t r, l;
+			arrays.countCrossings(p, r, l);
+			if(r != right || l != left) { mismatches++; }
+			
+			for(size_t f = 0; f < sizeof(flags) / sizeof(flags[0]); ++f) {
+				bool expected = false;
+				for(size_t i = 0; i < edges.size(); ++i) {
+					expected = expected || Line(p, q).intersects(edges[i], flags[f]);
+				}
+				if(arrays.intersects(Line(p, q), flags[f]) != expected) { mismatches++; }
+			}
+			
+			// Ranges
+			bool partly = false;
+			for(size_t i = 5; i < 30; ++i) {
+				partly = partly || Line(p, q).intersects(edges[i], Line::TOUCH_OR_INTERSECT);
+			}
+			if(arrays.intersects(Line(p, q), Line::TOUCH_OR_INTERSECT, 5, 30) != partly) { mismatches++; }
+		}
+		CHECK_EQUAL(mismatches, 0u);
+	}
+	
+	// Far out coordinates take the scalar path, which must agree
+	EdgeArrays far;
+	far.push_back(Line(P(-1000000000, 0), P(1000000000, 2)));
+	CHECK_EQUAL(far.hasPoint(P(0, 1)), true);
+	CHECK_EQUAL(far.hasPoint(P(0, 2)), false);
+	CHECK_EQUAL(far.intersects(Line(P(0, -5), P(1, 5))), true);
+	
+	EdgeArrays::setKernel(initial);
+}
+
+TEST(EdgeGrid, intersects) {
+	typedef VirtualPosition P;
+	
+	// zig-zag of edges, with some sharing end points and some lying
+	// exactly on cell borders
+	std::vector<Line> edges;
+	for(int i = 0; i < 20; ++i) {
+		edges.push_back(Line(P(i * 10, (i % 2) * 50), P(i * 10 + 10, ((i + 1) % 2) * 50)));
+		edges.push_back(Line(P(i * 10, 100), P(i * 10, 120)));
+	}
+	edges.push_back(Line(P(0, 0), P(200, 0)));
+	
+	EdgeGrid grid;
+	for(size_t i = 0; i < edges.size(); ++i) {
+		grid.addEdge(edges[i]);
+	}
+	grid.build();
+	
+	srand(42);
+	int flags[] = { Line::REAL_INTERSECT, Line::TOUCH_OR_INTERSECT,
+		Line::THIS_INNER | Line::OTHER_INNER | Line::OTHER_BOUNDARY };
+	size_t mismatches = 0;
+	for(int n = 0; n < 2000; ++n) {
+		Line l(P(rand() % 240 - 20, rand() % 160 - 20), P(rand() % 240 - 20, rand() % 160 - 20));
+		for(int f = 0; f < 3; ++f) {
+			bool expected = false;
+			for(size_t i = 0; i < edges.size() && !expected; ++i) {
+				expected = l.intersects(edges[i], flags[f]);
+			}
+			if(grid.intersects(l, flags[f]) != expected) { mismatches++; }
+		}
+	}
+	CHECK_EQUAL(mismatches, 0);
+	
+	// segments along cell borders and through shared end points
+	CHECK_EQUAL(grid.intersects(Line(P(5, -10), P(5, 10)), Line::TOUCH_OR_INTERSECT), true);
+	CHECK_EQUAL(grid.intersects(Line(P(10, 60), P(10, 40)), Line::TOUCH_OR_INTERSECT), true);
+	CHECK_EQUAL(grid.intersects(Line(P(-5, 110), P(300, 110)), Line::REAL_INTERSECT), true);
+	CHECK_EQUAL(grid.intersects(Line(P(-5, 130), P(300, 130)), Line::TOUCH_OR_INTERSECT), false);
+	
+	// A segment through the whole grid meets more edges than a short one
+	size_t candidates = grid.countCandidates(Line(P(-1000, -1000), P(1000, 1000)));
+	CHECK_GREATER(candidates, 0u);
+	CHECK_LOWER(grid.countCandidates(Line(P(5, 5), P(6, 6))), candidates);
+	CHECK_EQUAL(EdgeGrid().countCandidates(Line(P(5, 5), P(6, 6))), 0u);
+}
+
+TEST(EdgeGrid, nearestPoint) {
+	typedef VirtualPosition P;
+	
+	std::vector<Line> edges;
+	for(int i = 0; i < 20; ++i) {
+		edges.push_back(Line(P(i * 10, (i % 2) * 50), P(i * 10 + 10, ((i + 1) % 2) * 50)));
+		edges.push_back(Line(P(i * 10, 100), P(i * 10 + 3, 120)));
+	}
+	
+	EdgeGrid grid;
+	for(size_t i = 0; i < edges.size(); ++i) {
+		grid.addEdge(edges[i]);
+	}
+	grid.build();
+	
+	srand(7);
+	size_t mismatches = 0;
+	for(int n = 0; n < 2000; ++n) {
+		// also points far outside of the grid
+		P p(rand() % 600 - 200, rand() % 400 - 150);
+		
+		double expected = -1.0;
+		for(size_t i = 0; i < edges.size(); ++i) {
+			double ax = edges[i].getA().getX(), ay = edges[i].getA().getY();
+			double dx = edges[i].getB().getX() - ax, dy = edges[i].getB().getY() - ay;
+			double t = ((p.getX() - ax) * dx + (p.getY() - ay) * dy) / (dx * dx + dy * dy);
+			t = std::max(0.0, std::min(1.0, t));
+			double ex = ax + t * dx - p.getX(), ey = ay + t * dy - p.getY();
+			double d = sqrt(ex * ex + ey * ey);
+			if(expected < 0.0 || d < expected) { expected = d; }
+		}
+		
+		double x, y;
+		grid.nearestPoint(p, x, y);
+		double d = sqrt((x - p.getX()) * (x - p.getX()) + (y - p.getY()) * (y - p.getY()));
+		if(d > expected + 0.0001 || d < expected - 0.0001) { mismatches++; }
+	}
+	CHECK_EQUAL(mismatches, 0);
+	
+	double x, y;
+	bool found = grid.lastCrossing(P(-10, 110), P(300, 110), x, y);
+	CHECK_EQUAL(found, true);
+	CHECK_EQUAL(x, 191.5);
+	CHECK_EQUAL(y, 110);
+	found = grid.lastCrossing(P(-10, 130), P(300, 130), x, y);
+	CHECK_EQUAL(found, false);
+	
+	EdgeGrid empty;
+	empty.build();
+	found = empty.nearestPoint(P(0, 0), x, y);
+	CHECK_EQUAL(found, false);
+}
+
 TEST(Ground, directReachable1) {
 	typedef Polygon<VirtualPosition, IsPosition> polygon_t;
 	
@@ -287,25 +977,25 @@ TEST(Ground, directReachable1) {
 	
 	Ground g;
 	
-	polygon_t p1, p2, p3;
+	polygon_t::Ptr p1(new polygon_t), p2(new polygon_t), p3(new polygon_t);
 	
-	p1.push_back(pos[P11]);
-	p1.push_back(pos[P12]);
-	p1.push_back(pos[P13]);
-	p1.push_back(pos[P14]);
-	g.addPolygon(polygon_t::Ptr(&p1));
+	p1->push_back(pos[P11]);
+	p1->push_back(pos[P12]);
+	p1->push_back(pos[P13]);
+	p1->push_back(pos[P14]);
+	g.addPolygon(p1);
 	
-	p2.push_back(pos[P21]);
-	p2.push_back(pos[P22]);
-	p2.push_back(pos[P23]);
-	p2.push_back(pos[P24]);
-	g.addPolygon(polygon_t::Ptr(&p2));
+	p2->push_back(pos[P21]);
+	p2->push_back(pos[P22]);
+	p2->push_back(pos[P23]);
+	p2->push_back(pos[P24]);
+	g.addPolygon(p2);
 	
-	p3.push_back(pos[P31]);
-	p3.push_back(pos[P32]);
-	p3.push_back(pos[P33]);
-	p3.push_back(pos[P34]);
-	g.addPolygon(polygon_t::Ptr(&p3));
+	p3->push_back(pos[P31]);
+	p3->push_back(pos[P32]);
+	p3->push_back(pos[P33]);
+	p3->push_back(pos[P34]);
+	g.addPolygon(p3);
 	
 	// Root component
 	
@@ -337,36 +1027,18 @@ TEST(Ground, directReachable1) {
 		}
 	}
 	
-	g.rootComponent->generateWaypoints();
-	
 	for(int i = 0; i<=X6; ++i) {
 		for(int j = 0; j<=X6; ++j) {
 			//bool expected = (reachable[i][j] == '1');
 			if(i <= P34 && j <= P34) {
 				//cdbg << "i=" << i << " j=" << j << "\n";
-				//cdbg
-				//	<< "wp[i]=" << g.rootComponent->waypoints[i].getPosition()
-				//	<< " wp[j]=" << g.rootComponent->waypoints[j].getPosition()
-				//	<< "\n";
 				if(reachable[i][j] == '1') {
 					info("i=%d j=%d 1", i, j);
-					CHECK_EQUAL(
-						g.directReachable(
-							g.rootComponent,
-							*g.rootComponent->getWaypoints()[i],
-							*g.rootComponent->getWaypoints()[j]
-						), 1
-					);
+					CHECK_EQUAL(g.directReachable(g.rootComponent, pos[i], pos[j]), 1);
 				}
 				else {
 					info("i=%d j=%d 0", i, j);
-					CHECK_EQUAL(
-						g.directReachable(
-							g.rootComponent,
-							*g.rootComponent->getWaypoints()[i],
-							*g.rootComponent->getWaypoints()[j]
-						), 0
-					);
+					CHECK_EQUAL(g.directReachable(g.rootComponent, pos[i], pos[j]), 0);
 				}
 			
 			} // if
@@ -394,23 +1066,1041 @@ TEST(Ground, directReachable2) {
 		P(200, 50), P(600,90) };
 	
 	Ground g;
-	polygon_t p;
+	polygon_t::Ptr p(new polygon_t);
+	
+	p->push_back(pos[0]);
+	p->push_back(pos[1]);
+	p->push_back(pos[2]);
+	p->push_back(pos[3]);
+	p->push_back(pos[4]);
+	g.addPolygon(p);
+	
+	CHECK_EQUAL(g.directReachable(g.rootComponent, pos[5], pos[0]), 1);
+	CHECK_EQUAL(g.directReachable(g.rootComponent, pos[5], pos[1]), 1);
+	CHECK_EQUAL(g.directReachable(g.rootComponent, pos[6], pos[1]), 1);
+	CHECK_EQUAL(g.directReachable(g.rootComponent, pos[6], pos[2]), 1);
+}
+
+
+TEST(Ground, getPath) {
+	typedef Polygon<VirtualPosition, IsPosition> polygon_t;
+	typedef VirtualPosition P;
+	
+	// Same layout as in directReachable1
+	polygon_t::Ptr p1(new polygon_t), p2(new polygon_t), p3(new polygon_t);
+	p1->push_back(P(0, 0)); p1->push_back(P(0, 100)); p1->push_back(P(200, 100)); p1->push_back(P(200, 0));
+	p2->push_back(P(20, 20)); p2->push_back(P(80, 20)); p2->push_back(P(80, 80)); p2->push_back(P(20, 80));
+	p3->push_back(P(180, 80)); p3->push_back(P(180, 20)); p3->push_back(P(120, 20)); p3->push_back(P(120, 80));
+	
+	Ground g;
+	g.addPolygon(p1);
+	g.addPolygon(p2);
+	g.addPolygon(p3);
+	
+	CHECK_EQUAL(g.rootComponent->hasValidMap(), false);
+	g.generateMap();
+	CHECK_EQUAL(g.rootComponent->hasValidMap(), true);
+	// The corners of the outer rectangle can't be on any shortest path
+	CHECK_EQUAL(g.rootComponent->getGraph().size(), 8);
+	size_t edgeCount = g.rootComponent->getGraph().edgeCount();
+	
+	// around the upper side of the left hole
+	Path path;
+	g.getPath(P(10, 50), P(100, 40), path);
+	CHECK_EQUAL(path.size(), 3);
+	CHECK_EQUAL(path.front(), P(20, 20));
+	CHECK_EQUAL(path.back(), P(100, 40));
+	
+	// directly reachable
+	path.clear();
+	g.getPath(P(10, 50), P(10, 90), path);
+	CHECK_EQUAL(path.size(), 1);
+	CHECK_EQUAL(path.back(), P(10, 90));
+	
+	// The map must survive the queries unchanged
+	CHECK_EQUAL(g.rootComponent->hasValidMap(), true);
+	CHECK_EQUAL(g.rootComponent->getGraph().size(), 8);
+	CHECK_EQUAL(g.rootComponent->getGraph().edgeCount(), edgeCount);
+	
+	// Adding a polygon invalidates it
+	polygon_t::Ptr p4(new polygon_t);
+	p4->push_back(P(90, 60)); p4->push_back(P(110, 60)); p4->push_back(P(110, 70)); p4->push_back(P(90, 70));
+	g.addPolygon(p4);
+	CHECK_EQUAL(g.rootComponent->hasValidMap(), false);
+	
+	path.clear();
+	g.getPath(P(10, 50), P(100, 40), path);
+	CHECK_EQUAL(g.rootComponent->hasValidMap(), true);
+	CHECK_EQUAL(g.rootComponent->getGraph().size(), 12);
+	CHECK_EQUAL(path.size(), 3);
+}
+
+
+TEST(Ground, reflexWaypoints) {
+	typedef Polygon<VirtualPosition, IsPosition> polygon_t;
+	typedef VirtualPosition P;
 	
-	p.push_back(pos[0]);
-	p.push_back(pos[1]);
-	p.push_back(pos[2]);
-	p.push_back(pos[3]);
-	p.push_back(pos[4]);
-	g.addPolygon(polygon_t::Ptr(&p));
-	
-	g.rootComponent->generateWaypoints();
-	g.rootComponent->createWaypoint(pos[5]);
-	g.rootComponent->createWaypoint(pos[6]);
-	
-	CHECK_EQUAL(g.directReachable(g.rootComponent, *g.rootComponent->getWaypoints()[5], *g.rootComponent->getWaypoints()[0]), 1);
-	CHECK_EQUAL(g.directReachable(g.rootComponent, *g.rootComponent->getWaypoints()[5], *g.rootComponent->getWaypoints()[1]), 1);
-	CHECK_EQUAL(g.directReachable(g.rootComponent, *g.rootComponent->getWaypoints()[6], *g.rootComponent->getWaypoints()[1]), 1);
-	CHECK_EQUAL(g.directReachable(g.rootComponent, *g.rootComponent->getWaypoints()[6], *g.rootComponent->getWaypoints()[2]), 1);
+	/*
+	 * L-shaped room, only the inner corner p is a waypoint
+	 * 
+	 *   +------------+
+	 *   |            |
+	 *   |      p-----+
+	 *   |      |
+	 *   +------+
+	 */
+	
+	for(int reverse = 0; reverse < 2; ++reverse) {
+		P corners[] = { P(0, 0), P(100, 0), P(100, 50), P(50, 50), P(50, 100), P(0, 100) };
+		polygon_t::Ptr room(new polygon_t);
+		for(int i = 0; i < 6; ++i) {
+			room->push_back(corners[reverse ? 5 - i : i]);
+		}
+		
+		// small square obstacle, all corners are waypoints
+		polygon_t::Ptr box(new polygon_t);
+		box->push_back(P(10, 10)); box->push_back(P(20, 10)); box->push_back(P(20, 20)); box->push_back(P(10, 20));
+		
+		Ground g;
+		g.addPolygon(room);
+		g.addPolygon(box);
+		g.generateMap();
+		CHECK_EQUAL(g.rootComponent->getGraph().size(), 5);
+		CHECK_EQUAL(g.rootComponent->getGraph().getPosition(0), P(50, 50));
+		
+		Path path;
+		g.getPath(P(90, 30), P(30, 90), path);
+		CHECK_EQUAL(path.size(), 2);
+		CHECK_EQUAL(path.front(), P(50, 50));
+		CHECK_EQUAL(path.back(), P(30, 90));
+	}
+}
+
+TEST(Ground, rotationalSweep) {
+	typedef Polygon<VirtualPosition, IsPosition> polygon_t;
+	typedef VirtualPosition P;
+
+	// Star shaped rooms with boxes and triangles on a coarse lattice, so
+	// there are lots of collinear corners and lines through corners
+	P directions[] = { P(10, 0), P(9, 4), P(7, 7), P(4, 9), P(0, 10), P(-4, 9), P(-7, 7), P(-9, 4),
+		P(-10, 0), P(-9, -4), P(-7, -7), P(-4, -9), P(0, -10), P(4, -9), P(7, -7), P(9, -4) };
+
+	srand(23);
+	size_t mismatches = 0, links = 0;
+	for(int n = 0; n < 30; ++n) {
+		std::vector<polygon_t::Ptr> polygons;
+
+		polygon_t::Ptr room(new polygon_t);
+		for(int i = 0; i < 16; ++i) {
+			room->push_back(directions[(n % 2) ? 15 - i : i] * (20 + rand() % 5 * 5));
+		}
+		polygons.push_back(room);
+
+		for(int x = -120; x < 120; x += 40) {
+			for(int y = -120; y < 120; y += 40) {
+				int kind = rand() % 3;
+				int x0 = x + 5 + rand() % 3 * 5, y0 = y + 5 + rand() % 3 * 5;
+				int x1 = x + 25 + rand() % 3 * 5, y1 = y + 25 + rand() % 3 * 5;
+				polygon_t::Ptr hole(new polygon_t);
+				if(kind == 0) { continue; }
+				hole->push_back(P(x0, y0));
+				hole->push_back(P(x1, y0));
+				if(kind == 1) { hole->push_back(P(x1, y1)); }
+				hole->push_back(P(x0, y1));
+				polygons.push_back(hole);
+			}
+		}
+
+		Ground brute, sweep;
+		sweep.setMapBuilder(Ground::BUILDER_ROTATIONAL_SWEEP);
+		for(size_t i = 0; i < polygons.size(); ++i) {
+			brute.addPolygon(polygons[i]);
+			sweep.addPolygon(polygons[i]);
+		}
+		brute.generateMap();
+		sweep.generateMap();
+
+		const WaypointGraph &a = brute.rootComponent->getGraph(), &b = sweep.rootComponent->getGraph();
+		CHECK_EQUAL(a.size(), b.size());
+		CHECK_EQUAL(a.edgeCount(), b.edgeCount());
+		for(WaypointGraph::Index i = 0; i < a.size(); ++i) {
+			for(WaypointGraph::Index j = 0; j < a.size(); ++j) {
+				if(a.hasEdge(i, j) != b.hasEdge(i, j)) { mismatches++; }
+			}
+		}
+		links += a.edgeCount();
+	}
+	CHECK_EQUAL(mismatches, 0);
+	CHECK_GREATER(links, 0);
+}
+
+TEST(Ground, mapThreads) {
+	typedef Polygon<VirtualPosition, IsPosition> polygon_t;
+	typedef VirtualPosition P;
+
+	std::vector<polygon_t::Ptr> polygons;
+	polygon_t::Ptr room(new polygon_t);
+	room->push_back(P(0, 0)); room->push_back(P(1000, 0)); room->push_back(P(1000, 1000)); room->push_back(P(0, 1000));
+	polygons.push_back(room);
+	for(int x = 50; x < 950; x += 100) {
+		for(int y = 50; y < 950; y += 100) {
+			polygon_t::Ptr box(new polygon_t);
+			box->push_back(P(x + x % 30, y)); box->push_back(P(x + 50, y + y % 20));
+			box->push_back(P(x + 50, y + 50)); box->push_back(P(x, y + 40));
+			polygons.push_back(box);
+		}
+	}
+
+	Ground::MapBuilder builders[] = { Ground::BUILDER_BRUTE_FORCE, Ground::BUILDER_ROTATIONAL_SWEEP };
+	for(int b = 0; b < 2; ++b) {
+		Ground single, multi;
+		single.setMapBuilder(builders[b]);
+		multi.setMapBuilder(builders[b]);
+		multi.setMapThreads(4);
+		for(size_t i = 0; i < polygons.size(); ++i) {
+			single.addPolygon(polygons[i]);
+			multi.addPolygon(polygons[i]);
+		}
+		single.generateMap();
+		multi.generateMap();
+
+		// Not only the same links but also in the same order
+		const WaypointGraph &s = single.rootComponent->getGraph(), &m = multi.rootComponent->getGraph();
+		CHECK_GREATER(s.edgeCount(), 0);
+		CHECK_EQUAL(s.edgeCount(), m.edgeCount());
+		size_t mismatches = 0;
+		for(WaypointGraph::Index i = 0; i < s.edgeCount(); ++i) {
+			if(s.getEdge(i).target != m.getEdge(i).target) { mismatches++; }
+		}
+		CHECK_EQUAL(mismatches, 0);
+	}
+}
+
+TEST(NavMesh, build) {
+	typedef Polygon<VirtualPosition, IsPosition> polygon_t;
+	typedef VirtualPosition P;
+
+	// room with two holes and a flat corner, both orientations
+	for(int reverse = 0; reverse < 2; ++reverse) {
+		P corners[] = { P(0, 0), P(50, 0), P(100, 0), P(100, 100), P(0, 100) };
+		polygon_t room;
+		for(int i = 0; i < 5; ++i) {
+			room.push_back(corners[reverse ? 4 - i : i]);
+		}
+		polygon_t box1, box2;
+		box1.push_back(P(10, 10)); box1.push_back(P(20, 10)); box1.push_back(P(20, 20)); box1.push_back(P(10, 20));
+		box2.push_back(P(60, 60)); box2.push_back(P(60, 80)); box2.push_back(P(80, 80)); box2.push_back(P(80, 60));
+		std::vector<const polygon_t*> holes;
+		holes.push_back(&box1);
+		holes.push_back(&box2);
+
+		NavMesh mesh;
+		mesh.build(room, holes);
+
+		// n + 2h - 2 triangles, covering exactly the walkable area, and
+		// one wall per polygon edge
+		CHECK_EQUAL(mesh.size(), 15);
+		int64_t area = 0;
+		size_t walls = 0, negative = 0;
+		for(NavMesh::Index i = 0; i < mesh.size(); ++i) {
+			const NavMesh::Triangle &t = mesh.getTriangle(i);
+			int64_t a = (int64_t)(t.corners[1] - t.corners[0]).cross(t.corners[2] - t.corners[0]);
+			if(a < 0) { negative++; }
+			area += a;
+			for(int k = 0; k < 3; ++k) {
+				if(t.neighbours[k] == NavMesh::NO_INDEX) { walls++; }
+			}
+		}
+		CHECK_EQUAL(negative, 0);
+		CHECK_EQUAL(area, 2 * (10000 - 100 - 400));
+		CHECK_EQUAL(walls, 13);
+
+		CHECK_EQUAL(mesh.locate(P(15, 15)), NavMesh::NO_INDEX);
+		CHECK_EQUAL(mesh.locate(P(200, 50)), NavMesh::NO_INDEX);
+		CHECK_LOWER(mesh.locate(P(50, 50)), mesh.size());
+	}
+}
+
+TEST(NavMesh, notSimple) {
+	typedef Polygon<VirtualPosition, IsPosition> polygon_t;
+	typedef VirtualPosition P;
+
+	// A wall sticking into the room from the left, both of its sides on
+	// the outer boundary, so the polygon touches itself
+	polygon_t::Ptr room(new polygon_t);
+	P corners[] = { P(0, 0), P(40, 0), P(40, 40), P(0, 40), P(0, 20), P(20, 20), P(0, 20) };
+	for(int i = 0; i < 7; ++i) {
+		room->push_back(corners[i]);
+	}
+	NavMesh mesh;
+	bool ok = mesh.build(*room, std::vector<const polygon_t*>());
+	CHECK_EQUAL(ok, false);
+	CHECK_EQUAL(mesh.size(), 0);
+
+	// A hole touching the outer boundary
+	polygon_t square, hole;
+	square.push_back(P(0, 0)); square.push_back(P(40, 0)); square.push_back(P(40, 40)); square.push_back(P(0, 40));
+	hole.push_back(P(10, 10)); hole.push_back(P(40, 20)); hole.push_back(P(10, 30));
+	std::vector<const polygon_t*> holes(1, &hole);
+	ok = mesh.build(square, holes);
+	CHECK_EQUAL(ok, false);
+	ok = mesh.build(square, std::vector<const polygon_t*>());
+	CHECK_EQUAL(ok, true);
+
+	// The ground searches those on the waypoint map instead. Two
+	// triangles touching at (20, 20):
+	polygon_t::Ptr pinched(new polygon_t);
+	P pinch[] = { P(0, 0), P(40, 0), P(20, 20), P(40, 40), P(0, 40), P(20, 20) };
+	for(int i = 0; i < 6; ++i) {
+		pinched->push_back(pinch[i]);
+	}
+	Ground g, reference;
+	g.setEngine(Ground::ENGINE_NAVMESH);
+	g.addPolygon(pinched);
+	reference.addPolygon(pinched);
+	Path path, expected;
+	g.getPath(P(10, 5), P(30, 5), path);
+	reference.getPath(P(10, 5), P(30, 5), expected);
+	CHECK_EQUAL(g.rootComponent->hasValidNavMesh(), true);
+	CHECK_EQUAL(g.rootComponent->getNavMesh().size(), 0);
+	CHECK_EQUAL(path.size(), 1);
+	CHECK_EQUAL(path == expected, true);
+}
+
+TEST(Ground, navMesh) {
+	typedef Polygon<VirtualPosition, IsPosition> polygon_t;
+	typedef VirtualPosition P;
+
+	// L-shaped room with a box, see Ground.reflexWaypoints
+	P corners[] = { P(0, 0), P(100, 0), P(100, 50), P(50, 50), P(50, 100), P(0, 100) };
+	polygon_t::Ptr room(new polygon_t);
+	for(int i = 0; i < 6; ++i) {
+		room->push_back(corners[i]);
+	}
+	polygon_t::Ptr box(new polygon_t);
+	box->push_back(P(10, 10)); box->push_back(P(20, 10)); box->push_back(P(20, 20)); box->push_back(P(10, 20));
+
+	Ground g;
+	g.setEngine(Ground::ENGINE_NAVMESH);
+	g.addPolygon(room);
+	g.addPolygon(box);
+	g.generateMap();
+	CHECK_EQUAL(g.rootComponent->hasValidNavMesh(), true);
+	CHECK_EQUAL(g.rootComponent->hasValidMap(), false);
+
+	Path path;
+	g.getPath(P(90, 30), P(30, 90), path);
+	CHECK_EQUAL(path.size(), 2);
+	CHECK_EQUAL(path.front(), P(50, 50));
+	CHECK_EQUAL(path.back(), P(30, 90));
+
+	path.clear();
+	g.getPath(P(5, 30), P(30, 5), path);
+	CHECK_EQUAL(path.size(), 2);
+	CHECK_EQUAL(path.front(), P(10, 10));
+
+	path.clear();
+	g.getPath(P(30, 30), P(40, 40), path);
+	CHECK_EQUAL(path.size(), 1);
+
+	// Paths never cross walls and are never shorter than the shortest ones
+	// (reused paths don't need to be the shortest ones)
+	Ground v;
+	v.addPolygon(room);
+	v.addPolygon(box);
+	g.setPathCacheSize(0);
+	v.setPathCacheSize(0);
+	srand(5);
+	size_t crossings = 0, tooShort = 0;
+	for(int n = 0; n < 200; ++n) {
+		P source(rand() % 100, rand() % 100), target(rand() % 100, rand() % 100);
+		if(!g.isWalkable(g.rootComponent, source) || !g.isWalkable(g.rootComponent, target)) { continue; }
+
+		Path p1, p2;
+		g.getPath(source, target, p1);
+		v.getPath(source, target, p2);
+		CHECK_EQUAL(p1.back(), target);
+
+		double l1 = 0, l2 = 0;
+		P prev = source;
+		for(Path::const_iterator iter = p1.begin(); iter != p1.end(); ++iter) {
+			l1 += (*iter - prev).length();
+			for(size_t i = 0; i < g.rootComponent->getEdgeGrid().edgeCount(); ++i) {
+				if(Line(prev, *iter).intersects(g.rootComponent->getEdgeGrid().getEdge(i))) { crossings++; }
+			}
+			prev = *iter;
+		}
+		prev = source;
+		for(Path::const_iterator iter = p2.begin(); iter != p2.end(); ++iter) {
+			l2 += (*iter - prev).length();
+			prev = *iter;
+		}
+		if(l1 < l2 - 0.001) { tooShort++; }
+	}
+	CHECK_EQUAL(crossings, 0);
+	CHECK_EQUAL(tooShort, 0);
+}
+
+TEST(GridMap, distances) {
+	typedef VirtualPosition P;
+
+	// left half walkable, a wall in column 2 with a gap in row 9
+	GridMap grid(P(0, 0), P(100, 100), 10, 10);
+	for(int32_t row = 0; row < 10; ++row) {
+		for(int32_t column = 0; column < 5; ++column) {
+			grid.setWalkable(column, row, column != 2 || row == 9);
+		}
+	}
+	grid.update();
+	CHECK_EQUAL(grid.getMemoryUsage(), 10 * 4 + 100 * 2);
+	CHECK_EQUAL(grid.isWalkable(4, 3), true);
+	CHECK_EQUAL(grid.isWalkable(2, 3), false);
+	CHECK_EQUAL(grid.isWalkable(-1, 3), false);
+	CHECK_EQUAL(grid.getDistance(4, 3), 0);
+	CHECK_EQUAL(grid.getDistance(5, 3), 3);
+	CHECK_EQUAL(grid.getDistance(9, 0), 15);
+	CHECK_EQUAL(grid.getDistance(2, 3), 3);
+
+	int32_t column, row;
+	bool found = grid.findNearestWalkable(P(95, 55), column, row);
+	CHECK_EQUAL(found, true);
+	CHECK_EQUAL(column, 4);
+	CHECK_EQUAL(row, 5);
+	found = grid.findNearestWalkable(P(-50, 1000), column, row);
+	CHECK_EQUAL(column, 0);
+	CHECK_EQUAL(row, 9);
+	CHECK_EQUAL(grid.getCenter(0, 9), P(5, 95));
+
+	CHECK_EQUAL(grid.isVisible(0, 0, 1, 9), true);
+	CHECK_EQUAL(grid.isVisible(0, 0, 4, 0), false);
+	CHECK_EQUAL(grid.isVisible(0, 9, 4, 9), true);
+	CHECK_EQUAL(grid.isVisible(1, 8, 3, 9), false);
+	// passes exactly through the corner of the wall
+	CHECK_EQUAL(grid.isVisible(3, 8, 2, 9), false);
+	CHECK_EQUAL(grid.isVisible(3, 9, 2, 9), true);
+
+	GridMap empty(P(0, 0), P(100, 100), 10, 10);
+	empty.update();
+	found = empty.findNearestWalkable(P(50, 50), column, row);
+	CHECK_EQUAL(found, false);
+}
+
+TEST(GridMap, jumpPointSearch) {
+	typedef VirtualPosition P;
+	const int32_t W = 60, H = 40;
+
+	// Random blocks plus two long walls, cells twice as wide as high
+	GridMap grid(P(100, 50), P(W * 10, H * 5), W, H);
+	srand(17);
+	for(int32_t row = 0; row < H; ++row) {
+		for(int32_t column = 0; column < W; ++column) {
+			bool wall = (column == 20 && row < 35) || (column == 40 && row > 5);
+			grid.setWalkable(column, row, !wall && rand() % 4 != 0);
+		}
+	}
+	grid.update();
+
+	// Dijkstra on all cells, without cutting corners
+	const double D = sqrt(10.0 * 10.0 + 5.0 * 5.0);
+	size_t mismatches = 0, tooLong = 0, blocked = 0;
+	GridSearch search;
+	for(int n = 0; n < 40; ++n) {
+		int32_t sc = rand() % W, sr = rand() % H, tc = rand() % W, tr = rand() % H;
+		if(!grid.isWalkable(sc, sr) || !grid.isWalkable(tc, tr)) { continue; }
+
+		std::vector<double> costs(W * H, -1.0);
+		std::vector<bool> done(W * H, false);
+		std::priority_queue<std::pair<double, int32_t>, std::vector<std::pair<double, int32_t> >, std::greater<std::pair<double, int32_t> > > queue;
+		costs[sr * W + sc] = 0;
+		queue.push(std::make_pair(0.0, sr * W + sc));
+		while(!queue.empty()) {
+			int32_t i = queue.top().second;
+			queue.pop();
+			if(done[i]) { continue; }
+			done[i] = true;
+			int32_t c = i % W, r = i / W;
+			for(int32_t dy = -1; dy <= 1; ++dy) {
+				for(int32_t dx = -1; dx <= 1; ++dx) {
+					if(!grid.isWalkable(c + dx, r + dy)) { continue; }
+					if(dx != 0 && dy != 0 && (!grid.isWalkable(c + dx, r) || !grid.isWalkable(c, r + dy))) { continue; }
+					double cost = costs[i] + ((dx != 0 && dy != 0) ? D : (dx != 0 ? 10.0 : 5.0));
+					int32_t j = (r + dy) * W + c + dx;
+					if(costs[j] < 0 || cost < costs[j]) {
+						costs[j] = cost;
+						queue.push(std::make_pair(cost, j));
+					}
+				}
+			}
+		}
+
+		P source = grid.getCenter(sc, sr), target = grid.getCenter(tc, tr);
+		Path path;
+		bool found = search.findPath(grid, source, target, path);
+		double expected = costs[tr * W + tc];
+		if(found != (expected >= 0)) { mismatches++; }
+		if(!found) { continue; }
+		if(path.back() != target) { mismatches++; }
+
+		// Paths go from cell center to cell center, allow for rounding
+		double length = 0;
+		P prev = source;
+		for(Path::const_iterator iter = path.begin(); iter != path.end(); ++iter) {
+			int32_t c1, r1, c2, r2;
+			grid.getCell(prev, c1, r1);
+			grid.getCell(*iter, c2, r2);
+			if(!grid.isVisible(c1, r1, c2, r2)) { blocked++; }
+			length += (*iter - prev).length();
+			prev = *iter;
+		}
+		if(length > expected + path.size()) { tooLong++; }
+	}
+	CHECK_EQUAL(mismatches, 0);
+	CHECK_EQUAL(tooLong, 0);
+	CHECK_EQUAL(blocked, 0);
+
+	// Off the grid and inside of a wall
+	GridMap walls(P(100, 50), P(W * 10, H * 5), W, H);
+	for(int32_t row = 0; row < H; ++row) {
+		for(int32_t column = 0; column < W; ++column) {
+			walls.setWalkable(column, row, !(column == 20 && row < 35) && !(column == 40 && row > 5));
+		}
+	}
+	walls.update();
+	Path path;
+	bool found = search.findPath(walls, P(0, 0), walls.getCenter(40, 20), path);
+	CHECK_EQUAL(found, true);
+	CHECK_EQUAL(path.front(), walls.getCenter(0, 0));
+	CHECK_EQUAL(path.back(), walls.getCenter(39, 20));
+	CHECK_EQUAL(path.size(), 4);
+}
+
+TEST(Ground, gridEngine) {
+	typedef Polygon<VirtualPosition, IsPosition> polygon_t;
+	typedef VirtualPosition P;
+
+	// The same ground as polygons and as a grid
+	polygon_t::Ptr room(new polygon_t);
+	room->push_back(P(0, 0)); room->push_back(P(400, 0)); room->push_back(P(400, 200)); room->push_back(P(0, 200));
+	polygon_t::Ptr box(new polygon_t);
+	box->push_back(P(100, 40)); box->push_back(P(300, 40)); box->push_back(P(300, 160)); box->push_back(P(100, 160));
+
+	GridMap::Ptr grid(new GridMap(P(0, 0), P(400, 200), 200, 100));
+	grid->fill(*room, true);
+	grid->fill(*box, false);
+	grid->update();
+
+	Ground g, polygons;
+	g.addPolygon(room);
+	g.addPolygon(box);
+	polygons.addPolygon(room);
+	polygons.addPolygon(box);
+	g.setGrid(grid);
+	g.setEngine(Ground::ENGINE_GRID);
+	g.setPathCacheSize(0);
+	polygons.setPathCacheSize(0);
+
+	srand(23);
+	size_t tooLong = 0, mismatches = 0;
+	for(int n = 0; n < 50; ++n) {
+		P source(rand() % 400, rand() % 200), target(rand() % 400, rand() % 200);
+		if(!polygons.isWalkable(polygons.rootComponent, source) || !polygons.isWalkable(polygons.rootComponent, target)) { continue; }
+
+		Path p1, p2;
+		g.getPath(source, target, p1);
+		polygons.getPath(source, target, p2);
+		if(p1.empty() != p2.empty()) { mismatches++; }
+
+		double l1 = 0, l2 = 0;
+		P prev = source;
+		for(Path::const_iterator iter = p1.begin(); iter != p1.end(); ++iter) {
+			l1 += (*iter - prev).length();
+			prev = *iter;
+		}
+		prev = source;
+		for(Path::const_iterator iter = p2.begin(); iter != p2.end(); ++iter) {
+			l2 += (*iter - prev).length();
+			prev = *iter;
+		}
+		// the grid keeps a cell away from the box
+		if(l1 > l2 * 1.05 + 10) { tooLong++; }
+	}
+	CHECK_EQUAL(mismatches, 0);
+	CHECK_EQUAL(tooLong, 0);
+
+	Ground copy(g);
+	Ground::SearchSpace space;
+	Path p1, p2;
+	g.getPath(P(10, 100), P(390, 100), p1);
+	copy.findPath(P(10, 100), P(390, 100), space, p2);
+	CHECK_EQUAL(p1 == p2, true);
+	CHECK_EQUAL(p1.size(), 3);
+}
+
+TEST(Ground, pathCache) {
+	typedef Polygon<VirtualPosition, IsPosition> polygon_t;
+	typedef VirtualPosition P;
+
+	P corners[] = { P(0, 0), P(100, 0), P(100, 50), P(50, 50), P(50, 100), P(0, 100) };
+	polygon_t::Ptr room(new polygon_t);
+	for(int i = 0; i < 6; ++i) {
+		room->push_back(corners[i]);
+	}
+
+	Ground g;
+	g.addPolygon(room);
+
+	Path path;
+	g.getPath(P(90, 30), P(30, 90), path);
+	CHECK_EQUAL(path.size(), 2);
+	CHECK_EQUAL(g.getPathCache().getHits(), 0);
+
+	// Same query and one from about the same place
+	Path again;
+	g.getPath(P(90, 30), P(30, 90), again);
+	CHECK_EQUAL(g.getPathCache().getHits(), 1);
+	CHECK_EQUAL(again.size(), 2);
+	CHECK_EQUAL(again.front(), path.front());
+
+	Path near;
+	g.getPath(P(89, 31), P(31, 89), near);
+	CHECK_EQUAL(g.getPathCache().getHits(), 2);
+	CHECK_EQUAL(near.size(), 2);
+	CHECK_EQUAL(near.back(), P(31, 89));
+
+	// New obstacle in the way, cached paths must not be used anymore
+	uint32_t version = g.getVersion();
+	polygon_t::Ptr box(new polygon_t);
+	box->push_back(P(35, 40)); box->push_back(P(49, 40)); box->push_back(P(49, 55)); box->push_back(P(35, 55));
+	g.addPolygon(box);
+	CHECK_GREATER(g.getVersion(), version);
+
+	Path blocked;
+	g.getPath(P(90, 30), P(30, 90), blocked);
+	CHECK_EQUAL(g.getPathCache().getHits(), 2);
+	CHECK_GREATER(blocked.size(), 2);
+	CHECK_EQUAL(blocked.back(), P(30, 90));
+
+	// From off the ground the path is cached under the point it starts
+	// from, whether the search finishes right away or not
+	Ground::Engine engines[] = { Ground::ENGINE_VISIBILITY_GRAPH, Ground::ENGINE_NAVMESH };
+	for(int i = 0; i < 2; ++i) {
+		Ground h;
+		h.setEngine(engines[i]);
+		h.addPolygon(room);
+		Path outside, again;
+		h.getPath(P(130, 30), P(30, 90), outside);
+		h.getPath(P(130, 30), P(30, 90), again);
+		CHECK_EQUAL(h.getPathCache().getHits(), 1);
+		CHECK_EQUAL(again == outside, true);
+	}
+}
+
+/**
+ * Number of differences (missing, surplus or moved waypoints or links)
+ * between two maps.
+ */
+size_t mapDifferences(const WaypointGraph& a, const WaypointGraph& b) {
+	if(a.size() != b.size()) { return a.size() > b.size() ? a.size() - b.size() : b.size() - a.size(); }
+	size_t r = 0;
+	for(WaypointGraph::Index i = 0; i < a.size(); ++i) {
+		if(a.getPosition(i) != b.getPosition(i)) { r++; }
+		for(WaypointGraph::Index j = 0; j < a.size(); ++j) {
+			if(a.hasEdge(i, j) != b.hasEdge(i, j)) { r++; }
+		}
+	}
+	return r;
+}
+
+/**
+ * The polygons of a 200x200 square room (first) with a 3x3 lattice of
+ * 20x30 boxes in it.
+ */
+void latticeRoom(std::vector<Polygon<VirtualPosition, IsPosition>::Ptr>& polygons) {
+	typedef Polygon<VirtualPosition, IsPosition> polygon_t;
+	typedef VirtualPosition P;
+
+	polygon_t::Ptr room(new polygon_t);
+	room->push_back(P(0, 0)); room->push_back(P(200, 0)); room->push_back(P(200, 200)); room->push_back(P(0, 200));
+	polygons.push_back(room);
+	for(int x = 30; x < 200; x += 60) {
+		for(int y = 30; y < 200; y += 60) {
+			polygon_t::Ptr box(new polygon_t);
+			box->push_back(P(x, y)); box->push_back(P(x + 20, y)); box->push_back(P(x + 20, y + 30)); box->push_back(P(x, y + 30));
+			polygons.push_back(box);
+		}
+	}
+}
+
+TEST(Ground, obstacles) {
+	typedef Polygon<VirtualPosition, IsPosition> polygon_t;
+	typedef VirtualPosition P;
+
+	std::vector<polygon_t::Ptr> polygons;
+	polygon_t::Ptr room(new polygon_t);
+	room->push_back(P(0, 0)); room->push_back(P(200, 0)); room->push_back(P(200, 200)); room->push_back(P(0, 200));
+	polygons.push_back(room);
+	for(int x = 30; x < 200; x += 60) {
+		polygon_t::Ptr box(new polygon_t);
+		box->push_back(P(x, 30)); box->push_back(P(x + 20, 30)); box->push_back(P(x + 20, 60)); box->push_back(P(x, 60));
+		polygons.push_back(box);
+	}
+
+	polygon_t::Ptr a(new polygon_t);
+	a->push_back(P(90, 120)); a->push_back(P(110, 120)); a->push_back(P(110, 140)); a->push_back(P(90, 140));
+	polygon_t::Ptr b(new polygon_t);
+	b->push_back(P(20, 150)); b->push_back(P(50, 150)); b->push_back(P(35, 170));
+	polygon_t::Ptr outside(new polygon_t);
+	outside->push_back(P(300, 300)); outside->push_back(P(310, 300)); outside->push_back(P(310, 310));
+
+	Ground g, withA, withB, withAB;
+	for(size_t i = 0; i < polygons.size(); ++i) {
+		g.addPolygon(polygons[i]);
+		withA.addPolygon(polygons[i]);
+		withB.addPolygon(polygons[i]);
+		withAB.addPolygon(polygons[i]);
+	}
+	withA.addPolygon(a);
+	withB.addPolygon(b);
+	withAB.addPolygon(a);
+	withAB.addPolygon(b);
+	withA.generateMap();
+	withB.generateMap();
+	withAB.generateMap();
+	g.generateMap();
+	Ground::Component *c = g.rootComponent;
+	WaypointGraph empty = c->getGraph();
+
+	Path path;
+	g.getPath(P(100, 100), P(100, 160), path);
+	CHECK_EQUAL(path.size(), 1);
+
+	// The updated maps are the same as if the obstacles had been there
+	// from the start
+	bool ok = g.addObstacle(a);
+	CHECK_EQUAL(ok, true);
+	CHECK_EQUAL(c->hasValidMap(), true);
+	CHECK_EQUAL(mapDifferences(c->getGraph(), withA.rootComponent->getGraph()), 0);
+	ok = g.addObstacle(b);
+	CHECK_EQUAL(ok, true);
+	CHECK_EQUAL(mapDifferences(c->getGraph(), withAB.rootComponent->getGraph()), 0);
+
+	path.clear();
+	g.getPath(P(100, 100), P(100, 160), path);
+	CHECK_EQUAL(path.size(), 3);
+	CHECK_EQUAL(path.back(), P(100, 160));
+
+	ok = g.removeObstacle(a);
+	CHECK_EQUAL(ok, true);
+	CHECK_EQUAL(mapDifferences(c->getGraph(), withB.rootComponent->getGraph()), 0);
+	ok = g.removeObstacle(a);
+	CHECK_EQUAL(ok, false);
+	ok = g.removeObstacle(b);
+	CHECK_EQUAL(ok, true);
+	CHECK_EQUAL(mapDifferences(c->getGraph(), empty), 0);
+
+	path.clear();
+	g.getPath(P(100, 100), P(100, 160), path);
+	CHECK_EQUAL(path.size(), 1);
+
+	ok = g.addObstacle(outside);
+	CHECK_EQUAL(ok, false);
+
+	// Obstacles that would overlap the boundary or the holes
+	int rejected[][4] = {
+		{ 35, 35, 45, 45 }, // inside a hole
+		{ 20, 40, 60, 50 }, // across a hole
+		{ 20, 20, 60, 70 }, // around a hole
+		{ 50, 40, 80, 50 }, // touching a hole
+		{ 190, 100, 210, 110 } // across the boundary
+	};
+	for(size_t i = 0; i < sizeof(rejected) / sizeof(rejected[0]); ++i) {
+		polygon_t::Ptr o(new polygon_t);
+		int *r = rejected[i];
+		o->push_back(P(r[0], r[1])); o->push_back(P(r[2], r[1])); o->push_back(P(r[2], r[3])); o->push_back(P(r[0], r[3]));
+		ok = g.addObstacle(o);
+		CHECK_EQUAL(ok, false);
+	}
+	CHECK_EQUAL(c->getHoles().size(), 3);
+	CHECK_EQUAL(mapDifferences(c->getGraph(), empty), 0);
+}
+
+/**
+ * Runs queries on a ground from several threads.
+ */
+struct FindPathJob : public WorkerPool::Job {
+	Ground& ground;
+	const std::vector<std::pair<VirtualPosition, VirtualPosition> >& queries;
+	std::vector<Path> paths;
+	std::vector<Ground::SearchSpace> spaces;
+
+	FindPathJob(Ground& ground, const std::vector<std::pair<VirtualPosition, VirtualPosition> >& queries, unsigned threads) :
+		ground(ground), queries(queries), paths(queries.size()), spaces(threads) { }
+
+	void run(size_t item, unsigned worker) {
+		ground.findPath(queries[item].first, queries[item].second, spaces[worker], paths[item]);
+	}
+};
+
+TEST(Ground, concurrentQueries) {
+	typedef Polygon<VirtualPosition, IsPosition> polygon_t;
+	typedef VirtualPosition P;
+
+	std::vector<polygon_t::Ptr> polygons;
+	latticeRoom(polygons);
+	Ground g;
+	g.setPathCacheSize(0);
+	for(size_t i = 0; i < polygons.size(); ++i) {
+		g.addPolygon(polygons[i]);
+	}
+
+	g.prepareConcurrentQueries();
+	Ground snapshot(g);
+	CHECK_EQUAL(snapshot.getVersion(), g.getVersion());
+	CHECK_EQUAL(snapshot.rootComponent->hasValidMap(), true);
+	CHECK_EQUAL(mapDifferences(snapshot.rootComponent->getGraph(), g.rootComponent->getGraph()), 0);
+	// The maps are shared, not copied
+	CHECK_EQUAL(&snapshot.rootComponent->getGraph() == &g.rootComponent->getGraph(), true);
+
+	// Changes to the original don't affect the copy
+	size_t waypoints = snapshot.rootComponent->getGraph().size();
+	polygon_t::Ptr block(new polygon_t);
+	block->push_back(P(60, 70)); block->push_back(P(140, 70)); block->push_back(P(140, 80)); block->push_back(P(60, 80));
+	bool ok = g.addObstacle(block);
+	CHECK_EQUAL(ok, true);
+	CHECK_EQUAL(snapshot.rootComponent->getHoles().size(), 9);
+	CHECK_EQUAL(g.rootComponent->getGraph().size(), waypoints + 4);
+	CHECK_EQUAL(snapshot.rootComponent->getGraph().size(), waypoints);
+	g.removeObstacle(block);
+	CHECK_EQUAL(mapDifferences(snapshot.rootComponent->getGraph(), g.rootComponent->getGraph()), 0);
+
+	std::vector<std::pair<P, P> > queries;
+	srand(3);
+	while(queries.size() < 100) {
+		P source(rand() % 200, rand() % 200), target(rand() % 200, rand() % 200);
+		if(g.isWalkable(g.rootComponent, source) && g.isWalkable(g.rootComponent, target)) {
+			queries.push_back(std::make_pair(source, target));
+		}
+	}
+
+	WorkerPool pool(4);
+	FindPathJob job(snapshot, queries, pool.getThreads());
+	pool.run(job, queries.size());
+
+	size_t differences = 0;
+	for(size_t i = 0; i < queries.size(); ++i) {
+		Path path;
+		g.getPath(queries[i].first, queries[i].second, path);
+		if(path != job.paths[i]) { differences++; }
+	}
+	CHECK_EQUAL(differences, 0);
+}
+
+TEST(Ground, pathTables) {
+	typedef Polygon<VirtualPosition, IsPosition> polygon_t;
+	typedef VirtualPosition P;
+
+	std::vector<polygon_t::Ptr> polygons;
+	latticeRoom(polygons);
+
+	Ground search, table, loaded;
+	table.setPathTables(true);
+	for(size_t i = 0; i < polygons.size(); ++i) {
+		search.addPolygon(polygons[i]);
+		table.addPolygon(polygons[i]);
+		loaded.addPolygon(polygons[i]);
+	}
+	search.setPathCacheSize(0);
+	table.setPathCacheSize(0);
+	loaded.setPathCacheSize(0);
+
+	table.generateMap();
+	CHECK_EQUAL(table.rootComponent->hasValidPathTable(), true);
+	CHECK_EQUAL(table.rootComponent->getPathTable().size(), 36);
+	CHECK_EQUAL(table.rootComponent->getPathTable().getDistance(0, 0), 0);
+
+	const char *filename = "/tmp/grail_test_path_tables.bin";
+	bool saved = table.savePathTables(filename);
+	CHECK_EQUAL(saved, true);
+	bool ok = loaded.loadPathTables(filename);
+	CHECK_EQUAL(ok, true);
+	CHECK_EQUAL(loaded.rootComponent->hasValidPathTable(), true);
+
+	// A ground with different corners must not accept the file
+	Ground other;
+	other.addPolygon(polygons[0]);
+	other.addPolygon(polygons[1]);
+	ok = other.loadPathTables(filename);
+	CHECK_EQUAL(ok, false);
+	CHECK_EQUAL(other.getPathTables(), false);
+
+	// Neither a file that claims more tables than it can hold
+	const char *corrupt = "/tmp/grail_test_path_tables_corrupt.bin";
+	FILE *f = fopen(corrupt, "wb");
+	const char magic[4] = { 'G', 'P', 'T', 'B' };
+	uint32_t header[3] = { 1, 0xffffffffu, 0 }; // format version, tables, reserved
+	fwrite(magic, sizeof(magic), 1, f);
+	fwrite(header, sizeof(header), 1, f);
+	fclose(f);
+	std::vector<PathTable> tables;
+	CHECK_EQUAL(PathTable::load(corrupt, tables), false);
+
+	// Nor one with next hops that point past the table
+	f = fopen(corrupt, "wb");
+	header[1] = 1;
+	uint32_t body[2 + 2 * 4] = { 2, 0, // count, fingerprint
+		0, 5, 1, 1, // next hops
+		0, 0, 0, 0 }; // distances (0.0f)
+	fwrite(magic, sizeof(magic), 1, f);
+	fwrite(header, sizeof(header), 1, f);
+	fwrite(body, sizeof(body), 1, f);
+	fclose(f);
+	CHECK_EQUAL(PathTable::load(corrupt, tables), false);
+
+	// Next hops that go in circles load, but don't give a path
+	f = fopen(corrupt, "wb");
+	body[3] = 0; // 0 -> 1 goes via 0
+	fwrite(magic, sizeof(magic), 1, f);
+	fwrite(header, sizeof(header), 1, f);
+	fwrite(body, sizeof(body), 1, f);
+	fclose(f);
+	CHECK_EQUAL(PathTable::load(corrupt, tables), true);
+	remove(corrupt);
+
+	WaypointGraph pair;
+	std::vector<P> corners;
+	corners.push_back(P(0, 0)); corners.push_back(P(10, 0));
+	pair.build(corners, std::vector<WaypointGraph::Link>());
+	std::vector<WaypointGraph::Edge> fromFirst(1, WaypointGraph::Edge(0, 1)), toSecond(1, WaypointGraph::Edge(1, 1));
+	Path circle;
+	CHECK_EQUAL(tables[0].findPath(pair, P(0, 5), fromFirst, P(10, 5), toSecond, false, circle), false);
+	CHECK_EQUAL(circle.size(), 0u);
+
+	srand(11);
+	size_t differences = 0;
+	for(int n = 0; n < 200; ++n) {
+		P source(rand() % 200, rand() % 200), target(rand() % 200, rand() % 200);
+		if(!search.isWalkable(search.rootComponent, source) || !search.isWalkable(search.rootComponent, target)) { continue; }
+
+		Path p1, p2, p3;
+		search.getPath(source, target, p1);
+		table.getPath(source, target, p2);
+		loaded.getPath(source, target, p3);
+
+		double l1 = 0, l2 = 0;
+		P prev = source;
+		for(Path::const_iterator iter = p1.begin(); iter != p1.end(); ++iter) {
+			l1 += (*iter - prev).length();
+			prev = *iter;
+		}
+		prev = source;
+		for(Path::const_iterator iter = p2.begin(); iter != p2.end(); ++iter) {
+			l2 += (*iter - prev).length();
+			prev = *iter;
+		}
+		if(l1 > l2 + 0.001 || l2 > l1 + 0.001) { differences++; }
+		if(p2 != p3) { differences++; }
+	}
+	CHECK_EQUAL(differences, 0);
+	remove(filename);
+}
+
+TEST(Ground, findInnerPoint) {
+	typedef Polygon<VirtualPosition, IsPosition> polygon_t;
+	typedef VirtualPosition P;
+
+	// Room with a slanted right wall and a box in the middle
+	polygon_t::Ptr room(new polygon_t);
+	room->push_back(P(0, 0)); room->push_back(P(200, 0)); room->push_back(P(150, 200)); room->push_back(P(0, 200));
+	polygon_t::Ptr box(new polygon_t);
+	box->push_back(P(80, 80)); box->push_back(P(120, 80)); box->push_back(P(120, 120)); box->push_back(P(80, 120));
+	Ground g;
+	g.addPolygon(room);
+	g.addPolygon(box);
+	Ground::Component *c = g.rootComponent;
+
+	CHECK_EQUAL(g.findInnerPoint(c, P(50, 50)), P(50, 50));
+	CHECK_EQUAL(g.findInnerPoint(c, P(-30, 50)), P(0, 50));
+	CHECK_EQUAL(g.findInnerPoint(c, P(50, 1000)), P(50, 200));
+	CHECK_EQUAL(g.findInnerPoint(c, P(-30, -40)), P(0, 0));
+	// out of the box
+	CHECK_EQUAL(g.findInnerPoint(c, P(85, 100)), P(80, 100));
+	CHECK_EQUAL(g.findInnerPoint(c, P(100, 118)), P(100, 120));
+
+	// Points off the slanted wall end up on the walkable side, close to
+	// where they were
+	srand(9);
+	size_t bad = 0;
+	for(int n = 0; n < 200; ++n) {
+		P p(180 + rand() % 80, 20 + rand() % 160);
+		if(g.isWalkable(c, p)) { continue; }
+		P q = g.findInnerPoint(c, p);
+		if(!g.isWalkable(c, q)) { bad++; }
+
+		// distance to the wall: 200 x + 50 y = 40000
+		double d = (200.0 * p.getX() + 50.0 * p.getY() - 40000.0) / sqrt(200.0 * 200.0 + 50.0 * 50.0);
+		if((q - p).length() > d + 1.5) { bad++; }
+	}
+	CHECK_EQUAL(bad, 0);
+
+	// Targets in the box are moved to where the way there enters the box
+	CHECK_EQUAL(g.findTargetPoint(c, P(10, 100), P(100, 100)), P(80, 100));
+	CHECK_EQUAL(g.findTargetPoint(c, P(100, 10), P(100, 100)), P(100, 80));
+	CHECK_EQUAL(g.findTargetPoint(c, P(10, 100), P(-50, 100)), P(0, 100));
+}
+
+TEST(Ground, getPaths) {
+	typedef Polygon<VirtualPosition, IsPosition> polygon_t;
+	typedef VirtualPosition P;
+
+	std::vector<polygon_t::Ptr> polygons;
+	latticeRoom(polygons);
+	Ground g;
+	g.setPathCacheSize(0);
+	for(size_t i = 0; i < polygons.size(); ++i) {
+		g.addPolygon(polygons[i]);
+	}
+
+	// Some of the sources lie inside the boxes and have to be moved out
+	// first, just like with getPath()
+	srand(5);
+	P target(105, 190);
+	std::vector<P> sources;
+	for(int n = 0; n < 100; ++n) {
+		sources.push_back(P(rand() % 200, rand() % 200));
+	}
+	sources.push_back(target);
+
+	std::vector<Path> paths;
+	g.getPaths(target, sources, paths);
+	CHECK_EQUAL(paths.size(), sources.size());
+
+	size_t differences = 0;
+	for(size_t i = 0; i < sources.size(); ++i) {
+		Path single;
+		g.getPath(sources[i], target, single);
+
+		double l1 = 0, l2 = 0;
+		P prev = sources[i];
+		for(Path::const_iterator iter = single.begin(); iter != single.end(); ++iter) {
+			l1 += (*iter - prev).length();
+			prev = *iter;
+		}
+		prev = sources[i];
+		for(Path::const_iterator iter = paths[i].begin(); iter != paths[i].end(); ++iter) {
+			l2 += (*iter - prev).length();
+			prev = *iter;
+		}
+		if(l1 > l2 + 0.001 || l2 > l1 + 0.001) { differences++; }
+		if(single.empty() != paths[i].empty()) { differences++; }
+	}
+	CHECK_EQUAL(differences, 0);
+
+	// Reusing the vector must not keep anything from the last call
+	std::vector<Path> again(paths);
+	again.push_back(Path(3, target));
+	g.getPaths(target, sources, again);
+	CHECK_EQUAL(again.size(), sources.size());
+	CHECK_EQUAL(again == paths, true);
 }
 
 
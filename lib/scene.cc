@@ -15,20 +15,21 @@ using std::endl;
 #include "rect.h"
 #include "actor.h"
 #include "image.h"
+#include "surface.h"
 
 namespace grail {
 
 Scene::Scene(Animation::Ptr background) :
-	background(background), _actorsMoved(false), _drawWalls(false) {
+	background(background), layersComposed(false), _actorsMoved(false), _drawWalls(false) {
 }
 
 Scene::Scene(const std::string& backgroundPath) :
-	_actorsMoved(false), _drawWalls(false) {
+	layersComposed(false), _actorsMoved(false), _drawWalls(false) {
 	this->background = Animation::Ptr(new Image(backgroundPath));
 }
 
 Scene::Scene(VirtualSize size) :
-	size(size), _actorsMoved(false), _drawWalls(false) {
+	size(size), layersComposed(false), _actorsMoved(false), _drawWalls(false) {
 }
 
 Scene::~Scene() {
@@ -47,20 +48,97 @@ VirtualSize Scene::getSize() const {
 }
 
 void Scene::setBackground(Animation::Ptr background) {
-	background = background;
+	this->background = background;
+	layersComposed = false;
 }
 
 void Scene::addBackground(Animation::Ptr background, VirtualPosition offset, double scrollFactorX, double scrollFactorY) {
 	Parallax* bg = new Parallax(background, offset, scrollFactorX, scrollFactorY);
 	backgrounds.push_back(bg);
+	layersComposed = false;
 }
 
 void Scene::addForeground(Animation::Ptr foreground, VirtualPosition offset, double scrollFactorX, double scrollFactorY) {
 	Parallax* bg = new Parallax(foreground, offset, scrollFactorX, scrollFactorY);
 	foregrounds.push_back(bg);
+	layersComposed = false;
+}
+
+void Scene::composeRuns(const std::vector<Parallax>& layers, std::vector<Parallax>& composed) {
+	size_t i = 0;
+	while(i < layers.size()) {
+		const Parallax& first = layers[i];
+		size_t j = i + 1;
+		if(first.animation->getStaticSurface()) {
+			while(j < layers.size() && layers[j].animation->getStaticSurface() &&
+					layers[j].scrollFactorX == first.scrollFactorX &&
+					layers[j].scrollFactorY == first.scrollFactorY) {
+				j++;
+			}
+		}
+		
+		if(j - i < 2) {
+			composed.push_back(first);
+			i = j;
+			continue;
+		}
+		
+		// Layers in a run keep their distances, flatten them relative to
+		// their common bounding box
+		std::vector<Surface::Layer> run;
+		PhysicalPosition topLeft, bottomRight;
+		for(size_t k = i; k < j; k++) {
+			Surface::Ptr surface = layers[k].animation->getStaticSurface();
+			PhysicalPosition a = conv<VirtualPosition, PhysicalPosition>(layers[k].offset);
+			PhysicalPosition b = a + surface->getSize();
+			if(k == i) {
+				topLeft = a;
+				bottomRight = b;
+			}
+			else {
+				topLeft = PhysicalPosition(std::min(topLeft.getX(), a.getX()), std::min(topLeft.getY(), a.getY()));
+				bottomRight = PhysicalPosition(std::max(bottomRight.getX(), b.getX()), std::max(bottomRight.getY(), b.getY()));
+			}
+			run.push_back(Surface::Layer(surface, a));
+		}
+		for(std::vector<Surface::Layer>::iterator iter = run.begin(); iter != run.end(); ++iter) {
+			iter->second = iter->second - topLeft;
+		}
+		
+		Animation::Ptr flat(new Image(Surface::flatten(bottomRight - topLeft, run)));
+		composed.push_back(Parallax(flat, conv<PhysicalPosition, VirtualPosition>(topLeft),
+					first.scrollFactorX, first.scrollFactorY));
+		i = j;
+	}
+}
+
+void Scene::composeLayers() {
+	std::vector<Parallax> layers;
+	if(background) {
+		layers.push_back(Parallax(background, VirtualPosition(0, 0), 1.0, 1.0));
+	}
+	list<Parallax*>::const_iterator piter;
+	for(piter = backgrounds.begin(); piter != backgrounds.end(); ++piter) {
+		layers.push_back(**piter);
+	}
+	composedBackgrounds.clear();
+	composeRuns(layers, composedBackgrounds);
+	
+	layers.clear();
+	for(piter = foregrounds.begin(); piter != foregrounds.end(); ++piter) {
+		layers.push_back(**piter);
+	}
+	composedForegrounds.clear();
+	composeRuns(layers, composedForegrounds);
+	
+	layersComposed = true;
 }
 
 void Scene::eachFrame(uint32_t ticks) {
+	if(!layersComposed) {
+		composeLayers();
+	}
+	
 	if(_actorsMoved) {
 		actors.sort(Actor::CompareByY());
 		_actorsMoved = false;
@@ -70,22 +148,29 @@ void Scene::eachFrame(uint32_t ticks) {
 	for(iter = actors.begin(); iter != actors.end(); iter++) {
 		(*iter)->eachFrame(ticks);
 	}
+	
+	actorIndex.update(actors);
 }
 
-void Scene::renderAt(SDL_Surface* target, uint32_t ticks, VirtualPosition p) const {
+void Scene::renderAt(SDL_Surface* target, uint32_t ticks, VirtualPosition p, const Rect& view) const {
 	assert(target);
-	if(background) {
-		background->renderAt(target, ticks, p);
-	}
-	
 	list<Parallax*>::const_iterator piter;
-	for(piter = backgrounds.begin(); piter != backgrounds.end(); ++piter) {
-		(*piter)->animation->renderAt(target, ticks,
-				VirtualPosition(
-					p.getX() * (*piter)->scrollFactorX,
-					p.getY() * (*piter)->scrollFactorY
-					) + (*piter)->offset
-		);
+	std::vector<Parallax>::const_iterator citer;
+	
+	if(layersComposed) {
+		for(citer = composedBackgrounds.begin(); citer != composedBackgrounds.end(); ++citer) {
+			if(!view.intersects(citer->getBounds(p))) { continue; }
+			citer->animation->renderAt(target, ticks, citer->getPosition(p));
+		}
+	}
+	else {
+		if(background && view.intersects(Rect(p, background->getSize()))) {
+			background->renderAt(target, ticks, p);
+		}
+		for(piter = backgrounds.begin(); piter != backgrounds.end(); ++piter) {
+			if(!view.intersects((*piter)->getBounds(p))) { continue; }
+			(*piter)->animation->renderAt(target, ticks, (*piter)->getPosition(p));
+		}
 	}
 	
 	#if VISUALIZE_SCENE
@@ -94,40 +179,74 @@ void Scene::renderAt(SDL_Surface* target, uint32_t ticks, VirtualPosition p) con
 
 	list<Actor::Ptr>::const_iterator iter;
 	for(iter = actors.begin(); iter != actors.end(); ++iter) {
+		#if !(VISUALIZE_HOTSPOTS || VISUALIZE_WALKPATH)
+		// (Visualizations are drawn outside of the actor's bounds)
+		Rect bounds = (*iter)->getBounds();
+		if(!view.intersects(Rect(bounds.getTopLeft() + p, bounds.getSize()))) { continue; }
+		#endif
 		(*iter)->renderAt(target, ticks, p);
 
 	}
 	
-	for(piter = foregrounds.begin(); piter != foregrounds.end(); ++piter) {
-		(*piter)->animation->renderAt(target, ticks,
-				VirtualPosition(
-					p.getX() * (*piter)->scrollFactorX,
-					p.getY() * (*piter)->scrollFactorY
-					) + (*piter)->offset
-		);
+	if(layersComposed) {
+		for(citer = composedForegrounds.begin(); citer != composedForegrounds.end(); ++citer) {
+			if(!view.intersects(citer->getBounds(p))) { continue; }
+			citer->animation->renderAt(target, ticks, citer->getPosition(p));
+		}
+	}
+	else {
+		for(piter = foregrounds.begin(); piter != foregrounds.end(); ++piter) {
+			if(!view.intersects((*piter)->getBounds(p))) { continue; }
+			(*piter)->animation->renderAt(target, ticks, (*piter)->getPosition(p));
+		}
 	}
 	
 	Game::getInstance().getDialogFrontend()->renderAt(target, ticks, p);
 } // renderAt
 
+void Scene::collectDirty(DirtyRegion& region, VirtualPosition p) {
+	// Every layer is tracked on its own, so the ones that scroll slower
+	// or faster than the camera are redrawn when the last frame has
+	// been scrolled
+	if(background) {
+		backgroundTracker.update(region, p, background->getSize(), background->isDirty());
+		background->setClean();
+	}
+	
+	list<Parallax*>::const_iterator piter;
+	for(piter = backgrounds.begin(); piter != backgrounds.end(); ++piter) {
+		Parallax& layer = **piter;
+		layer.dirtyTracker.update(region, layer.getPosition(p), layer.animation->getSize(), layer.animation->isDirty());
+		layer.animation->setClean();
+	}
+	
+	list<Actor::Ptr>::const_iterator iter;
+	for(iter = actors.begin(); iter != actors.end(); ++iter) {
+		(*iter)->collectDirty(region, p);
+	}
+	
+	for(piter = foregrounds.begin(); piter != foregrounds.end(); ++piter) {
+		Parallax& layer = **piter;
+		layer.dirtyTracker.update(region, layer.getPosition(p), layer.animation->getSize(), layer.animation->isDirty());
+		layer.animation->setClean();
+	}
+	
+	Game::getInstance().getDialogFrontend()->collectDirty(region, p);
+} // collectDirty
+
 EventState Scene::handleEvent(SDL_Event& event, uint32_t ticks) {
 	if(event.type == SDL_MOUSEBUTTONDOWN) {
 		VirtualPosition pos = conv<const SDL_MouseButtonEvent&, VirtualPosition>(event.button);
 		
 		if(Rect(getSize()).hasPoint(pos)) {
-			list<Actor::Ptr>::const_iterator iter;
-			bool event_sent = false;
 			VirtualPosition cam = Game::getInstance().getViewport().getCameraPosition();
+			Actor::Ptr actor = actorIndex.getActorAt(pos + cam);
 			
-			for(iter = actors.begin(); iter != actors.end(); iter++) {
-				if((*iter)->hasPoint(pos + cam)) {
-					Event::actorClick(*iter, pos + cam, event.button.button)->push();
-					Game::getInstance().event("actorClick", *iter);
-					event_sent = true;
-					break;
-				}
-			} // for
-			if(!event_sent) {
+			if(actor) {
+				Event::actorClick(actor, pos + cam, event.button.button)->push();
+				Game::getInstance().event("actorClick", actor);
+			}
+			else {
 				Event::sceneClick(pos + cam, event.button.button)->push();
 				Game::getInstance().event("sceneClick", pos + cam);
 			}
@@ -139,22 +258,14 @@ EventState Scene::handleEvent(SDL_Event& event, uint32_t ticks) {
 		
 		if(Rect(getSize()).hasPoint(pos)) {
 			UserInterface::Ptr ui = Game::getInstance().getUserInterface();
-			
-			list<Actor::Ptr>::const_iterator iter;
 			VirtualPosition cam = Game::getInstance().getViewport().getCameraPosition();
+			Actor::Ptr actor = actorIndex.getActorAt(pos + cam);
 			
-			bool hovered_something = false;
-			for(iter = actors.begin(); iter != actors.end(); iter++) {
-				if((*iter)->hasPoint(pos + cam)) {
-					if(ui) {
-						hovered_something = true;
-						ui->setHovering(*iter);
-						Game::getInstance().event("actorHover", *iter);
-						break;
-					}
-				}
+			if(actor && ui) {
+				ui->setHovering(actor);
+				Game::getInstance().event("actorHover", actor);
 			}
-			if(!hovered_something) {
+			else {
 				ui->setHovering(Actor::Ptr());
 				Game::getInstance().event("sceneHover", pos + cam);
 			}
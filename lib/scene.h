@@ -5,6 +5,7 @@
 
 #include <algorithm>
 #include <string>
+#include <vector>
 
 #include <boost/shared_ptr.hpp>
 
@@ -14,6 +15,9 @@
 #include "event.h"
 #include "actor.h"
 #include "ground.h"
+#include "rect.h"
+#include "actor_index.h"
+#include "dirty_region.h"
 
 namespace grail {
 
@@ -22,16 +26,39 @@ class Scene {
 			Animation::Ptr animation;
 			VirtualPosition offset;
 			double scrollFactorX, scrollFactorY;
+			DirtyTracker dirtyTracker;
 			Parallax(Animation::Ptr animation, VirtualPosition offset, double scrollFactorX, double scrollFactorY) :
 				animation(animation), offset(offset), scrollFactorX(scrollFactorX), scrollFactorY(scrollFactorY) {
 			}
+			
+			/// Where to draw the layer when the scene is drawn at $p
+			VirtualPosition getPosition(VirtualPosition p) const {
+				return VirtualPosition(p.getX() * scrollFactorX, p.getY() * scrollFactorY) + offset;
+			}
+			
+			/// Where the layer covers the screen when the scene is drawn at $p
+			Rect getBounds(VirtualPosition p) const {
+				return Rect(getPosition(p), animation->getSize());
+			}
 		}; // Parallax
 		
 		Animation::Ptr background;
+		DirtyTracker backgroundTracker;
 		VirtualSize size;
 		std::list<Parallax*> backgrounds, foregrounds;
+		
+		// The layers as drawn: background and backgrounds resp. the
+		// foregrounds, with each run of static layers that scroll alike
+		// flattened into one
+		std::vector<Parallax> composedBackgrounds, composedForegrounds;
+		bool layersComposed;
+		
+		void composeLayers();
+		static void composeRuns(const std::vector<Parallax>& layers, std::vector<Parallax>& composed);
+		
 		std::list<Actor::Ptr> actors;
 		bool _actorsMoved;
+		ActorIndex actorIndex; ///< For hit testing, updated each frame
 		Ground ground;
 		bool _drawWalls;
 		
@@ -65,7 +92,19 @@ class Scene {
 		void enableDrawWalls(bool t=true) { _drawWalls = t; }
 		
 		void eachFrame(uint32_t ticks);
-		void renderAt(SDL_Surface* target, uint32_t ticks, VirtualPosition p) const;
+		
+		/**
+		 * Render the scene to $target at $p. Layers and actors that lie
+		 * completely outside $view (the visible part of $target in virtual
+		 * screen coordinates) are skipped.
+		 */
+		void renderAt(SDL_Surface* target, uint32_t ticks, VirtualPosition p, const Rect& view) const;
+		
+		/**
+		 * Add the screen area that changed since the last call (when
+		 * rendered at $p) to $region.
+		 */
+		void collectDirty(DirtyRegion& region, VirtualPosition p);
 		
 		EventState handleEvent(SDL_Event& event, uint32_t ticks);
 		
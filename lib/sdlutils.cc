@@ -1,5 +1,9 @@
 // vim: set noexpandtab:
 
+#include <cstdlib>
+#include <cstring>
+#include <algorithm>
+
 #include "sdlutils.h"
 
 namespace grail {
@@ -22,6 +26,29 @@ namespace grail {
 		c.b = b;
 		return c;
 	}
+	
+	void scrollSurface(SDL_Surface* surface, int dx, int dy) {
+		int w = surface->w - abs(dx), h = surface->h - abs(dy);
+		if(w <= 0 || h <= 0 || (dx == 0 && dy == 0)) { return; }
+		
+		if(SDL_MUSTLOCK(surface)) { SDL_LockSurface(surface); }
+		
+		int bpp = surface->format->BytesPerPixel;
+		uint8_t* pixels = (uint8_t*)surface->pixels;
+		int fromX = std::max(-dx, 0), toX = std::max(dx, 0);
+		int fromY = std::max(-dy, 0), toY = std::max(dy, 0);
+		
+		// Moving down, copy the bottom row first so no row is overwritten
+		// before it has been copied
+		for(int i = 0; i < h; i++) {
+			int row = (dy > 0) ? (h - 1 - i) : i;
+			memmove(pixels + (toY + row) * surface->pitch + toX * bpp,
+					pixels + (fromY + row) * surface->pitch + fromX * bpp,
+					w * bpp);
+		}
+		
+		if(SDL_MUSTLOCK(surface)) { SDL_UnlockSurface(surface); }
+	}
 
 }
 
@@ -11,6 +11,13 @@ namespace grail {
 	
 	SDL_Color rgb(uint32_t v);
 	SDL_Color rgb(uint8_t r, uint8_t g, uint8_t b);
+	
+	/**
+	 * Move the contents of $surface by $dx, $dy pixels in place. What
+	 * is moved out is lost, what is moved in from outside is left as it
+	 * was.
+	 */
+	void scrollSurface(SDL_Surface* surface, int dx, int dy);
 }
 
 #endif // SDLUTILS_H
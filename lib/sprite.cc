@@ -29,6 +29,7 @@ void Sprite::eachFrame(uint32_t ticks) {
 		if(currentFrame >= frames) {
 			currentFrame = 0;
 		}
+		dirty = true;
 	}
 } // eachFrame
 
@@ -20,12 +20,14 @@ class Sprite : public Animation {
 		uint32_t currentFrame, frames;
 		uint32_t defaultDuration;
 		uint32_t ticksSinceFrameStart;
+		bool dirty;
 		
 	public:
 		Sprite(uint32_t frames = 0, uint32_t defaultDuration = 100) :
 			frames(frames), defaultDuration(defaultDuration) {
 			currentFrame = 0;
 			ticksSinceFrameStart = 0;
+			dirty = true;
 		}
 		
 		virtual ~Sprite() { };
@@ -41,6 +43,8 @@ class Sprite : public Animation {
 		void setFrameDurations(const std::vector<uint32_t>& durations);
 		
 		void eachFrame(uint32_t ticks);
+		bool isDirty() const { return dirty; }
+		void setClean() { dirty = false; }
 		void renderAt(SDL_Surface* target, uint32_t ticks, VirtualPosition p) const;
 		virtual void renderCurrentFrameAt(SDL_Surface* target, VirtualPosition p) const = 0;
 };
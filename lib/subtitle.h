@@ -26,6 +26,9 @@ namespace grail {
 			VirtualSize getSize() const {
 				return text->getSize();
 			}
+			
+			bool isDirty() const { return text->isDirty(); }
+			void setClean() { text->setClean(); }
 
 			DialogLine::Ptr getDialogLine() {
 				return dialogLine;
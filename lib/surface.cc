@@ -1,4 +1,6 @@
 
+#include <algorithm>
+
 #include "surface.h"
 #include "utils.h"
 #include "debug.h"
@@ -186,6 +188,58 @@ uint8_t Surface::getAlpha(PhysicalPosition p) const {
 	return a;
 }
 
+Surface::Ptr Surface::flatten(PhysicalSize size, const std::vector<Layer>& layers) {
+	SDL_Surface* target = createSDLSurface(size.getX(), size.getY(), SDL_SWSURFACE);
+	SDL_FillRect(target, 0, SDL_MapRGBA(target->format, 0, 0, 0, 0));
+	SDL_LockSurface(target);
+	
+	for(std::vector<Layer>::const_iterator iter = layers.begin(); iter != layers.end(); ++iter) {
+		SDL_Surface* source = iter->first->sdlSurface;
+		if(!source) { continue; }
+		if(source->format->BitsPerPixel != 32) {
+			SDL_UnlockSurface(target);
+			SDL_FreeSurface(target);
+			throw Exception("Only 32-Bit-Surfaces are supported atm.");
+		}
+		
+		int x0 = iter->second.getX(), y0 = iter->second.getY();
+		int fromX = std::max(0, -x0), toX = std::min(source->w, target->w - x0);
+		int fromY = std::max(0, -y0), toY = std::min(source->h, target->h - y0);
+		
+		SDL_LockSurface(source);
+		for(int y = fromY; y < toY; y++) {
+			const uint32_t* s = (const uint32_t*)((const uint8_t*)source->pixels + y * source->pitch);
+			uint32_t* t = (uint32_t*)((uint8_t*)target->pixels + (y0 + y) * target->pitch);
+			for(int x = fromX; x < toX; x++) {
+				uint8_t sr, sg, sb, sa, tr, tg, tb, ta;
+				SDL_GetRGBA(s[x], source->format, &sr, &sg, &sb, &sa);
+				if(sa == 0) { continue; }
+				SDL_GetRGBA(t[x0 + x], target->format, &tr, &tg, &tb, &ta);
+				
+				// Porter-Duff "over" with non-premultiplied colors
+				uint32_t below = ta * (255 - sa) / 255;
+				uint32_t a = sa + below;
+				t[x0 + x] = SDL_MapRGBA(target->format,
+						(sr * sa + tr * below) / a,
+						(sg * sa + tg * below) / a,
+						(sb * sa + tb * below) / a,
+						a);
+			}
+		}
+		SDL_UnlockSurface(source);
+	}
+	SDL_UnlockSurface(target);
+	
+	#ifndef WITH_OPENGL
+		SDL_Surface* display = SDL_DisplayFormatAlpha(target);
+		if(display) {
+			SDL_FreeSurface(target);
+			target = display;
+		}
+	#endif
+	return Ptr(new Surface(target));
+}
+
 /*SDL_Surface* Surface::getSDL() {
 	return sdlSurface;
 }*/
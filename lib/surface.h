@@ -5,6 +5,8 @@
 
 #include <cassert>
 #include <string>
+#include <vector>
+#include <utility>
 #include <iostream>
 using std::cerr;
 using std::endl;
@@ -50,6 +52,7 @@ class Surface {
 		
 	public:
 		typedef boost::shared_ptr<Surface> Ptr;
+		typedef std::pair<Ptr, PhysicalPosition> Layer;
 		
 		/**
 		 * Create new surface from image resource
@@ -73,6 +76,15 @@ class Surface {
 		void blit(SDL_Rect* from, SDL_Surface* target, SDL_Rect* to) const;
 		void blit(PhysicalPosition from, SDL_Surface* target, PhysicalPosition to) const;
 		uint8_t getAlpha(PhysicalPosition p) const;
+		
+		/**
+		 * Flatten $layers (each a surface and where to put it) into a new
+		 * surface of $size. The result looks like blitting the layers one
+		 * after another, but unlike a blit it keeps track of the alpha
+		 * channel, so it can be drawn over other things. Only 32-Bit
+		 * surfaces are supported.
+		 */
+		static Ptr flatten(PhysicalSize size, const std::vector<Layer>& layers);
 		//SDL_Surface* getSDL();
 };
 
@@ -6,12 +6,12 @@ namespace grail {
 	
 	Text::Text(Font::Ptr font, Font::Ptr outlineFont) :
 		BlitCached(2),
-		font(font), outlineFont(outlineFont), color(white), outlineColor(black) {
+		font(font), outlineFont(outlineFont), color(white), outlineColor(black), dirty(true) {
 	}
 	
 	Text::Text(Font::Ptr font) :
 		BlitCached(2),
-		font(font), color(white), outlineColor(black) {
+		font(font), color(white), outlineColor(black), dirty(true) {
 	}
 	
 	Surface* Text::render(int i) const {
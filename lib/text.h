@@ -24,6 +24,7 @@ class Text : public Animation, public BlitCached {
 		Font::Ptr outlineFont;
 		SDL_Color color, outlineColor;
 		int outline;
+		bool dirty;
 		
 	public:
 		typedef boost::shared_ptr<Text> Ptr;
@@ -71,8 +72,12 @@ class Text : public Animation, public BlitCached {
 		}
 		
 		void eachFrame(uint32_t ticks) {
+			if(hasChanged()) { dirty = true; }
 			BlitCached::eachFrame(ticks);
 		}
+		
+		bool isDirty() const { return dirty; }
+		void setClean() { dirty = false; }
 };
 
 }
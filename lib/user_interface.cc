@@ -59,6 +59,13 @@ namespace grail {
 		}
 	}
 	
+	void UserInterface::collectDirty(DirtyRegion& region, VirtualPosition p) {
+		std::list<UserInterfaceElement::Ptr>::iterator iter;
+		for(iter = elements.begin(); iter != elements.end(); iter++) {
+			(*iter)->collectDirty(region, p);
+		}
+	}
+	
 	std::ostream& operator<<(std::ostream& os, const UserInterface& ui) {
 		os << "UserInterface";
 		return os;
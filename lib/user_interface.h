@@ -14,6 +14,7 @@
 #include "event.h"
 #include "user_interface_element.h"
 #include "action.h"
+#include "dirty_region.h"
 
 namespace grail {
 	
@@ -69,6 +70,9 @@ namespace grail {
 			virtual void eachFrame(uint32_t ticks);
 			virtual EventState handleEvent(const SDL_Event& event, uint32_t frameDuration);
 			virtual void renderAt(SDL_Surface* target, uint32_t ticks, VirtualPosition p) const;
+			
+			/// Add the screen area that changed since the last call to $region
+			void collectDirty(DirtyRegion& region, VirtualPosition p);
 	};
 	
 	std::ostream& operator<<(std::ostream& os, const UserInterface& ui);
@@ -33,6 +33,9 @@ namespace grail {
 			void renderAt(SDL_Surface* target, uint32_t ticks, VirtualPosition p) const {
 				animation->renderAt(target, ticks, getUpperLeftCorner() + p);
 			}
+			
+			bool isDirty() const { return animation->isDirty(); }
+			void setClean() { animation->setClean(); }
 	};
 	
 }
@@ -12,6 +12,11 @@ namespace grail {
 				position.getY() - alignmentY * getSize().getY()
 				);
 	}
+	
+	void UserInterfaceElement::collectDirty(DirtyRegion& region, VirtualPosition p) {
+		dirtyTracker.update(region, getUpperLeftCorner() + p, getSize(), isDirty());
+		setClean();
+	}
 } // namespace grail
 
 
@@ -7,6 +7,7 @@
 #include <SDL.h>
 #include "vector2d.h"
 #include "event.h"
+#include "dirty_region.h"
 
 namespace grail {
 	
@@ -17,6 +18,7 @@ namespace grail {
 	class UserInterfaceElement {
 			double alignmentX, alignmentY;
 			VirtualPosition position;
+			DirtyTracker dirtyTracker;
 			
 		public:
 			typedef boost::shared_ptr<UserInterfaceElement> Ptr;
@@ -39,6 +41,20 @@ namespace grail {
 			virtual void eachFrame(uint32_t ticks) = 0;
 			virtual EventState handleEvent(const SDL_Event& event, uint32_t frameDuration) = 0;
 			virtual void renderAt(SDL_Surface* target, uint32_t ticks, VirtualPosition p) const = 0;
+			
+			/**
+			 * True iff renderAt() would draw something different than when
+			 * setClean() was called last. Elements that don't keep track
+			 * assume they always change.
+			 */
+			virtual bool isDirty() const { return true; }
+			virtual void setClean() { }
+			
+			/**
+			 * Add the screen area that changed since the last call (when
+			 * rendered at $p) to $region.
+			 */
+			void collectDirty(DirtyRegion& region, VirtualPosition p);
 	};
 	
 } // namespace grail
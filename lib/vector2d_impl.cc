@@ -13,6 +13,9 @@ template VirtualPosition::Scalar operator*(VirtualPosition, VirtualPosition);
 template bool operator==(VirtualPosition, VirtualPosition);
 template bool operator!=(VirtualPosition, VirtualPosition);
 template std::ostream& operator<<(std::ostream&, VirtualPosition);
+template bool operator==(PhysicalPosition, PhysicalPosition);
+template bool operator!=(PhysicalPosition, PhysicalPosition);
+template std::ostream& operator<<(std::ostream&, PhysicalPosition);
 
 #define CONV(A, B) template B conv< A , B >( A );
 
@@ -1,8 +1,11 @@
 // vim: set noexpandtab:
 
+#include <cstdlib>
+
 #include <SDL_video.h>
 
 #include "utils.h"
+#include "sdlutils.h"
 #include "viewport.h"
 #include "scene.h"
 #include "game.h"
@@ -15,10 +18,11 @@ namespace grail {
 
 Viewport::Viewport() : screen(0),
 	virtualSize(VirtualSize(4000, 3000)), cameraMode(CAMERA_CENTER),
-	cameraLimit(LIMIT_SCENE), cameraPosition(VirtualPosition(0, 0)) {
+	cameraLimit(LIMIT_SCENE), cameraPosition(VirtualPosition(0, 0)),
+	dirtyRects(false) {
 }
 
-Viewport::Viewport(uint32_t w, uint32_t h, bool fullscreen) : screen(0) {
+Viewport::Viewport(uint32_t w, uint32_t h, bool fullscreen) : screen(0), dirtyRects(false) {
 	setup(w, h, fullscreen);
 }
 
@@ -38,6 +42,8 @@ void Viewport::setup(uint32_t w, uint32_t h, bool fullscreen) {
 	#endif
 	screen = SDL_SetVideoMode(w, h, 32, flags);
 	assert(screen != NULL);
+	dirtyRegion.setBounds(PhysicalSize(screen->w, screen->h));
+	dirtyRegion.addAll();
 
 	#ifdef WITH_OPENGL
 		glEnable(GL_TEXTURE_2D);
@@ -90,13 +96,17 @@ void Viewport::setCameraPosition(VirtualPosition position) {
 	} // if LIMIT_SCENE
 } // setCameraPosition()
 
-void Viewport::renderScene(Scene::Ptr scene, uint32_t ticks) {
+void Viewport::updateCamera() {
 	if(cameraTarget) {
 		setCameraPosition(
 				cameraTarget->getPosition() - (virtualSize / 2.0)
 		);
 	}
-	scene->renderAt(screen, ticks, -cameraPosition);
+}
+
+void Viewport::renderScene(Scene::Ptr scene, uint32_t ticks) {
+	updateCamera();
+	scene->renderAt(screen, ticks, -cameraPosition, getView());
 }
 
 void Viewport::renderUserInterface(UserInterface::Ptr userInterface, uint32_t ticks) {
@@ -118,5 +128,99 @@ void Viewport::finishRendering() {
 	#endif
 }
 
+void Viewport::render(Scene::Ptr scene, UserInterface::Ptr userInterface, uint32_t ticks) {
+	#ifndef WITH_OPENGL
+		if(dirtyRects) {
+			renderDirty(scene, userInterface, ticks);
+			return;
+		}
+	#endif
+	
+	startRendering();
+	if(scene) {
+		renderScene(scene, ticks);
+	}
+	if(userInterface) {
+		renderUserInterface(userInterface, ticks);
+	}
+	finishRendering();
+}
+
+Rect Viewport::getView() const {
+	const SDL_Rect& clip = screen->clip_rect;
+	VirtualPosition a = conv<PhysicalPosition, VirtualPosition>(PhysicalPosition(clip.x - 1, clip.y - 1));
+	VirtualPosition b = conv<PhysicalPosition, VirtualPosition>(PhysicalPosition(clip.x + clip.w + 1, clip.y + clip.h + 1));
+	return Rect(a, b - a);
+}
+
+void Viewport::scroll() {
+	// Move the last frame by as much as the scene has moved on the screen
+	PhysicalPosition delta =
+		conv<VirtualPosition, PhysicalPosition>(-cameraPosition) -
+		conv<VirtualPosition, PhysicalPosition>(-lastCameraPosition);
+	
+	if(dirtyRegion.isAll() || 2 * abs(delta.getX()) >= screen->w || 2 * abs(delta.getY()) >= screen->h) {
+		dirtyRegion.addAll();
+		return;
+	}
+	scrollSurface(screen, delta.getX(), delta.getY());
+	dirtyRegion.setScroll(delta);
+}
+
+void Viewport::renderDirty(Scene::Ptr scene, UserInterface::Ptr userInterface, uint32_t ticks) {
+	updateCamera();
+	bool scrolled = false;
+	if(scene != lastScene) {
+		dirtyRegion.addAll();
+		lastScene = scene;
+	}
+	else if(cameraPosition != lastCameraPosition) {
+		scroll();
+		scrolled = true;
+	}
+	lastCameraPosition = cameraPosition;
+	
+	// Always collect, so everything knows where it has been drawn last
+	if(scene) {
+		scene->collectDirty(dirtyRegion, -cameraPosition);
+	}
+	if(userInterface) {
+		userInterface->collectDirty(dirtyRegion, VirtualPosition(0, 0));
+	}
+	
+	if(dirtyRegion.empty() && !scrolled) {
+		return;
+	}
+	
+	// Beyond about half of the screen the clipped passes cost more
+	// than they save
+	if(dirtyRegion.isAll() || 2 * dirtyRegion.getArea() > (uint64_t)screen->w * screen->h) {
+		if(scene) { scene->renderAt(screen, ticks, -cameraPosition, getView()); }
+		if(userInterface) { userInterface->renderAt(screen, ticks, VirtualPosition(0, 0)); }
+		SDL_Flip(screen);
+	}
+	else {
+		std::vector<SDL_Rect> rects = dirtyRegion.getRects();
+		for(std::vector<SDL_Rect>::iterator iter = rects.begin(); iter != rects.end(); ++iter) {
+			SDL_SetClipRect(screen, &*iter);
+			if(scene) { scene->renderAt(screen, ticks, -cameraPosition, getView()); }
+			if(userInterface) { userInterface->renderAt(screen, ticks, VirtualPosition(0, 0)); }
+		}
+		SDL_SetClipRect(screen, 0);
+		if(scrolled) {
+			SDL_Flip(screen);
+		}
+		else {
+			SDL_UpdateRects(screen, rects.size(), &rects[0]);
+		}
+	}
+	dirtyRegion.clear();
+}
+
+void Viewport::enableDirtyRects(bool enable) {
+	dirtyRects = enable;
+	dirtyRegion.addAll();
+}
+
 } // namespace grail
 
@@ -9,6 +9,8 @@
 
 #include "scene.h"
 #include "user_interface.h"
+#include "dirty_region.h"
+#include "rect.h"
 
 namespace grail {
 
@@ -32,6 +34,23 @@ class Viewport {
 		VirtualPosition cameraPosition;
 		Actor::Ptr cameraTarget;
 		
+		bool dirtyRects;
+		DirtyRegion dirtyRegion;
+		Scene::Ptr lastScene;
+		VirtualPosition lastCameraPosition;
+		
+		void updateCamera();
+		void scroll();
+		
+		/**
+		 * The part of the screen that is drawn to (its clip rectangle) in
+		 * virtual coordinates, one pixel larger on each side so that
+		 * rounding never hides anything that touches it.
+		 */
+		Rect getView() const;
+		
+		void renderDirty(Scene::Ptr scene, UserInterface::Ptr userInterface, uint32_t ticks);
+		
 	public:
 		///
 		Viewport();
@@ -56,6 +75,28 @@ class Viewport {
 		void startRendering();
 		void finishRendering();
 		
+		/**
+		 * Render a frame with $scene (if set) and $userInterface (if set) on
+		 * top and show it.
+		 */
+		void render(Scene::Ptr scene, UserInterface::Ptr userInterface, uint32_t ticks);
+		
+		/**
+		 * In dirty rectangle mode render() only redraws the parts of the
+		 * screen that changed since the last frame and updates just those
+		 * (with SDL_UpdateRects()). That pays off for scenes where little
+		 * moves.
+		 *
+		 * When the camera moves a bit the last frame is moved along and
+		 * only the uncovered strips, layers scrolling at a different speed
+		 * and whatever changed are redrawn. Scene changes and large camera
+		 * jumps redraw the whole screen.
+		 *
+		 * Has no effect when rendering with OpenGL.
+		 */
+		void enableDirtyRects(bool enable = true);
+		bool getDirtyRects() const { return dirtyRects; }
+		
 		void setFollowing(Actor::Ptr actor) {
 			cameraTarget = actor;
 		}
@@ -0,0 +1,251 @@
+// vim: set noexpandtab:
+
+#include <set>
+#include <algorithm>
+#include <stdint.h>
+
+#include "visibility_sweep.h"
+#include "predicates.h"
+
+namespace grail {
+
+typedef Ground::Component::polygon_t polygon_t;
+
+namespace {
+	/// 0 for angles in [0, pi), 1 for [pi, 2pi)
+	int half(VirtualPosition d) {
+		return (d.getY() < 0 || (d.getY() == 0 && d.getX() < 0)) ? 1 : 0;
+	}
+
+	/**
+	 * Orders corners by angle around $center, then by distance.
+	 */
+	struct AngleOrder {
+		const std::vector<Ground::Component::Corner>& corners;
+		VirtualPosition center;
+
+		AngleOrder(const std::vector<Ground::Component::Corner>& corners, VirtualPosition center) :
+			corners(corners), center(center) { }
+
+		bool operator()(WaypointGraph::Index a, WaypointGraph::Index b) const {
+			VirtualPosition da = corners[a].position - center, db = corners[b].position - center;
+			int ha = half(da), hb = half(db);
+			if(ha != hb) { return ha < hb; }
+			int64_t c = cross(da, db);
+			if(c != 0) { return c > 0; }
+			return dot(da, da) < dot(db, db);
+		}
+
+		bool sameDirection(WaypointGraph::Index a, WaypointGraph::Index b) const {
+			VirtualPosition da = corners[a].position - center, db = corners[b].position - center;
+			return half(da) == half(db) && cross(da, db) == 0;
+		}
+	};
+} // namespace
+
+/**
+ * Orders edges (given by the index of their start corner) that all cross
+ * the current sweep ray by their distance from the center.
+ *
+ * As polygon edges don't cross each other, at least one of two edges lies
+ * completely on one side of the other's line, which tells which one is
+ * nearer regardless of where exactly the ray is.
+ */
+struct VisibilitySweep::EdgeOrder {
+	const std::vector<Corner>& corners;
+	VirtualPosition center;
+
+	EdgeOrder(const std::vector<Corner>& corners, VirtualPosition center) :
+		corners(corners), center(center) { }
+
+	bool operator()(Index e1, Index e2) const {
+		if(e1 == e2) { return false; }
+		VirtualPosition a1 = corners[e1].position, b1 = corners[e1].next;
+		VirtualPosition a2 = corners[e2].position, b2 = corners[e2].next;
+
+		int sa = orientation(a2, b2, a1), sb = orientation(a2, b2, b1);
+		if(sa * sb >= 0 && (sa != 0 || sb != 0)) {
+			// e1 on one side of e2, it is nearer iff that's the center's side
+			return (sa != 0 ? sa : sb) == orientation(a2, b2, center);
+		}
+
+		sa = orientation(a1, b1, a2);
+		sb = orientation(a1, b1, b2);
+		if(sa * sb >= 0 && (sa != 0 || sb != 0)) {
+			return (sa != 0 ? sa : sb) != orientation(a1, b1, center);
+		}
+
+		// Overlapping edges, any fixed order will do
+		return e1 < e2;
+	}
+};
+
+VisibilitySweep::VisibilitySweep(Ground& ground, Ground::Component* component) {
+	component->getCorners(corners);
+
+	prevCorners.resize(corners.size());
+	for(Index begin = 0; begin < corners.size(); ) {
+		Index end = begin;
+		while(end < corners.size() && corners[end].polygon == corners[begin].polygon) { ++end; }
+		for(Index i = begin; i < end; ++i) {
+			prevCorners[i] = (i == begin) ? end - 1 : i - 1;
+		}
+		begin = end;
+	}
+
+	for(Index i = 0; i < corners.size(); ++i) {
+		if(!corners[i].bending) { continue; }
+		waypoints.push_back(i);
+		walkable.push_back(ground.isWalkable(component, corners[i].position));
+
+		// Ground::directReachable() asks the outer boundary and then the
+		// holes in order, each about the first node at the lines start
+		// point. Remember which corners these are.
+		attachments.push_back(std::vector<Index>());
+		std::vector<Index> &a = attachments.back();
+		for(Index j = 0; j < corners.size(); ++j) {
+			if(corners[j].position == corners[i].position && (a.empty() || corners[a.back()].polygon != corners[j].polygon)) {
+				a.push_back(j);
+			}
+		}
+	}
+}
+
+bool VisibilitySweep::leavesInward(Index waypoint, VirtualPosition to) const {
+	Line l(corners[waypoints[waypoint]].position, to);
+	const std::vector<Index> &a = attachments[waypoint];
+
+	for(std::vector<Index>::const_iterator iter = a.begin(); iter != a.end(); ++iter) {
+		const Corner &c = corners[*iter];
+		polygon_t::LineDirection dir = polygon_t::getLineDirection(c.prev, c.position, c.next, c.orientation, l);
+		if(dir == polygon_t::IN) { return c.polygon == 0; }
+		else if(dir == polygon_t::OUT) { return c.polygon != 0; }
+	}
+	return true;
+}
+
+void VisibilitySweep::sweep(Index waypoint, std::vector<Link>& links) const {
+	typedef std::set<Index, EdgeOrder> ActiveSet;
+
+	VirtualPosition v = corners[waypoints[waypoint]].position;
+
+	std::vector<Index> waypointOf(corners.size(), WaypointGraph::NO_INDEX);
+	for(Index i = 0; i < waypoints.size(); ++i) {
+		waypointOf[waypoints[i]] = i;
+	}
+
+	// Waypoints at the same spot are always connected
+	for(Index j = waypoint + 1; j < waypoints.size(); ++j) {
+		if(corners[waypoints[j]].position == v) {
+			links.push_back(Link(waypoint, j));
+		}
+	}
+
+	if(!walkable[waypoint]) { return; }
+
+	// Edges that can block the view: not touching v and not pointing
+	// at it (those are only ever touched, never crossed)
+	std::vector<bool> relevant(corners.size());
+	for(Index e = 0; e < corners.size(); ++e) {
+		VirtualPosition a = corners[e].position, b = corners[e].next;
+		relevant[e] = (a != b) && (a != v) && (b != v) && (cross(a - v, b - v) != 0);
+	}
+
+	EdgeOrder order(corners, v);
+	ActiveSet active(order);
+	std::vector<ActiveSet::iterator> activeIters(corners.size(), active.end());
+
+	// Start with the edges crossing the ray from v to the right. Edges
+	// with an end on that ray are handled when their corner comes up.
+	for(Index e = 0; e < corners.size(); ++e) {
+		if(!relevant[e]) { continue; }
+		VirtualPosition a = corners[e].position - v, b = corners[e].next - v;
+		int64_t o = cross(a, b);
+		if((a.getY() < 0 && b.getY() > 0 && o > 0) || (a.getY() > 0 && b.getY() < 0 && o < 0)) {
+			activeIters[e] = active.insert(e).first;
+		}
+	}
+
+	AngleOrder angleOrder(corners, v);
+	std::vector<Index> events;
+	events.reserve(corners.size());
+	for(Index i = 0; i < corners.size(); ++i) {
+		if(corners[i].position != v) { events.push_back(i); }
+	}
+	std::sort(events.begin(), events.end(), angleOrder);
+
+	std::vector<Index> incident;
+	for(size_t groupBegin = 0; groupBegin < events.size(); ) {
+		size_t groupEnd = groupBegin + 1;
+		while(groupEnd < events.size() && angleOrder.sameDirection(events[groupBegin], events[groupEnd])) {
+			++groupEnd;
+		}
+
+		// Along this ray, corners are ordered by distance. A corner that
+		// has an edge leaving the ray blocks the view to everything behind
+		// it (edges lying on the ray don't).
+		bool blocked = false;
+
+		for(size_t posBegin = groupBegin; posBegin < groupEnd; ) {
+			VirtualPosition p = corners[events[posBegin]].position;
+			size_t posEnd = posBegin + 1;
+			while(posEnd < groupEnd && corners[events[posEnd]].position == p) { ++posEnd; }
+
+			bool visible = !blocked;
+			if(visible && !active.empty()) {
+				// Does the nearest crossing edge lie between v and p?
+				Index e = *active.begin();
+				visible = orientation(corners[e].position, corners[e].next, v) * orientation(corners[e].position, corners[e].next, p) >= 0;
+			}
+
+			if(visible) {
+				for(size_t k = posBegin; k < posEnd; ++k) {
+					Index w = waypointOf[events[k]];
+					if(w != WaypointGraph::NO_INDEX && w > waypoint && walkable[w] && leavesInward(waypoint, p)) {
+						links.push_back(Link(waypoint, w));
+					}
+				}
+			}
+
+			incident.clear();
+			for(size_t k = posBegin; k < posEnd; ++k) {
+				incident.push_back(events[k]);
+				incident.push_back(prevCorners[events[k]]);
+			}
+
+			// Remove the edges the ray leaves here before adding the ones it
+			// enters so only edges that cross the ray are ever compared
+			for(std::vector<Index>::const_iterator iter = incident.begin(); iter != incident.end(); ++iter) {
+				if(!relevant[*iter]) { continue; }
+				blocked = true;
+				VirtualPosition q = (corners[*iter].position == p) ? corners[*iter].next : corners[*iter].position;
+				if(cross(p - v, q - v) < 0 && activeIters[*iter] != active.end()) {
+					active.erase(activeIters[*iter]);
+					activeIters[*iter] = active.end();
+				}
+			}
+			for(std::vector<Index>::const_iterator iter = incident.begin(); iter != incident.end(); ++iter) {
+				if(!relevant[*iter]) { continue; }
+				VirtualPosition q = (corners[*iter].position == p) ? corners[*iter].next : corners[*iter].position;
+				if(cross(p - v, q - v) > 0 && activeIters[*iter] == active.end()) {
+					activeIters[*iter] = active.insert(*iter).first;
+				}
+			}
+
+			posBegin = posEnd;
+		}
+		groupBegin = groupEnd;
+	}
+}
+
+void VisibilitySweep::build(std::vector<Link>& links) const {
+	size_t first = links.size();
+	for(Index i = 0; i < waypoints.size(); ++i) {
+		sweep(i, links);
+	}
+	// Same order as testing all pairs would give
+	std::sort(links.begin() + first, links.end());
+}
+
+} // namespace grail
+
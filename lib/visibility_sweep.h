@@ -0,0 +1,70 @@
+// vim: set noexpandtab:
+
+#ifndef VISIBILITY_SWEEP_H
+#define VISIBILITY_SWEEP_H
+
+#include <vector>
+
+#include "vector2d.h"
+#include "ground.h"
+#include "waypoint_graph.h"
+
+namespace grail {
+
+/**
+ * Connects the waypoints of a ground component with a rotational sweep
+ * (Lee's algorithm) instead of testing all pairs.
+ *
+ * For each waypoint v, all polygon corners are visited in the order of
+ * their angle around v. The edges crossing the current ray from v are kept
+ * in a set ordered by their distance to v, so whether the next corner is
+ * visible only depends on the nearest of them.
+ * That's O(n log n) per waypoint instead of n edge grid queries.
+ *
+ * The result is exactly what Ground::directReachable() would say for each
+ * pair. All geometric tests are done on 64 bit integers, so coordinates
+ * have to stay within +-MAX_COORDINATE (see predicates.h).
+ */
+class VisibilitySweep {
+	public:
+		typedef WaypointGraph::Index Index;
+		typedef WaypointGraph::Link Link;
+		typedef Ground::Component::Corner Corner;
+
+	private:
+		struct EdgeOrder;
+
+		std::vector<Corner> corners;
+		/// corner the edge ending in corner i starts from
+		std::vector<Index> prevCorners;
+		/// corner index of each waypoint
+		std::vector<Index> waypoints;
+		std::vector<bool> walkable;
+		/// corners to ask for the line direction at each waypoint
+		std::vector<std::vector<Index> > attachments;
+
+		bool leavesInward(Index waypoint, VirtualPosition to) const;
+
+	public:
+		VisibilitySweep(Ground& ground, Ground::Component* component);
+
+		Index waypointCount() const { return waypoints.size(); }
+
+		/**
+		 * Append the links from $waypoint to all waypoints with a higher
+		 * index that are visible from it to $links.
+		 * Doesn't modify the object, so different waypoints can be swept
+		 * concurrently.
+		 */
+		void sweep(Index waypoint, std::vector<Link>& links) const;
+
+		/**
+		 * Append all links between waypoints, sorted, to $links.
+		 */
+		void build(std::vector<Link>& links) const;
+};
+
+} // namespace grail
+
+#endif // VISIBILITY_SWEEP_H
+
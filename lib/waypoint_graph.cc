@@ -0,0 +1,243 @@
+// vim: set noexpandtab:
+
+#include "waypoint_graph.h"
+#include "debug.h"
+
+namespace grail {
+
+const WaypointGraph::Index WaypointGraph::NO_INDEX = 0xffffffff;
+
+void WaypointGraph::build(const std::vector<VirtualPosition>& positions, const std::vector<Link>& links) {
+	this->positions = positions;
+
+	// Count degrees, then turn the counts into start offsets
+	offsets.assign(positions.size() + 1, 0);
+	for(std::vector<Link>::const_iterator iter = links.begin(); iter != links.end(); ++iter) {
+		offsets[iter->first + 1]++;
+		offsets[iter->second + 1]++;
+	}
+	for(size_t i = 1; i < offsets.size(); ++i) {
+		offsets[i] += offsets[i - 1];
+	}
+
+	std::vector<Index> fill(offsets.begin(), offsets.end() - 1);
+	edges.resize(2 * links.size());
+	for(std::vector<Link>::const_iterator iter = links.begin(); iter != links.end(); ++iter) {
+		double cost = (positions[iter->first] - positions[iter->second]).length();
+		edges[fill[iter->first]++] = Edge(iter->second, cost);
+		edges[fill[iter->second]++] = Edge(iter->first, cost);
+	}
+}
+
+void WaypointGraph::clear() {
+	positions.clear();
+	offsets.clear();
+	edges.clear();
+}
+
+bool WaypointGraph::hasEdge(Index a, Index b) const {
+	for(Index e = beginEdges(a); e != endEdges(a); ++e) {
+		if(edges[e].target == b) { return true; }
+	}
+	return false;
+}
+
+void WaypointSearch::relax(Index from, Index to, VirtualPosition toPosition, double cost) {
+	NodeState &n = nodes[to];
+	double newCost = nodes[from].costSum + cost;
+	uint32_t id = searchCounter;
+
+	if(n.searchId != id) {
+		n.searchId = id;
+		n.closed = false;
+		n.parent = from;
+		n.costSum = newCost;
+		n.estimate = newCost + (useHeuristic ? (target - toPosition).length() : 0.0);
+		border.push(to);
+	}
+	else if(!n.closed && newCost < n.costSum) {
+		// The heuristic is consistent, so closed nodes never need to be
+		// reopened
+		n.estimate -= n.costSum - newCost;
+		n.costSum = newCost;
+		n.parent = from;
+		border.decrease(to);
+	}
+}
+
+bool WaypointSearch::findPath(const WaypointGraph& graph,
+		VirtualPosition source, const std::vector<Edge>& sourceLinks,
+		VirtualPosition target, const std::vector<Edge>& targetLinks,
+		bool direct, Path& path) {
+
+	start(graph, source, sourceLinks, target, targetLinks, direct);
+	advance(graph.size() + 2);
+	return getPath(path);
+}
+
+void WaypointSearch::start(const WaypointGraph& graph,
+		VirtualPosition source, const std::vector<Edge>& sourceLinks,
+		VirtualPosition target, const std::vector<Edge>& targetLinks,
+		bool direct) {
+
+	const Index SOURCE = graph.size();
+
+	if(nodes.size() < graph.size() + 2) {
+		nodes.resize(graph.size() + 2);
+	}
+
+	uint32_t id = ++searchCounter;
+	if(id == 0) {
+		// Wrapped around, make sure no stale state is mistaken for current
+		nodes.assign(nodes.size(), NodeState());
+		id = searchCounter = 1;
+	}
+
+	this->graph = &graph;
+	this->source = source;
+	this->target = target;
+	this->sourceLinks = sourceLinks;
+	this->direct = direct;
+	useHeuristic = true;
+
+	// Mark the waypoints that can see the target so we can relax the
+	// target from there without touching the graph
+	for(std::vector<Edge>::const_iterator iter = targetLinks.begin(); iter != targetLinks.end(); ++iter) {
+		nodes[iter->target].targetLinkId = id;
+		nodes[iter->target].targetCost = iter->cost;
+	}
+
+	border.clear();
+	expanded = 0;
+
+	NodeState &s = nodes[SOURCE];
+	s.searchId = id;
+	s.closed = false;
+	s.parent = WaypointGraph::NO_INDEX;
+	s.costSum = 0;
+	s.estimate = (target - source).length();
+	border.push(SOURCE);
+
+	best = SOURCE;
+	bestDistance = s.estimate;
+	state = STATE_RUNNING;
+}
+
+WaypointSearch::State WaypointSearch::advance(size_t maxExpansions) {
+	const Index SOURCE = graph ? graph->size() : 0, TARGET = SOURCE + 1;
+	uint32_t id = searchCounter;
+
+	for(size_t n = 0; state == STATE_RUNNING && n < maxExpansions; ++n) {
+		if(border.empty()) {
+			if(useHeuristic) {
+				cdbg << "did not find path :(\n";
+			}
+			state = STATE_FAILED;
+			break;
+		}
+
+		Index current = border.pop();
+		nodes[current].closed = true;
+		expanded++;
+
+		if(current == TARGET) {
+			state = STATE_FOUND;
+			break;
+		}
+
+		if(current == SOURCE) {
+			for(std::vector<Edge>::const_iterator iter = sourceLinks.begin(); iter != sourceLinks.end(); ++iter) {
+				relax(current, iter->target, graph->getPosition(iter->target), iter->cost);
+			}
+			if(direct) {
+				relax(current, TARGET, target, (target - source).length());
+			}
+		}
+		else {
+			VirtualPosition position = graph->getPosition(current);
+			double distance = (target - position).length();
+			if(distance < bestDistance) {
+				best = current;
+				bestDistance = distance;
+			}
+
+			for(Index e = graph->beginEdges(current); e != graph->endEdges(current); ++e) {
+				const Edge &edge = graph->getEdge(e);
+				relax(current, edge.target, graph->getPosition(edge.target), edge.cost);
+			}
+			if(nodes[current].targetLinkId == id) {
+				relax(current, TARGET, target, nodes[current].targetCost);
+			}
+		}
+	} // for
+
+	return state;
+}
+
+void WaypointSearch::buildTree(const WaypointGraph& graph, VirtualPosition target, const std::vector<Edge>& targetLinks) {
+	// The tree is rooted at the target, which takes the place of the
+	// source of a normal search. There is no goal, so the search just
+	// runs until all reachable waypoints are closed.
+	std::vector<Edge> noLinks;
+	start(graph, target, targetLinks, target, noLinks, false);
+	useHeuristic = false;
+	advance((size_t)-1);
+	state = STATE_TREE;
+}
+
+bool WaypointSearch::getTreePath(VirtualPosition source, const std::vector<Edge>& sourceLinks, bool direct, Path& path) const {
+	const Index ROOT = graph ? graph->size() : 0;
+
+	if(state != STATE_TREE) { return false; }
+	if(direct) {
+		path.push_back(target);
+		return true;
+	}
+
+	double bestCost = 0;
+	Index first = WaypointGraph::NO_INDEX;
+	for(std::vector<Edge>::const_iterator iter = sourceLinks.begin(); iter != sourceLinks.end(); ++iter) {
+		const NodeState &n = nodes[iter->target];
+		if(n.searchId != searchCounter || !n.closed) { continue; }
+		if(first == WaypointGraph::NO_INDEX || iter->cost + n.costSum < bestCost) {
+			first = iter->target;
+			bestCost = iter->cost + n.costSum;
+		}
+	}
+	if(first == WaypointGraph::NO_INDEX) {
+		return false;
+	}
+
+	for(Index p = first; p != ROOT; p = nodes[p].parent) {
+		path.push_back(graph->getPosition(p));
+	}
+	path.push_back(target);
+	return true;
+}
+
+void WaypointSearch::appendPath(Index to, Path& path) const {
+	const Index SOURCE = graph->size(), TARGET = SOURCE + 1;
+
+	Path::iterator insertPos = path.end();
+	for(Index p = to; p != SOURCE; p = nodes[p].parent) {
+		VirtualPosition pos = (p == TARGET) ? target : graph->getPosition(p);
+		cdbg << pos << "\n";
+		insertPos = path.insert(insertPos, pos);
+	}
+}
+
+bool WaypointSearch::getPath(Path& path) const {
+	if(state != STATE_FOUND) { return false; }
+
+	cdbg << "found path:\n";
+	appendPath(graph->size() + 1, path);
+	return true;
+}
+
+void WaypointSearch::getPartialPath(Path& path) const {
+	if(state == STATE_IDLE) { return; }
+	appendPath(best, path);
+}
+
+} // namespace grail
+
@@ -0,0 +1,221 @@
+// vim: set noexpandtab:
+
+#ifndef WAYPOINT_GRAPH_H
+#define WAYPOINT_GRAPH_H
+
+#include <vector>
+#include <utility>
+#include <stdint.h>
+
+#include "vector2d.h"
+#include "actor.h" // ->Path
+#include "indexed_heap.h"
+
+namespace grail {
+
+/**
+ * Static, undirected graph of waypoints in compressed sparse row layout:
+ * Waypoint positions live in one flat array, the edges of waypoint i are
+ * edges[offsets[i]] ... edges[offsets[i + 1] - 1] and carry their
+ * precomputed length as cost.
+ * Waypoints are addressed by 32 bit indices.
+ */
+class WaypointGraph {
+	public:
+		typedef uint32_t Index;
+		typedef std::pair<Index, Index> Link;
+
+		static const Index NO_INDEX;
+
+		struct Edge {
+			Index target;
+			double cost;
+			Edge() : target(0), cost(0) { }
+			Edge(Index target, double cost) : target(target), cost(cost) { }
+		};
+
+	private:
+		std::vector<VirtualPosition> positions;
+		std::vector<Index> offsets;
+		std::vector<Edge> edges;
+
+	public:
+		WaypointGraph() { }
+
+		/**
+		 * (Re-)build the graph from the given waypoint positions and
+		 * bidirectional links between them. Each link should only be given
+		 * once (either direction).
+		 */
+		void build(const std::vector<VirtualPosition>& positions, const std::vector<Link>& links);
+
+		void clear();
+
+		/// Number of waypoints
+		Index size() const { return positions.size(); }
+
+		/// Number of directed edges (twice the number of links)
+		size_t edgeCount() const { return edges.size(); }
+
+		VirtualPosition getPosition(Index i) const { return positions[i]; }
+		const std::vector<VirtualPosition>& getPositions() const { return positions; }
+
+		Index beginEdges(Index i) const { return offsets[i]; }
+		Index endEdges(Index i) const { return offsets[i + 1]; }
+		const Edge& getEdge(Index e) const { return edges[e]; }
+
+		bool hasEdge(Index a, Index b) const;
+};
+
+/**
+ * Scratch space for A* searches on a WaypointGraph.
+ *
+ * Besides the nodes of the graph, a search knows two temporary nodes, the
+ * source and the target of the query, which are linked into the graph only
+ * for the duration of the search. That way the graph itself is never
+ * modified by a query.
+ *
+ * Per-node state is tagged with the id of the search that wrote it so it
+ * doesn't need to be reset between searches. Keep one instance around per
+ * thread to avoid reallocations.
+ *
+ * A search can either be run at once (findPath()) or piecewise (start(),
+ * then advance() until it is done), e.g. to spread it over several frames.
+ * The graph must not change while a search is going on.
+ *
+ * For many queries to the same target, build a shortest path tree towards
+ * it once (buildTree()) and read the paths from there (getTreePath()).
+ */
+class WaypointSearch {
+	public:
+		/// STATE_TREE: buildTree() is done
+		enum State { STATE_IDLE, STATE_RUNNING, STATE_FOUND, STATE_FAILED, STATE_TREE };
+
+	private:
+		typedef WaypointGraph::Index Index;
+		typedef WaypointGraph::Edge Edge;
+
+		struct NodeState {
+			double costSum;
+			double estimate;
+			Index parent;
+			Index heapIndex;
+			uint32_t searchId;
+			uint32_t targetLinkId;
+			double targetCost;
+			bool closed;
+
+			NodeState() : costSum(0), estimate(0), parent(WaypointGraph::NO_INDEX),
+				heapIndex(0), searchId(0), targetLinkId(0), targetCost(0), closed(false) { }
+		};
+
+		struct HeapTraits {
+			std::vector<NodeState>* nodes;
+			HeapTraits(std::vector<NodeState>* nodes) : nodes(nodes) { }
+			bool less(Index a, Index b) const { return (*nodes)[a].estimate < (*nodes)[b].estimate; }
+			void setIndex(Index x, size_t i) const { (*nodes)[x].heapIndex = i; }
+			size_t getIndex(Index x) const { return (*nodes)[x].heapIndex; }
+		};
+
+		typedef IndexedHeap<Index, HeapTraits> Heap;
+
+		std::vector<NodeState> nodes;
+		Heap border;
+		uint32_t searchCounter;
+		size_t expanded;
+
+		// the current search
+		State state;
+		const WaypointGraph* graph;
+		VirtualPosition source, target;
+		std::vector<Edge> sourceLinks;
+		bool direct;
+		/// false for buildTree(), which has no single goal to head for
+		bool useHeuristic;
+		/// closed node nearest to the target so far
+		Index best;
+		double bestDistance;
+
+		void relax(Index from, Index to, VirtualPosition toPosition, double cost);
+		void appendPath(Index to, Path& path) const;
+
+		// The heap refers to the node array of its owner
+		WaypointSearch& operator=(const WaypointSearch&);
+
+	public:
+		WaypointSearch() : border(HeapTraits(&nodes)), searchCounter(0), expanded(0),
+			state(STATE_IDLE), graph(0), direct(false), useHeuristic(true), best(0), bestDistance(0) { }
+
+		/// Copies are idle searches with scratch space of their own
+		WaypointSearch(const WaypointSearch&) : border(HeapTraits(&nodes)), searchCounter(0), expanded(0),
+			state(STATE_IDLE), graph(0), direct(false), useHeuristic(true), best(0), bestDistance(0) { }
+
+		/**
+		 * Search the shortest path from $source to $target.
+		 *
+		 * @param graph the static part of the map
+		 * @param sourceLinks edges from $source into $graph
+		 * @param targetLinks edges from $target into $graph
+		 * @param direct true iff $target is directly reachable from $source
+		 * @param path the path (excluding $source, including $target) is
+		 * 	appended here if one was found
+		 * @return true iff a path was found
+		 */
+		bool findPath(const WaypointGraph& graph,
+				VirtualPosition source, const std::vector<Edge>& sourceLinks,
+				VirtualPosition target, const std::vector<Edge>& targetLinks,
+				bool direct, Path& path);
+
+		/**
+		 * Set up a search with the same parameters as findPath(), but
+		 * don't do any work yet.
+		 */
+		void start(const WaypointGraph& graph,
+				VirtualPosition source, const std::vector<Edge>& sourceLinks,
+				VirtualPosition target, const std::vector<Edge>& targetLinks,
+				bool direct);
+
+		/**
+		 * Continue the current search for at most $maxExpansions nodes.
+		 * @return the state afterwards
+		 */
+		State advance(size_t maxExpansions);
+
+		State getState() const { return state; }
+
+		/**
+		 * Append the path found (excluding source, including target) to
+		 * $path.
+		 * @return false if the search didn't find one (yet)
+		 */
+		bool getPath(Path& path) const;
+
+		/**
+		 * Append the path to the waypoint nearest to the target that the
+		 * current search has reached so far (excluding source) to $path.
+		 * Partial paths of the same search always share a beginning with
+		 * each other and with the final path, they just branch off at some
+		 * waypoint.
+		 */
+		void getPartialPath(Path& path) const;
+
+		/**
+		 * Find the shortest paths from all waypoints to $target (Dijkstra,
+		 * the whole graph).
+		 */
+		void buildTree(const WaypointGraph& graph, VirtualPosition target, const std::vector<Edge>& targetLinks);
+
+		/**
+		 * Append the shortest path from $source to the target of the last
+		 * buildTree() to $path, same parameters and result as findPath().
+		 */
+		bool getTreePath(VirtualPosition source, const std::vector<Edge>& sourceLinks, bool direct, Path& path) const;
+
+		/// Number of nodes taken from the open list by the last search
+		size_t getExpandedCount() const { return expanded; }
+};
+
+} // namespace grail
+
+#endif // WAYPOINT_GRAPH_H
+
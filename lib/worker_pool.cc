@@ -0,0 +1,80 @@
+// vim: set noexpandtab:
+
+#include <vector>
+#include <unistd.h>
+#include <SDL.h>
+#include <SDL_thread.h>
+
+#include "worker_pool.h"
+#include "debug.h"
+
+namespace grail {
+
+struct WorkerPool::Run {
+	Job& job;
+	size_t items;
+	size_t next;
+	unsigned nextWorker;
+	SDL_mutex* mutex;
+
+	Run(Job& job, size_t items) : job(job), items(items), next(0), nextWorker(1), mutex(SDL_CreateMutex()) { }
+	~Run() { SDL_DestroyMutex(mutex); }
+
+	void work(unsigned worker) {
+		while(true) {
+			SDL_mutexP(mutex);
+			size_t item = next;
+			if(next < items) { next++; }
+			SDL_mutexV(mutex);
+
+			if(item >= items) { break; }
+			job.run(item, worker);
+		}
+	}
+};
+
+int WorkerPool::workerMain(void* data) {
+	Run &r = *static_cast<Run*>(data);
+
+	SDL_mutexP(r.mutex);
+	unsigned worker = r.nextWorker++;
+	SDL_mutexV(r.mutex);
+
+	r.work(worker);
+	return 0;
+}
+
+WorkerPool::WorkerPool(unsigned threads) : threads(threads ? threads : hardwareThreads()) {
+}
+
+void WorkerPool::run(Job& job, size_t items) {
+	Run r(job, items);
+
+	std::vector<SDL_Thread*> workers;
+	for(unsigned i = 1; i < threads && i < items; ++i) {
+		SDL_Thread *t = SDL_CreateThread(workerMain, &r);
+		if(!t) {
+			// The others (at least this thread) will take over its share
+			cdbg << "WorkerPool: could not start thread " << i << "\n";
+			break;
+		}
+		workers.push_back(t);
+	}
+
+	r.work(0);
+
+	for(std::vector<SDL_Thread*>::iterator iter = workers.begin(); iter != workers.end(); ++iter) {
+		SDL_WaitThread(*iter, 0);
+	}
+}
+
+unsigned WorkerPool::hardwareThreads() {
+	#ifdef _SC_NPROCESSORS_ONLN
+	long n = sysconf(_SC_NPROCESSORS_ONLN);
+	if(n > 0) { return n; }
+	#endif
+	return 1;
+}
+
+} // namespace grail
+
@@ -0,0 +1,61 @@
+// vim: set noexpandtab:
+
+#ifndef WORKER_POOL_H
+#define WORKER_POOL_H
+
+#include <cstddef>
+
+namespace grail {
+
+/**
+ * Processes a number of independent work items with several (SDL) threads.
+ *
+ * run() starts the workers, lets each of them take the next unprocessed
+ * item until there are none left, and returns when all items are done.
+ * The calling thread works along as worker 0, so a pool with one thread
+ * doesn't start any threads at all.
+ */
+class WorkerPool {
+	public:
+		class Job {
+			public:
+				virtual ~Job() { }
+
+				/**
+				 * Process item number $item. Called concurrently from
+				 * different threads, $worker (0 <= $worker < getThreads())
+				 * tells which one so results can be collected per worker
+				 * without locking.
+				 */
+				virtual void run(size_t item, unsigned worker) = 0;
+		};
+
+	private:
+		struct Run;
+		static int workerMain(void* run);
+
+		unsigned threads;
+
+	public:
+		/**
+		 * @param threads number of threads to use, 0 means one per CPU
+		 * 	core.
+		 */
+		WorkerPool(unsigned threads = 0);
+
+		unsigned getThreads() const { return threads; }
+
+		/**
+		 * Call job.run(i, worker) for all 0 <= i < $items, in no particular
+		 * order. Blocks until all of them are done.
+		 */
+		void run(Job& job, size_t items);
+
+		/// Number of CPU cores, if known, else 1
+		static unsigned hardwareThreads();
+};
+
+} // namespace grail
+
+#endif // WORKER_POOL_H
+
@@ -23,6 +23,8 @@
 #include "lib/sdl_exception.h"
 #include "lib/sprite.h"
 #include "lib/task.h"
+#include "lib/path_service.h"
+#include "lib/path_task.h"
 #include "lib/wait_task.h"
 #include "lib/text.h"
 #include "lib/user_interface.h"
@@ -130,15 +132,36 @@ extern "C" int init(lua_State* L) {
 			
 
 
-		class_<Ground>("Ground")
+		class_<GridMap, GridMap::Ptr>("GridMap")
 			.scope[
-				class_<Ground::Waypoint>("Waypoint")
-					.def("getPosition", &Ground::Waypoint::getPosition)
-					.def("linkBidirectional", &Ground::Waypoint::linkBidirectional)
-				]
-			
+				def("load", &GridMap::load)
+			]
+			.def("getColumns", &GridMap::getColumns)
+			.def("getRows", &GridMap::getRows)
+			,
+
+		class_<Ground>("Ground")
+			.enum_("MapBuilder") [
+				value("BUILDER_BRUTE_FORCE", Ground::BUILDER_BRUTE_FORCE),
+				value("BUILDER_ROTATIONAL_SWEEP", Ground::BUILDER_ROTATIONAL_SWEEP)
+			]
+			.enum_("Engine") [
+				value("ENGINE_VISIBILITY_GRAPH", Ground::ENGINE_VISIBILITY_GRAPH),
+				value("ENGINE_NAVMESH", Ground::ENGINE_NAVMESH),
+				value("ENGINE_GRID", Ground::ENGINE_GRID)
+			]
 			.def("addPolygon", &Ground::addPolygon)
-			//.def("generateMap", &Ground::generateMap)
+			.def("addObstacle", &Ground::addObstacle)
+			.def("removeObstacle", &Ground::removeObstacle)
+			.def("generateMap", &Ground::generateMap)
+			.def("setMapBuilder", &Ground::setMapBuilder)
+			.def("setMapThreads", &Ground::setMapThreads)
+			.def("setEngine", &Ground::setEngine)
+			.def("setGrid", &Ground::setGrid)
+			.def("setPathCacheSize", &Ground::setPathCacheSize)
+			.def("setPathTables", &Ground::setPathTables)
+			.def("savePathTables", &Ground::savePathTables)
+			.def("loadPathTables", &Ground::loadPathTables)
 			//.def("addWall", &Ground::addWall)
 			//.def("addWalls", &Ground::addWalls)
 			//.def("getWalls", &Ground::getWalls)
@@ -253,6 +276,7 @@ extern "C" int init(lua_State* L) {
 			.def("setup", &Viewport::setup)
 			.def("setFollowing", &Viewport::setFollowing)
 			.def("setNoFollowing", &Viewport::setNoFollowing)
+			.def("enableDirtyRects", &Viewport::enableDirtyRects)
 			,
 		
 		class_<Task, TaskWrapper, Task::Ptr>("Task")
@@ -268,6 +292,17 @@ extern "C" int init(lua_State* L) {
 		class_<WaitTask, Task, Task::Ptr>("WaitTask")
 			.def(constructor<uint32_t>())
 			,
+		class_<PathService, Task, Task::Ptr>("PathService")
+			.def(constructor<Ground&>())
+			.def(constructor<Ground&, unsigned>())
+			.def("request", &PathService::request)
+			.def("cancel", &PathService::cancel)
+			,
+		class_<PathTask, Task, Task::Ptr>("PathTask")
+			.def(constructor<Actor::Ptr, VirtualPosition>())
+			.def(constructor<Actor::Ptr, VirtualPosition, uint32_t>())
+			.def(constructor<Actor::Ptr, VirtualPosition, uint32_t, bool>())
+			,
 		class_<SoundTask, Task, Task::Ptr>("SoundTask")
 			.def(constructor<std::string, size_t>())
 			.def("pause", &SoundTask::pause)